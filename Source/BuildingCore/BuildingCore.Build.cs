@@ -0,0 +1,14 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+using UnrealBuildTool;
+
+public class BuildingCore : ModuleRules
+{
+	public BuildingCore(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		// Only the module boilerplate uses Core; the geometry is plain C++ and also builds natively from Tools/BuildingCore
+		PublicDependencyModuleNames.AddRange(new string[] { "Core" });
+	}
+}
@@ -0,0 +1,187 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingCoreFill.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+	using BuildingCore::FVec2;
+
+	// Positive when C is to the left of A->B
+	inline float Cross(const FVec2& A, const FVec2& B, const FVec2& C)
+	{
+		return (B.X - A.X) * (C.Y - A.Y) - (B.Y - A.Y) * (C.X - A.X);
+	}
+
+	bool IsEar(const FVec2* Points, const std::vector<int32_t>& Remaining, int32_t Corner)
+	{
+		const int32_t Count = static_cast<int32_t>(Remaining.size());
+		const FVec2& A = Points[Remaining[(Corner + Count - 1) % Count]];
+		const FVec2& B = Points[Remaining[Corner]];
+		const FVec2& C = Points[Remaining[(Corner + 1) % Count]];
+		if (Cross(A, B, C) <= 0.0f) {
+			return false; // Reflex
+		}
+
+		for (int32_t i = 0; i < Count; ++i) {
+			if (std::abs(i - Corner) <= 1 || std::abs(i - Corner) == Count - 1) {
+				continue;
+			}
+
+			// Only reflex points can lie inside a convex corner's triangle
+			const FVec2& P = Points[Remaining[i]];
+			const FVec2& Prev = Points[Remaining[(i + Count - 1) % Count]];
+			const FVec2& Next = Points[Remaining[(i + 1) % Count]];
+			if (Cross(Prev, P, Next) > 0.0f) {
+				continue;
+			}
+			if (Cross(A, B, P) >= 0.0f && Cross(B, C, P) >= 0.0f && Cross(C, A, P) >= 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+void BuildingCore::SimplifyPolygon(std::vector<FVec2>& Polygon, float Tolerance)
+{
+	while (Polygon.size() > 1 && Polygon.front().Equals(Polygon.back(), SmallNumber)) {
+		Polygon.pop_back();
+	}
+
+	bool bChanged = true;
+	while (bChanged && Polygon.size() > 3) {
+		bChanged = false;
+		for (size_t i = 0; i < Polygon.size() && Polygon.size() > 3;) {
+			const size_t Count = Polygon.size();
+			const FVec2& Prev = Polygon[(i + Count - 1) % Count];
+			const FVec2& Next = Polygon[(i + 1) % Count];
+			const float Length = (Next - Prev).Size();
+			const float Distance = Length > SmallNumber
+				? std::abs(Cross(Prev, Next, Polygon[i])) / Length
+				: (Polygon[i] - Prev).Size();
+
+			if (Distance <= Tolerance) {
+				Polygon.erase(Polygon.begin() + i);
+				bChanged = true;
+			} else {
+				++i;
+			}
+		}
+	}
+}
+
+bool BuildingCore::TriangulatePolygon(const FVec2* Polygon, int32_t Num, std::vector<int32_t>& OutTriangles)
+{
+	OutTriangles.clear();
+	if (Num < 3) {
+		return false;
+	}
+
+	float Area = 0.0f;
+	for (int32_t i = 0; i < Num; ++i) {
+		const FVec2& A = Polygon[i];
+		const FVec2& B = Polygon[(i + 1) % Num];
+		Area += A.X * B.Y - B.X * A.Y;
+	}
+	if (std::abs(Area) <= SmallNumber) {
+		return false;
+	}
+
+	// Walk the outline counter-clockwise in XY, so ears have positive area
+	std::vector<int32_t> Remaining;
+	Remaining.reserve(Num);
+	for (int32_t i = 0; i < Num; ++i) {
+		Remaining.push_back(Area > 0.0f ? i : Num - 1 - i);
+	}
+	OutTriangles.reserve((Num - 2) * 3);
+
+	int32_t Corner = 0;
+	while (Remaining.size() > 3) {
+		const int32_t Count = static_cast<int32_t>(Remaining.size());
+
+		int32_t Tried = 0;
+		while (Tried < Count && !IsEar(Polygon, Remaining, Corner)) {
+			Corner = (Corner + 1) % Count;
+			++Tried;
+		}
+		if (Tried == Count) {
+			OutTriangles.clear();
+			return false; // No ear left, the outline crosses itself
+		}
+
+		OutTriangles.push_back(Remaining[(Corner + Count - 1) % Count]);
+		OutTriangles.push_back(Remaining[Corner]);
+		OutTriangles.push_back(Remaining[(Corner + 1) % Count]);
+		Remaining.erase(Remaining.begin() + Corner);
+		Corner %= static_cast<int32_t>(Remaining.size());
+	}
+	OutTriangles.push_back(Remaining[0]);
+	OutTriangles.push_back(Remaining[1]);
+	OutTriangles.push_back(Remaining[2]);
+
+	return true;
+}
+
+void BuildingCore::SubdividePolygon(std::vector<FVec2>& Points, std::vector<int32_t>& Triangles, int32_t Levels)
+{
+	for (int32_t Level = 0; Level < Levels; ++Level) {
+		// Shared edges share their midpoint, so the result has no cracks
+		std::unordered_map<uint64_t, int32_t> Midpoints;
+		Midpoints.reserve(Triangles.size());
+		const auto Midpoint = [&Points, &Midpoints](int32_t A, int32_t B) {
+			const uint64_t Key = (static_cast<uint64_t>(std::min(A, B)) << 32) | static_cast<uint32_t>(std::max(A, B));
+			const auto Found = Midpoints.find(Key);
+			if (Found != Midpoints.end()) {
+				return Found->second;
+			}
+			const int32_t Index = static_cast<int32_t>(Points.size());
+			Points.push_back((Points[A] + Points[B]) * 0.5f);
+			Midpoints.emplace(Key, Index);
+			return Index;
+		};
+
+		std::vector<int32_t> Split;
+		Split.reserve(Triangles.size() * 4);
+		for (size_t i = 0; i + 2 < Triangles.size(); i += 3) {
+			const int32_t A = Triangles[i];
+			const int32_t B = Triangles[i + 1];
+			const int32_t C = Triangles[i + 2];
+			const int32_t AB = Midpoint(A, B);
+			const int32_t BC = Midpoint(B, C);
+			const int32_t CA = Midpoint(C, A);
+			Split.insert(Split.end(), { A, AB, CA, AB, B, BC, CA, BC, C, AB, BC, CA });
+		}
+		Triangles = std::move(Split);
+	}
+}
+
+void BuildingCore::ConvexHull(const FVec2* Points, int32_t Num, std::vector<FVec2>& OutHull)
+{
+	std::vector<FVec2> Sorted(Points, Points + Num);
+	std::sort(Sorted.begin(), Sorted.end(), [](const FVec2& A, const FVec2& B) {
+		return A.X < B.X || (A.X == B.X && A.Y < B.Y);
+	});
+
+	OutHull.clear();
+	if (Sorted.size() < 3) {
+		OutHull = Sorted;
+		return;
+	}
+	OutHull.reserve(Sorted.size() + 1);
+
+	// Lower hull left to right, then upper hull right to left, dropping every right turn
+	for (int Pass = 0; Pass < 2; ++Pass) {
+		const size_t Start = OutHull.size();
+		for (size_t i = 0; i < Sorted.size(); ++i) {
+			const FVec2& Point = Sorted[Pass == 0 ? i : Sorted.size() - 1 - i];
+			while (OutHull.size() >= Start + 2 && Cross(OutHull[OutHull.size() - 2], OutHull.back(), Point) <= 0.0f) {
+				OutHull.pop_back();
+			}
+			OutHull.push_back(Point);
+		}
+		// The last point is the first of the other half
+		OutHull.pop_back();
+	}
+}
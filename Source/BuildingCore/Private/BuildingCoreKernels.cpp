@@ -0,0 +1,144 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingCoreKernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BUILDINGCORE_SSE 1
+#include <xmmintrin.h>
+#else
+#define BUILDINGCORE_SSE 0
+#endif
+
+static_assert(sizeof(BuildingCore::FVec3) == 3 * sizeof(float), "The kernels read and write FVec3 streams as packed floats");
+static_assert(sizeof(BuildingCore::FTangent) == 4 * sizeof(float), "TransformTangents stores whole tangents");
+
+namespace {
+	using namespace BuildingCore;
+
+	FVec3 TransformScalar(const FMatrix44& Matrix, const FVec3& V, float W)
+	{
+		return FVec3(
+			V.X * Matrix.M[0][0] + V.Y * Matrix.M[1][0] + V.Z * Matrix.M[2][0] + W * Matrix.M[3][0],
+			V.X * Matrix.M[0][1] + V.Y * Matrix.M[1][1] + V.Z * Matrix.M[2][1] + W * Matrix.M[3][1],
+			V.X * Matrix.M[0][2] + V.Y * Matrix.M[1][2] + V.Z * Matrix.M[2][2] + W * Matrix.M[3][2]);
+	}
+
+#if BUILDINGCORE_SSE
+	// Operand order of VectorShuffle: X and Y from A, Z and W from B
+#define BUILDINGCORE_SHUFFLE(A, B, X, Y, Z, W) _mm_shuffle_ps((A), (B), _MM_SHUFFLE((W), (Z), (Y), (X)))
+
+	// Matrix columns splatted across all four lanes
+	struct FSplatMatrix {
+		__m128 M[4][3];
+
+		explicit FSplatMatrix(const FMatrix44& Matrix)
+		{
+			for (int Row = 0; Row < 4; ++Row) {
+				for (int Column = 0; Column < 3; ++Column) {
+					M[Row][Column] = _mm_set1_ps(Matrix.M[Row][Column]);
+				}
+			}
+		}
+	};
+
+	// Loads four packed FVec3 and transposes them into one register per component
+	inline void LoadTransposed(const FVec3* In, __m128& X, __m128& Y, __m128& Z)
+	{
+		const float* Src = &In->X;
+		const __m128 A = _mm_loadu_ps(Src);     // x0 y0 z0 x1
+		const __m128 B = _mm_loadu_ps(Src + 4); // y1 z1 x2 y2
+		const __m128 C = _mm_loadu_ps(Src + 8); // z2 x3 y3 z3
+
+		const __m128 XY23 = BUILDINGCORE_SHUFFLE(B, C, 2, 3, 1, 2); // x2 y2 x3 y3
+		X = BUILDINGCORE_SHUFFLE(BUILDINGCORE_SHUFFLE(A, B, 0, 3, 0, 0), XY23, 0, 1, 0, 2);
+		Y = BUILDINGCORE_SHUFFLE(BUILDINGCORE_SHUFFLE(A, B, 1, 1, 0, 0), XY23, 0, 2, 1, 3);
+		Z = BUILDINGCORE_SHUFFLE(BUILDINGCORE_SHUFFLE(A, B, 2, 2, 1, 1), C, 0, 2, 0, 3);
+	}
+
+	// Inverse of LoadTransposed
+	inline void StoreTransposed(const __m128& X, const __m128& Y, const __m128& Z, FVec3* Out)
+	{
+		float* Dst = &Out->X;
+		_mm_storeu_ps(Dst, BUILDINGCORE_SHUFFLE(BUILDINGCORE_SHUFFLE(X, Y, 0, 0, 0, 0), BUILDINGCORE_SHUFFLE(Z, X, 0, 0, 1, 1), 0, 2, 0, 2));
+		_mm_storeu_ps(Dst + 4, BUILDINGCORE_SHUFFLE(BUILDINGCORE_SHUFFLE(Y, Z, 1, 1, 1, 1), BUILDINGCORE_SHUFFLE(X, Y, 2, 2, 2, 2), 0, 2, 0, 2));
+		_mm_storeu_ps(Dst + 8, BUILDINGCORE_SHUFFLE(BUILDINGCORE_SHUFFLE(Z, X, 2, 2, 3, 3), BUILDINGCORE_SHUFFLE(Y, Z, 3, 3, 3, 3), 0, 2, 0, 2));
+	}
+
+	template <bool bTranslate>
+	inline void Transform4(const FSplatMatrix& S, __m128& X, __m128& Y, __m128& Z)
+	{
+		__m128 OutX = _mm_mul_ps(X, S.M[0][0]);
+		__m128 OutY = _mm_mul_ps(X, S.M[0][1]);
+		__m128 OutZ = _mm_mul_ps(X, S.M[0][2]);
+		OutX = _mm_add_ps(_mm_mul_ps(Y, S.M[1][0]), OutX);
+		OutY = _mm_add_ps(_mm_mul_ps(Y, S.M[1][1]), OutY);
+		OutZ = _mm_add_ps(_mm_mul_ps(Y, S.M[1][2]), OutZ);
+		OutX = _mm_add_ps(_mm_mul_ps(Z, S.M[2][0]), OutX);
+		OutY = _mm_add_ps(_mm_mul_ps(Z, S.M[2][1]), OutY);
+		OutZ = _mm_add_ps(_mm_mul_ps(Z, S.M[2][2]), OutZ);
+		if (bTranslate) {
+			OutX = _mm_add_ps(OutX, S.M[3][0]);
+			OutY = _mm_add_ps(OutY, S.M[3][1]);
+			OutZ = _mm_add_ps(OutZ, S.M[3][2]);
+		}
+		X = OutX;
+		Y = OutY;
+		Z = OutZ;
+	}
+#endif
+
+	template <bool bTranslate>
+	void TransformStream(const FMatrix44& Matrix, const FVec3* In, FVec3* Out, int32_t Num)
+	{
+		int32_t i = 0;
+#if BUILDINGCORE_SSE
+		const FSplatMatrix S(Matrix);
+		for (; i + 4 <= Num; i += 4) {
+			__m128 X, Y, Z;
+			LoadTransposed(In + i, X, Y, Z);
+			Transform4<bTranslate>(S, X, Y, Z);
+			StoreTransposed(X, Y, Z, Out + i);
+		}
+#endif
+		for (; i < Num; ++i) {
+			Out[i] = TransformScalar(Matrix, In[i], bTranslate ? 1.0f : 0.0f);
+		}
+	}
+}
+
+void BuildingCore::TransformPositions(const FMatrix44& Matrix, const FVec3* In, FVec3* Out, int32_t Num)
+{
+	TransformStream<true>(Matrix, In, Out, Num);
+}
+
+void BuildingCore::TransformVectors(const FMatrix44& Matrix, const FVec3* In, FVec3* Out, int32_t Num)
+{
+	TransformStream<false>(Matrix, In, Out, Num);
+}
+
+void BuildingCore::TransformTangents(const FMatrix44& Matrix, const FVec3* In, FTangent* Out, int32_t Num)
+{
+	int32_t i = 0;
+#if BUILDINGCORE_SSE
+	const FSplatMatrix S(Matrix);
+	const __m128 Zero = _mm_setzero_ps();
+	for (; i + 4 <= Num; i += 4) {
+		__m128 X, Y, Z;
+		LoadTransposed(In + i, X, Y, Z);
+		Transform4<false>(S, X, Y, Z);
+
+		// One tangent per register; the zero fourth lane clears bFlipTangentY and the padding after it
+		__m128 W = Zero;
+		_MM_TRANSPOSE4_PS(X, Y, Z, W);
+		_mm_storeu_ps(&Out[i].TangentX.X, X);
+		_mm_storeu_ps(&Out[i + 1].TangentX.X, Y);
+		_mm_storeu_ps(&Out[i + 2].TangentX.X, Z);
+		_mm_storeu_ps(&Out[i + 3].TangentX.X, W);
+	}
+#endif
+	for (; i < Num; ++i) {
+		Out[i].TangentX = TransformScalar(Matrix, In[i], 0.0f);
+		Out[i].bFlipTangentY = false;
+	}
+}
@@ -0,0 +1,198 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingCoreLayout.h"
+#include "BuildingCoreKernels.h"
+#include <algorithm>
+#include <cstring>
+
+float BuildingCore::FArcLengthView::GetDistanceAtPoint(int32_t Point) const
+{
+	if (Num == 0) {
+		return 0.0f;
+	}
+	return Distances[std::min(std::max(Point * SamplesPerSegment, 0), Num - 1)];
+}
+
+BuildingCore::FVec3 BuildingCore::FArcLengthView::GetLocationAtDistance(float Distance) const
+{
+	if (Num == 0) {
+		return FVec3();
+	}
+
+	const int32_t Upper = static_cast<int32_t>(std::upper_bound(Distances, Distances + Num, Distance) - Distances);
+	if (Upper <= 0) {
+		return Locations[0];
+	}
+	if (Upper >= Num) {
+		return Locations[Num - 1];
+	}
+
+	const float SpanLength = Distances[Upper] - Distances[Upper - 1];
+	const float Alpha = SpanLength > SmallNumber ? (Distance - Distances[Upper - 1]) / SpanLength : 0.0f;
+	return FVec3::Lerp(Locations[Upper - 1], Locations[Upper], Alpha);
+}
+
+void BuildingCore::AccumulateDistances(const FVec3* Locations, int32_t Num, float* OutDistances)
+{
+	float Distance = 0.0f;
+	for (int32_t i = 0; i < Num; ++i) {
+		if (i > 0) {
+			Distance += FVec3::Dist(Locations[i - 1], Locations[i]);
+		}
+		OutDistances[i] = Distance;
+	}
+}
+
+void BuildingCore::LayoutSegment(const FArcLengthView& ArcLengths, int32_t Segment, const uint8_t* Pattern, int32_t PatternSize,
+	const std::vector<FPartView>& Parts, FLayout& OutLayout)
+{
+	OutLayout.PatternScale = 1.0f;
+	OutLayout.Placements.clear();
+
+	const float StartDistance = ArcLengths.GetDistanceAtPoint(Segment);
+	const float Distance = ArcLengths.GetDistanceAtPoint(Segment + 1) - StartDistance;
+
+	// Whole pattern items until the segment is covered
+	float PatternLength = 0.0f;
+	float CycleLength = 0.0f;
+	for (int32_t i = 0; i < PatternSize; ++i) {
+		if (Pattern[i] >= Parts.size()) {
+			return;
+		}
+		CycleLength += Parts[Pattern[i]].Length;
+	}
+	if (PatternSize == 0 || CycleLength <= 0.0f) {
+		return;
+	}
+
+	int32_t PatternCount;
+	for (PatternCount = 0; PatternLength < Distance; ++PatternCount) {
+		PatternLength += Parts[Pattern[PatternCount % PatternSize]].Length;
+	}
+	if (PatternCount == 0) {
+		return;
+	}
+	const float PatternScale = Distance / PatternLength;
+	OutLayout.PatternScale = PatternScale;
+	OutLayout.Placements.reserve(PatternCount);
+
+	float CurrentLength = 0.0f;
+	for (int32_t Item = 0; Item < PatternCount; ++Item) {
+		const int32_t MeshType = Pattern[Item % PatternSize];
+		const FPartView& Part = Parts[MeshType];
+
+		// The item aims at where its unscaled length would end, so it follows the curve it is placed on
+		const float A = StartDistance + CurrentLength;
+		const float B = A + Part.Length;
+		CurrentLength += Part.Length * PatternScale;
+
+		if (!Part.bValid) {
+			break;
+		}
+
+		FPlacement Placement;
+		Placement.Start = ArcLengths.GetLocationAtDistance(A);
+		Placement.End = ArcLengths.GetLocationAtDistance(B);
+		GetLookAtRotation(Placement.Start, Placement.End, Placement.Pitch, Placement.Yaw);
+		Placement.MeshType = MeshType;
+		OutLayout.Placements.push_back(Placement);
+	}
+}
+
+void BuildingCore::GetLookAtRotation(const FVec3& Start, const FVec3& End, float& OutPitch, float& OutYaw)
+{
+	const FVec3 Direction = End - Start;
+	OutYaw = std::atan2(Direction.Y, Direction.X) / RadiansPerDegree;
+	OutPitch = std::atan2(Direction.Z, std::sqrt(Direction.X * Direction.X + Direction.Y * Direction.Y)) / RadiansPerDegree;
+}
+
+BuildingCore::FMatrix44 BuildingCore::GetScaleRotationTranslation(const FVec3& Scale, float Pitch, float Yaw, const FVec3& Translation)
+{
+	const float SP = std::sin(Pitch * RadiansPerDegree);
+	const float CP = std::cos(Pitch * RadiansPerDegree);
+	const float SY = std::sin(Yaw * RadiansPerDegree);
+	const float CY = std::cos(Yaw * RadiansPerDegree);
+
+	FMatrix44 Result;
+	Result.M[0][0] = CP * CY * Scale.X;
+	Result.M[0][1] = CP * SY * Scale.X;
+	Result.M[0][2] = SP * Scale.X;
+	Result.M[0][3] = 0.0f;
+
+	Result.M[1][0] = -SY * Scale.Y;
+	Result.M[1][1] = CY * Scale.Y;
+	Result.M[1][2] = 0.0f;
+	Result.M[1][3] = 0.0f;
+
+	Result.M[2][0] = -SP * CY * Scale.Z;
+	Result.M[2][1] = -SP * SY * Scale.Z;
+	Result.M[2][2] = CP * Scale.Z;
+	Result.M[2][3] = 0.0f;
+
+	Result.M[3][0] = Translation.X;
+	Result.M[3][1] = Translation.Y;
+	Result.M[3][2] = Translation.Z;
+	Result.M[3][3] = 1.0f;
+	return Result;
+}
+
+void BuildingCore::CountChunk(const FLayout& Layout, const std::vector<FPartView>& Parts, int32_t SlotCount, int32_t* OutVertexCounts, int32_t* OutIndexCounts)
+{
+	std::fill(OutVertexCounts, OutVertexCounts + SlotCount, 0);
+	std::fill(OutIndexCounts, OutIndexCounts + SlotCount, 0);
+	for (const FPlacement& Placement : Layout.Placements) {
+		for (const FPartSectionView& Section : Parts[Placement.MeshType].Sections) {
+			if (Section.Slot >= 0 && Section.Slot < SlotCount) {
+				OutVertexCounts[Section.Slot] += Section.NumVertices;
+				OutIndexCounts[Section.Slot] += Section.NumIndices;
+			}
+		}
+	}
+}
+
+void BuildingCore::EmitChunk(const FLayout& Layout, const std::vector<FPartView>& Parts, const FFloorSpec& Floor, const FSlotBuffers* Slots, int32_t SlotCount)
+{
+	// Write cursors of each slot; buildings rarely have more than a handful of materials
+	constexpr int32_t InlineSlots = 16;
+	int32_t InlineCursors[InlineSlots * 2];
+	std::vector<int32_t> HeapCursors;
+	int32_t* VertexCursors = InlineCursors;
+	if (SlotCount > InlineSlots) {
+		HeapCursors.resize(SlotCount * 2);
+		VertexCursors = HeapCursors.data();
+	}
+	int32_t* IndexCursors = VertexCursors + SlotCount;
+	std::fill(VertexCursors, VertexCursors + SlotCount * 2, 0);
+
+	const FVec3 Offset(0.0f, 0.0f, Floor.HeightOffset);
+	for (const FPlacement& Placement : Layout.Placements) {
+		const FPartView& Part = Parts[Placement.MeshType];
+
+		// One matrix per placement, shared by all of its sections
+		const FMatrix44 Transform = GetScaleRotationTranslation(
+			FVec3(Layout.PatternScale, 1.0f, Floor.Height / Part.Height), Placement.Pitch, Placement.Yaw, Placement.Start + Offset);
+		const FMatrix44 NormalTransform = GetScaleRotationTranslation(FVec3(1.0f, 1.0f, 1.0f), Placement.Pitch, Placement.Yaw, FVec3());
+
+		for (const FPartSectionView& Section : Part.Sections) {
+			if (Section.Slot < 0 || Section.Slot >= SlotCount) {
+				continue;
+			}
+			const FSlotBuffers& Out = Slots[Section.Slot];
+			const int32_t FirstVertex = VertexCursors[Section.Slot];
+
+			TransformPositions(Transform, Section.Positions, Out.Positions + FirstVertex, Section.NumVertices);
+			TransformVectors(NormalTransform, Section.TangentZ, Out.Normals + FirstVertex, Section.NumVertices);
+			TransformTangents(NormalTransform, Section.TangentX, Out.Tangents + FirstVertex, Section.NumVertices);
+			std::memcpy(Out.UVs + FirstVertex, Section.UVs, Section.NumVertices * sizeof(FVec2));
+
+			int32_t* Indices = Out.Indices + IndexCursors[Section.Slot];
+			for (int32_t i = 0; i < Section.NumIndices; ++i) {
+				Indices[i] = FirstVertex + Section.Indices[i];
+			}
+
+			VertexCursors[Section.Slot] += Section.NumVertices;
+			IndexCursors[Section.Slot] += Section.NumIndices;
+		}
+	}
+}
@@ -0,0 +1,6 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Modules/ModuleManager.h"
+
+// The only engine code in the module, left out of the native build
+IMPLEMENT_MODULE(FDefaultModuleImpl, BuildingCore);
@@ -0,0 +1,22 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "BuildingCoreMath.h"
+#include <vector>
+
+// Roof and floor fill of a building footprint, in the XY plane
+namespace BuildingCore {
+	// Drops repeated and nearly collinear points of a closed outline
+	BUILDINGCORE_API void SimplifyPolygon(std::vector<FVec2>& Polygon, float Tolerance);
+
+	// Ear clipping. Whatever the outline's orientation the triangles face +Z (clockwise seen from above).
+	// Returns false for degenerate or self-intersecting outlines.
+	BUILDINGCORE_API bool TriangulatePolygon(const FVec2* Polygon, int32_t Num, std::vector<int32_t>& OutTriangles);
+
+	// Splits every triangle into four Levels times, appending the edge midpoints to Points
+	BUILDINGCORE_API void SubdividePolygon(std::vector<FVec2>& Points, std::vector<int32_t>& Triangles, int32_t Levels);
+
+	// Counter-clockwise convex hull of Points (monotone chain)
+	BUILDINGCORE_API void ConvexHull(const FVec2* Points, int32_t Num, std::vector<FVec2>& OutHull);
+}
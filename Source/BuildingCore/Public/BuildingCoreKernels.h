@@ -0,0 +1,20 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "BuildingCoreMath.h"
+
+/**
+ * Batch vertex transforms used to place part meshes along a building.
+ * Streams are processed four vertices per iteration with SSE where available; In and Out may be the same array.
+ */
+namespace BuildingCore {
+	// Out[i] = In[i] * Matrix, with translation
+	BUILDINGCORE_API void TransformPositions(const FMatrix44& Matrix, const FVec3* In, FVec3* Out, int32_t Num);
+
+	// Out[i] = In[i] * Matrix, without translation
+	BUILDINGCORE_API void TransformVectors(const FMatrix44& Matrix, const FVec3* In, FVec3* Out, int32_t Num);
+
+	// Out[i] = { In[i] * Matrix, false }
+	BUILDINGCORE_API void TransformTangents(const FMatrix44& Matrix, const FVec3* In, FTangent* Out, int32_t Num);
+}
@@ -0,0 +1,102 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "BuildingCoreMath.h"
+#include <vector>
+
+/**
+ * Pattern layout and vertex emission of building walls, on plain buffers owned by the caller.
+ * Thread safe: nothing here keeps state between calls.
+ */
+namespace BuildingCore {
+	// A footprint polyline sampled evenly per segment, with the distance along it of every sample
+	struct FArcLengthView {
+		const FVec3* Locations = nullptr;
+		const float* Distances = nullptr;
+		int32_t Num = 0;
+		int32_t SamplesPerSegment = 1;
+
+		// Distance at the first sample of segment Point, clamped to the ends
+		BUILDINGCORE_API float GetDistanceAtPoint(int32_t Point) const;
+
+		// Clamped to the ends of the polyline, like USplineComponent::GetLocationAtDistanceAlongSpline
+		BUILDINGCORE_API FVec3 GetLocationAtDistance(float Distance) const;
+	};
+
+	// OutDistances[i] is the length of the polyline up to Locations[i]
+	BUILDINGCORE_API void AccumulateDistances(const FVec3* Locations, int32_t Num, float* OutDistances);
+
+	// One pattern item placed along a segment, in building space, facing from Start to End
+	struct FPlacement {
+		FVec3 Start;
+		FVec3 End;
+		// Degrees, as in FRotator; roll is always zero
+		float Pitch = 0.0f;
+		float Yaw = 0.0f;
+		int32_t MeshType = 0;
+	};
+
+	// The pattern of one segment laid out along the footprint; the same for every floor that uses the pattern
+	struct FLayout {
+		float PatternScale = 1.0f;
+		std::vector<FPlacement> Placements;
+	};
+
+	// Structure-of-arrays geometry of one material section of a part mesh
+	struct FPartSectionView {
+		const FVec3* Positions = nullptr;
+		const FVec2* UVs = nullptr;
+		const FVec3* TangentZ = nullptr;
+		const FVec3* TangentX = nullptr;
+		int32_t NumVertices = 0;
+
+		// Relative to the first vertex of this section
+		const int32_t* Indices = nullptr;
+		int32_t NumIndices = 0;
+
+		// Output slot the section is emitted into; negative to leave it out
+		int32_t Slot = -1;
+	};
+
+	// One wall piece: its size in the pattern and its geometry
+	struct FPartView {
+		bool bValid = false;
+		// Length along the wall, used by layout
+		float Length = 0.0f;
+		// Height the geometry is modelled at; it is scaled to the floor height
+		float Height = 0.0f;
+		std::vector<FPartSectionView> Sections;
+	};
+
+	struct FFloorSpec {
+		float HeightOffset = 0.0f;
+		float Height = 0.0f;
+	};
+
+	// Where EmitChunk writes one slot, sized to the counts from CountChunk
+	struct FSlotBuffers {
+		FVec3* Positions = nullptr;
+		FVec3* Normals = nullptr;
+		FTangent* Tangents = nullptr;
+		FVec2* UVs = nullptr;
+		int32_t* Indices = nullptr;
+	};
+
+	// Repeats Pattern (indices into Parts) along a segment, scaled so the last item ends at the segment's end.
+	// Stops at the first invalid part.
+	BUILDINGCORE_API void LayoutSegment(const FArcLengthView& ArcLengths, int32_t Segment, const uint8_t* Pattern, int32_t PatternSize,
+		const std::vector<FPartView>& Parts, FLayout& OutLayout);
+
+	// FRotator(Pitch, Yaw, 0) of a look-at from Start to End
+	BUILDINGCORE_API void GetLookAtRotation(const FVec3& Start, const FVec3& End, float& OutPitch, float& OutYaw);
+
+	// FScaleRotationTranslationMatrix(Scale, FRotator(Pitch, Yaw, 0), Translation)
+	BUILDINGCORE_API FMatrix44 GetScaleRotationTranslation(const FVec3& Scale, float Pitch, float Yaw, const FVec3& Translation);
+
+	// Exact vertex and index totals of each of SlotCount slots for one chunk
+	BUILDINGCORE_API void CountChunk(const FLayout& Layout, const std::vector<FPartView>& Parts, int32_t SlotCount, int32_t* OutVertexCounts, int32_t* OutIndexCounts);
+
+	// Transforms every placed part into Slots, which CountChunk sized; nothing grows
+	BUILDINGCORE_API void EmitChunk(const FLayout& Layout, const std::vector<FPartView>& Parts, const FFloorSpec& Floor, const FSlotBuffers* Slots, int32_t SlotCount);
+}
@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+// BuildingCore only uses the standard library, so it builds and profiles without the engine (see Tools/BuildingCore).
+// Its structs match the memory layout of the engine types they stand in for, so buffers are shared rather than copied.
+#include <cstdint>
+#include <cmath>
+
+#ifndef BUILDINGCORE_API
+#define BUILDINGCORE_API
+#endif
+
+namespace BuildingCore {
+	// KINDA_SMALL_NUMBER
+	constexpr float SmallNumber = 1.e-4f;
+	constexpr float RadiansPerDegree = 3.14159265358979f / 180.0f;
+
+	struct FVec2 {
+		float X = 0.0f;
+		float Y = 0.0f;
+
+		FVec2() = default;
+		FVec2(float InX, float InY) : X(InX), Y(InY) {}
+
+		FVec2 operator+(const FVec2& Other) const { return FVec2(X + Other.X, Y + Other.Y); }
+		FVec2 operator-(const FVec2& Other) const { return FVec2(X - Other.X, Y - Other.Y); }
+		FVec2 operator*(float Scale) const { return FVec2(X * Scale, Y * Scale); }
+		bool operator==(const FVec2& Other) const { return X == Other.X && Y == Other.Y; }
+
+		float Size() const { return std::sqrt(X * X + Y * Y); }
+		bool Equals(const FVec2& Other, float Tolerance) const { return std::abs(X - Other.X) <= Tolerance && std::abs(Y - Other.Y) <= Tolerance; }
+	};
+
+	struct FVec3 {
+		float X = 0.0f;
+		float Y = 0.0f;
+		float Z = 0.0f;
+
+		FVec3() = default;
+		FVec3(float InX, float InY, float InZ) : X(InX), Y(InY), Z(InZ) {}
+
+		FVec3 operator+(const FVec3& Other) const { return FVec3(X + Other.X, Y + Other.Y, Z + Other.Z); }
+		FVec3 operator-(const FVec3& Other) const { return FVec3(X - Other.X, Y - Other.Y, Z - Other.Z); }
+		FVec3 operator*(float Scale) const { return FVec3(X * Scale, Y * Scale, Z * Scale); }
+
+		float Size() const { return std::sqrt(X * X + Y * Y + Z * Z); }
+		static float Dist(const FVec3& A, const FVec3& B) { return (B - A).Size(); }
+		static FVec3 Lerp(const FVec3& A, const FVec3& B, float Alpha) { return A + (B - A) * Alpha; }
+	};
+
+	// Row vectors like FMatrix: Out = In * M, translation in the last row
+	struct FMatrix44 {
+		float M[4][4];
+	};
+
+	// Same layout as FProcMeshTangent
+	struct FTangent {
+		FVec3 TangentX;
+		bool bFlipTangentY = false;
+	};
+}
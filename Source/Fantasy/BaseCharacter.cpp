@@ -1,6 +1,7 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "BaseCharacter.h"
+#include "TargetingSubsystem.h"
 
 // Sets default values
 ABaseCharacter::ABaseCharacter()
@@ -13,6 +14,19 @@ ABaseCharacter::ABaseCharacter()
 void ABaseCharacter::BeginPlay()
 {
 	Super::BeginPlay();
+
+	if (UTargetingSubsystem* Targeting = GetWorld()->GetSubsystem<UTargetingSubsystem>()) {
+		Targeting->RegisterCharacter(this);
+	}
+}
+
+void ABaseCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UTargetingSubsystem* Targeting = GetWorld()->GetSubsystem<UTargetingSubsystem>()) {
+		Targeting->UnregisterCharacter(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 // Called every frame
@@ -4,10 +4,11 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "GenericTeamAgentInterface.h"
 #include "BaseCharacter.generated.h"
 
 UCLASS()
-class FANTASY_API ABaseCharacter : public ACharacter
+class FANTASY_API ABaseCharacter : public ACharacter, public IGenericTeamAgentInterface
 {
 	GENERATED_BODY()
 
@@ -15,9 +16,22 @@ public:
 	// Sets default values for this character's properties
 	ABaseCharacter();
 
+	static constexpr uint8 PlayerTeam = 0;
+	static constexpr uint8 EnemyTeam = 1;
+
+	// Team for targeting, and for AI perception affiliation through the enemy controller, which takes its pawn's team; 255 is no team.
+	// Characters are only hostile to a different team, and Find Target looks for hostile targets by default,
+	// so enemies default to EnemyTeam and AFantasyCharacter sets PlayerTeam. Friendly NPCs need a team of their own.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Team")
+	uint8 TeamId = EnemyTeam;
+
+	virtual FGenericTeamId GetGenericTeamId() const override { return FGenericTeamId(TeamId); }
+	virtual void SetGenericTeamId(const FGenericTeamId& NewTeamId) override { TeamId = NewTeamId.GetId(); }
+
 protected:
-	// Called when the game starts or when spawned
+	// Called when the game starts or when spawned; registers with UTargetingSubsystem
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:	
 	// Called every frame
@@ -2,6 +2,9 @@
 
 
 #include "CBaseEnemy_Controller.h"
+#include "AISignificanceSubsystem.h"
+#include "VisionConeSubsystem.h"
+#include "FightDirectorSubsystem.h"
 #include <Runtime/AIModule/Classes/Perception/AIPerceptionComponent.h>
 #include <Runtime/AIModule/Classes/Perception/AISense.h>
 #include <Runtime/AIModule/Classes/Perception/AISense_Sight.h>
@@ -36,10 +39,73 @@ bool ACBaseEnemy_Controller::SetSightAngle(AAIController* Controller, float Angl
         return false;
     }
 
+    // Behavior trees can set the angle every tick; the subsystem applies the last one once per frame
+    if (UVisionConeSubsystem* Vision = Controller->GetWorld()->GetSubsystem<UVisionConeSubsystem>())
+    {
+        Vision->RequestSightAngle(Controller, Angle);
+        return true;
+    }
+
     auto ConfigSight = Cast<UAISenseConfig_Sight>(Config);
     ConfigSight->PeripheralVisionAngleDegrees = Angle;
 
     Perception->RequestStimuliListenerUpdate();
 
     return true;
-}
\ No newline at end of file
+}
+
+void ACBaseEnemy_Controller::OnPerceptionUpdated(AActor* Actor, FAIStimulus Stimulus)
+{
+    if (UAISignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UAISignificanceSubsystem>())
+    {
+        Significance->WakeController(this);
+    }
+}
+
+void ACBaseEnemy_Controller::OnPossess(APawn* InPawn)
+{
+    Super::OnPossess(InPawn);
+
+    // Perception affiliation comes from the controller, so it takes the pawn's team to agree with targeting
+    if (const IGenericTeamAgentInterface* TeamAgent = Cast<IGenericTeamAgentInterface>(InPawn))
+    {
+        SetGenericTeamId(TeamAgent->GetGenericTeamId());
+    }
+
+    if (UAISignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UAISignificanceSubsystem>())
+    {
+        Significance->RegisterController(this);
+    }
+    if (UAIPerceptionComponent* Perception = GetAIPerceptionComponent())
+    {
+        // The listener caches its team, so refresh it after the change above
+        Perception->RequestStimuliListenerUpdate();
+        Perception->OnTargetPerceptionUpdated.AddUniqueDynamic(this, &ACBaseEnemy_Controller::OnPerceptionUpdated);
+    }
+    if (UVisionConeSubsystem* Vision = GetWorld()->GetSubsystem<UVisionConeSubsystem>())
+    {
+        Vision->RegisterViewer(this);
+    }
+    if (UFightDirectorSubsystem* FightDirector = GetWorld()->GetSubsystem<UFightDirectorSubsystem>())
+    {
+        FightDirector->RegisterAttacker(this);
+    }
+}
+
+void ACBaseEnemy_Controller::OnUnPossess()
+{
+    if (UAISignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UAISignificanceSubsystem>())
+    {
+        Significance->UnregisterController(this);
+    }
+    if (UVisionConeSubsystem* Vision = GetWorld()->GetSubsystem<UVisionConeSubsystem>())
+    {
+        Vision->UnregisterViewer(this);
+    }
+    if (UFightDirectorSubsystem* FightDirector = GetWorld()->GetSubsystem<UFightDirectorSubsystem>())
+    {
+        FightDirector->UnregisterAttacker(this);
+    }
+
+    Super::OnUnPossess();
+}
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "AIController.h"
+#include "Perception/AIPerceptionTypes.h"
 #include "CBaseEnemy_Controller.generated.h"
 
 /**
@@ -16,4 +17,20 @@ class FANTASY_API ACBaseEnemy_Controller : public AAIController
 
 	UFUNCTION(BlueprintCallable)
 	static bool SetSightAngle(AAIController* Controller, float Angle);
+
+public:
+	// Called by UFightDirectorSubsystem when this enemy is allowed to attack Target, or no longer is
+	UFUNCTION(BlueprintImplementableEvent, Category = "AI|Fight")
+	void OnAttackTokenChanged(bool bGranted, AActor* Target);
+
+protected:
+	// Wakes the behavior tree if UAISignificanceSubsystem paused it
+	UFUNCTION()
+	void OnPerceptionUpdated(AActor* Actor, FAIStimulus Stimulus);
+
+	// Registers with UAISignificanceSubsystem, which throttles the enemy by distance to the players,
+	// with UVisionConeSubsystem, which answers line of sight queries for it,
+	// and with UFightDirectorSubsystem, which decides when it may attack
+	virtual void OnPossess(APawn* InPawn) override;
+	virtual void OnUnPossess() override;
 };
@@ -17,6 +17,9 @@ AFantasyCharacter::AFantasyCharacter()
 	// Set size for collision capsule
 	GetCapsuleComponent()->InitCapsuleSize(42.f, 96.0f);
 
+	// Enemies default to ABaseCharacter::EnemyTeam and target other teams
+	TeamId = PlayerTeam;
+
 	// set our turn rates for input
 	BaseTurnRate = 45.f;
 	BaseLookUpRate = 45.f;
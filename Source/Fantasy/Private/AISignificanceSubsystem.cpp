@@ -0,0 +1,250 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AISignificanceSubsystem.h"
+#include "EnemyStats.h"
+#include "AIController.h"
+#include "BrainComponent.h"
+#include "Perception/AIPerceptionComponent.h"
+#include "Perception/AISense_Sight.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/World.h"
+
+UAISignificanceSubsystem::UAISignificanceSubsystem()
+{
+	Buckets.SetNum(static_cast<int32>(EAISignificance::MAX));
+
+	// High keeps the defaults: everything every frame
+	Buckets[0].MaxDistance = 2500.0f;
+
+	FAISignificanceBucket& Medium = Buckets[1];
+	Medium.MaxDistance = 6000.0f;
+	Medium.PerceptionTickInterval = 0.2f;
+	Medium.MovementTickInterval = 1.0f / 30.0f;
+	Medium.AnimationTickInterval = 1.0f / 30.0f;
+	Medium.ActorTickInterval = 0.1f;
+
+	FAISignificanceBucket& Low = Buckets[2];
+	Low.MaxDistance = 12000.0f;
+	Low.PerceptionTickInterval = 0.5f;
+	Low.MovementTickInterval = 0.1f;
+	Low.AnimationTickInterval = 0.1f;
+	Low.bAnimateWhenHidden = false;
+	Low.ActorTickInterval = 0.5f;
+
+	FAISignificanceBucket& Dormant = Buckets[3];
+	Dormant.bPauseBehavior = true;
+	Dormant.PerceptionTickInterval = 1.0f;
+	Dormant.bSight = false;
+	Dormant.MovementTickInterval = 0.25f;
+	Dormant.AnimationTickInterval = 0.25f;
+	Dormant.bAnimateWhenHidden = false;
+	Dormant.ActorTickInterval = 1.0f;
+}
+
+void UAISignificanceSubsystem::RegisterController(AAIController* Controller)
+{
+	if (Controller == nullptr || Entries.ContainsByPredicate([Controller](const FEntry& Entry) { return Entry.Controller == Controller; })) {
+		return;
+	}
+
+	FEntry& Entry = Entries.AddDefaulted_GetRef();
+	Entry.Controller = Controller;
+	if (const ACharacter* Character = Cast<ACharacter>(Controller->GetPawn())) {
+		if (Character->GetMesh() != nullptr) {
+			Entry.DefaultAnimTickOption = Character->GetMesh()->VisibilityBasedAnimTickOption;
+		}
+	}
+	if (Buckets.IsValidIndex(static_cast<int32>(Entry.Significance))) {
+		Apply(Entry, Buckets[static_cast<int32>(Entry.Significance)]);
+	}
+}
+
+void UAISignificanceSubsystem::UnregisterController(AAIController* Controller)
+{
+	const int32 Index = Entries.IndexOfByPredicate([Controller](const FEntry& Entry) { return Entry.Controller == Controller; });
+	if (Index == INDEX_NONE) {
+		return;
+	}
+
+	// A default bucket throttles nothing
+	Apply(Entries[Index], FAISignificanceBucket());
+	Entries.RemoveAtSwap(Index, 1, false);
+}
+
+void UAISignificanceSubsystem::WakeController(AAIController* Controller)
+{
+	FEntry* Entry = Entries.FindByPredicate([Controller](const FEntry& Other) { return Other.Controller == Controller; });
+	if (Entry == nullptr) {
+		return;
+	}
+
+	Entry->AwakeUntil = GetWorld()->GetTimeSeconds() + WakeTime;
+	if (Entry->bBehaviorPaused) {
+		const EAISignificance Significance = Classify(*Entry);
+		Entry->Significance = Significance;
+		Apply(*Entry, Buckets[static_cast<int32>(Significance)]);
+	}
+}
+
+EAISignificance UAISignificanceSubsystem::GetSignificance(const AAIController* Controller) const
+{
+	const FEntry* Entry = Entries.FindByPredicate([Controller](const FEntry& Other) { return Other.Controller == Controller; });
+	return Entry != nullptr ? Entry->Significance : EAISignificance::High;
+}
+
+int32 UAISignificanceSubsystem::GetBucketCount(EAISignificance Significance) const
+{
+	const int32 Index = static_cast<int32>(Significance);
+	return Index >= 0 && Index < static_cast<int32>(EAISignificance::MAX) ? Counts[Index] : 0;
+}
+
+void UAISignificanceSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+	FANTASY_SCOPE(STAT_EnemySignificance);
+
+	Entries.RemoveAllSwap([](const FEntry& Entry) { return !Entry.Controller.IsValid(); }, false);
+
+	// Without a player there is nothing to measure against, so everyone keeps their bucket
+	UpdateViews();
+	if (Views.Num() > 0 && Buckets.Num() > 0) {
+		const int32 Updates = FMath::Min(UpdatesPerFrame, Entries.Num());
+		for (int32 i = 0; i < Updates; ++i) {
+			NextUpdate %= Entries.Num();
+			FEntry& Entry = Entries[NextUpdate++];
+			const EAISignificance Significance = Classify(Entry);
+			if (Significance != Entry.Significance) {
+				Entry.Significance = Significance;
+				Apply(Entry, Buckets[static_cast<int32>(Significance)]);
+			}
+		}
+	}
+
+	FMemory::Memzero(Counts);
+	for (const FEntry& Entry : Entries) {
+		++Counts[static_cast<int32>(Entry.Significance)];
+	}
+
+	// Every throttled tick function runs 1 / Interval times a second instead of once a frame
+	TicksSkippedPerSecond = 0.0f;
+	if (DeltaTime > 0.0f) {
+		for (int32 Index = 0; Index < Buckets.Num() && Index < static_cast<int32>(EAISignificance::MAX); ++Index) {
+			const FAISignificanceBucket& Bucket = Buckets[Index];
+			for (const float Interval : { Bucket.PerceptionTickInterval, Bucket.MovementTickInterval, Bucket.AnimationTickInterval, Bucket.ActorTickInterval }) {
+				if (Interval > DeltaTime) {
+					TicksSkippedPerSecond += Counts[Index] * (1.0f / DeltaTime - 1.0f / Interval);
+				}
+			}
+		}
+	}
+	EstimatedMsSaved = TicksSkippedPerSecond * DeltaTime * TickCostMicroseconds / 1000.0f;
+
+	SET_DWORD_STAT(STAT_EnemySignificanceHigh, Counts[static_cast<int32>(EAISignificance::High)]);
+	SET_DWORD_STAT(STAT_EnemySignificanceMedium, Counts[static_cast<int32>(EAISignificance::Medium)]);
+	SET_DWORD_STAT(STAT_EnemySignificanceLow, Counts[static_cast<int32>(EAISignificance::Low)]);
+	SET_DWORD_STAT(STAT_EnemySignificanceDormant, Counts[static_cast<int32>(EAISignificance::Dormant)]);
+	SET_FLOAT_STAT(STAT_EnemyTicksSkipped, TicksSkippedPerSecond);
+	SET_FLOAT_STAT(STAT_EnemyMsSaved, EstimatedMsSaved);
+}
+
+TStatId UAISignificanceSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UAISignificanceSubsystem, STATGROUP_EnemyAI);
+}
+
+EAISignificance UAISignificanceSubsystem::Classify(const FEntry& Entry) const
+{
+	const APawn* Pawn = Entry.Controller->GetPawn();
+	if (Pawn == nullptr) {
+		return Entry.Significance;
+	}
+
+	const FVector Location = Pawn->GetActorLocation();
+	float DistanceSquared = MAX_flt;
+	for (const FVector& View : Views) {
+		DistanceSquared = FMath::Min(DistanceSquared, FVector::DistSquared(Location, View));
+	}
+	const float Distance = FMath::Sqrt(DistanceSquared);
+
+	const int32 Last = FMath::Min(Buckets.Num(), static_cast<int32>(EAISignificance::MAX)) - 1;
+	const int32 Current = static_cast<int32>(Entry.Significance);
+	int32 Bucket = Last;
+	for (int32 Index = 0; Index < Last; ++Index) {
+		// Moving up to a nearer bucket needs the margin, moving down does not
+		const float Limit = Buckets[Index].MaxDistance * (Index < Current ? 1.0f - Hysteresis : 1.0f);
+		if (Distance <= Limit) {
+			Bucket = Index;
+			break;
+		}
+	}
+
+	// Dedicated servers render nothing, so nothing would ever count as seen
+	if (bDemoteUnseen && GetWorld()->GetNetMode() != NM_DedicatedServer && !Pawn->WasRecentlyRendered(SeenTolerance)) {
+		Bucket = FMath::Min(Bucket + 1, Last);
+	}
+
+	// Recently woken enemies take the farthest bucket that keeps their behavior running
+	if (GetWorld()->GetTimeSeconds() < Entry.AwakeUntil) {
+		while (Bucket > 0 && Buckets[Bucket].bPauseBehavior) {
+			--Bucket;
+		}
+	}
+	return static_cast<EAISignificance>(Bucket);
+}
+
+void UAISignificanceSubsystem::Apply(FEntry& Entry, const FAISignificanceBucket& Bucket)
+{
+	AAIController* Controller = Entry.Controller.Get();
+	if (Controller == nullptr) {
+		return;
+	}
+
+	if (UBrainComponent* Brain = Controller->GetBrainComponent()) {
+		if (Bucket.bPauseBehavior && !Entry.bBehaviorPaused && !Brain->IsPaused()) {
+			Brain->PauseLogic(TEXT("Dormant"));
+			Entry.bBehaviorPaused = true;
+		} else if (!Bucket.bPauseBehavior && Entry.bBehaviorPaused) {
+			Brain->ResumeLogic(TEXT("Dormant"));
+			Entry.bBehaviorPaused = false;
+		}
+	}
+	if (UAIPerceptionComponent* Perception = Controller->GetAIPerceptionComponent()) {
+		Perception->SetComponentTickInterval(Bucket.PerceptionTickInterval);
+		Perception->SetSenseEnabled(UAISense_Sight::StaticClass(), Bucket.bSight);
+	}
+
+	APawn* Pawn = Controller->GetPawn();
+	if (Pawn == nullptr) {
+		return;
+	}
+	Pawn->SetActorTickInterval(Bucket.ActorTickInterval);
+
+	if (ACharacter* Character = Cast<ACharacter>(Pawn)) {
+		if (UCharacterMovementComponent* Movement = Character->GetCharacterMovement()) {
+			Movement->SetComponentTickInterval(Bucket.MovementTickInterval);
+		}
+		if (USkeletalMeshComponent* Mesh = Character->GetMesh()) {
+			Mesh->SetComponentTickInterval(Bucket.AnimationTickInterval);
+			Mesh->VisibilityBasedAnimTickOption = Bucket.bAnimateWhenHidden
+				? Entry.DefaultAnimTickOption
+				: EVisibilityBasedAnimTickOption::OnlyTickMontagesWhenNotRendered;
+		}
+	}
+}
+
+void UAISignificanceSubsystem::UpdateViews()
+{
+	Views.Reset();
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It) {
+		if (const APlayerController* PlayerController = It->Get()) {
+			FVector Location;
+			FRotator Rotation;
+			PlayerController->GetPlayerViewPoint(Location, Rotation);
+			Views.Add(Location);
+		}
+	}
+}
@@ -0,0 +1,306 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AbilityPoolSubsystem.h"
+#include "AbilityStats.h"
+#include "PooledActor.h"
+#include "Engine/DataTable.h"
+#include "Engine/World.h"
+#include "TimerManager.h"
+#include "GameFramework/ProjectileMovementComponent.h"
+#include "Particles/ParticleSystemComponent.h"
+#include "UObject/UnrealType.h"
+
+// Where prewarmed instances run construction and BeginPlay, well above anything playable and clear of KillZ
+static const FVector PoolParkingLocation(0.0f, 0.0f, 1000000.0f);
+
+AActor* UAbilityPoolSubsystem::AcquireActor(TSubclassOf<AActor> Class, const FTransform& Transform, AActor* NewOwner, APawn* NewInstigator)
+{
+	FANTASY_SCOPE(STAT_AbilityAcquire);
+
+	UWorld* World = GetWorld();
+	if (Class == nullptr || World == nullptr) {
+		return nullptr;
+	}
+
+	FPool& Pool = Pools.FindOrAdd(Class.Get());
+	AActor* Actor = nullptr;
+	while (Actor == nullptr && Pool.Free.Num() > 0) {
+		Actor = Pool.Free.Pop(false).Get();
+	}
+
+	if (Actor != nullptr) {
+		++Pool.Stats.Hits;
+		INC_DWORD_STAT(STAT_AbilityPoolHits);
+		DEC_DWORD_STAT(STAT_AbilityPoolFree);
+	} else {
+		++Pool.Stats.Misses;
+		INC_DWORD_STAT(STAT_AbilityPoolMisses);
+		if (Pool.Stats.Active + Pool.Free.Num() >= MaxPerClass) {
+			// Over budget the cast still happens, it just is not pooled
+			++Pool.Stats.Overflows;
+			INC_DWORD_STAT(STAT_AbilityPoolOverflows);
+			FActorSpawnParameters Params;
+			Params.Owner = NewOwner;
+			Params.Instigator = NewInstigator;
+			Params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+			return World->SpawnActor<AActor>(Class, Transform, Params);
+		}
+	}
+
+	const bool bReused = Actor != nullptr;
+	if (!bReused) {
+		// An ordinary spawn where it is needed; it joins the pool when released
+		Actor = SpawnMember(Class, Transform, NewOwner, NewInstigator);
+		if (Actor == nullptr) {
+			return nullptr;
+		}
+	}
+
+	Members.FindChecked(Actor).bActive = true;
+	Pool.Stats.Active++;
+	Pool.Stats.Peak = FMath::Max(Pool.Stats.Peak, Pool.Stats.Active);
+	INC_DWORD_STAT(STAT_AbilityPoolActive);
+
+	if (bReused) {
+		Activate(*Actor, Transform, NewOwner, NewInstigator);
+	}
+	return Actor;
+}
+
+void UAbilityPoolSubsystem::ReleaseActor(AActor* Actor)
+{
+	FANTASY_SCOPE(STAT_AbilityRelease);
+
+	if (Actor == nullptr) {
+		return;
+	}
+	FMember* Member = Members.Find(Actor);
+	if (Member == nullptr) {
+		Actor->Destroy();
+		return;
+	}
+	if (!Member->bActive) {
+		return;
+	}
+
+	Member->bActive = false;
+	Deactivate(*Actor);
+
+	FPool& Pool = Pools.FindChecked(Actor->GetClass());
+	Pool.Stats.Active--;
+	Pool.Free.Add(Actor);
+	DEC_DWORD_STAT(STAT_AbilityPoolActive);
+	INC_DWORD_STAT(STAT_AbilityPoolFree);
+}
+
+void UAbilityPoolSubsystem::Prewarm(TSubclassOf<AActor> Class, int32 Count)
+{
+	FANTASY_SCOPE(STAT_AbilityPrewarm);
+
+	if (Class == nullptr || Class->HasAnyClassFlags(CLASS_Abstract)) {
+		return;
+	}
+
+	FPool& Pool = Pools.FindOrAdd(Class.Get());
+	const int32 Target = FMath::Min(Count, MaxPerClass - Pool.Stats.Active);
+	Pool.Free.Reserve(Target);
+	while (Pool.Free.Num() < Target) {
+		// Construction, components and BeginPlay all run now rather than on the first cast
+		AActor* Actor = SpawnMember(Class, FTransform(PoolParkingLocation), nullptr, nullptr);
+		if (Actor == nullptr) {
+			break;
+		}
+		Deactivate(*Actor);
+		Pool.Free.Add(Actor);
+		INC_DWORD_STAT(STAT_AbilityPoolFree);
+	}
+}
+
+FAbilityPoolStats UAbilityPoolSubsystem::GetPoolStats(TSubclassOf<AActor> Class) const
+{
+	const FPool* Pool = Pools.Find(Class.Get());
+	if (Pool == nullptr) {
+		return FAbilityPoolStats();
+	}
+	FAbilityPoolStats Stats = Pool->Stats;
+	Stats.Free = Pool->Free.Num();
+	return Stats;
+}
+
+FAbilityPoolStats UAbilityPoolSubsystem::GetTotalStats() const
+{
+	FAbilityPoolStats Total;
+	for (const TPair<TWeakObjectPtr<UClass>, FPool>& Pool : Pools) {
+		Total.Hits += Pool.Value.Stats.Hits;
+		Total.Misses += Pool.Value.Stats.Misses;
+		Total.Overflows += Pool.Value.Stats.Overflows;
+		Total.Active += Pool.Value.Stats.Active;
+		Total.Free += Pool.Value.Free.Num();
+		Total.Peak += Pool.Value.Stats.Peak;
+	}
+	return Total;
+}
+
+void UAbilityPoolSubsystem::DumpStats() const
+{
+	for (const TPair<TWeakObjectPtr<UClass>, FPool>& Pool : Pools) {
+		const FAbilityPoolStats& Stats = Pool.Value.Stats;
+		UE_LOG(LogTemp, Log, TEXT("Ability pool %s: %d hits, %d misses, %d over budget, %d active, %d free, peak %d"),
+			*GetNameSafe(Pool.Key.Get()), Stats.Hits, Stats.Misses, Stats.Overflows, Stats.Active, Pool.Value.Free.Num(), Stats.Peak);
+	}
+}
+
+void UAbilityPoolSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// Actors only get BeginPlay once the world has begun play, which happens after this returns
+	InWorld.GetTimerManager().SetTimerForNextTick(this, &UAbilityPoolSubsystem::PrewarmTables);
+}
+
+void UAbilityPoolSubsystem::PrewarmTables()
+{
+	TArray<UClass*> Classes;
+	CollectTableClasses(Classes);
+	for (UClass* Class : Classes) {
+		Prewarm(Class, PrewarmCount);
+	}
+	UE_LOG(LogTemp, Log, TEXT("Ability pool: prewarmed %d instances of %d classes"), GetTotalStats().Free, Classes.Num());
+}
+
+void UAbilityPoolSubsystem::Deinitialize()
+{
+	// The actors go with the level; only the counters need putting back
+	for (const TPair<TWeakObjectPtr<UClass>, FPool>& Pool : Pools) {
+		DEC_DWORD_STAT_BY(STAT_AbilityPoolActive, Pool.Value.Stats.Active);
+		DEC_DWORD_STAT_BY(STAT_AbilityPoolFree, Pool.Value.Free.Num());
+	}
+	Pools.Reset();
+	Members.Reset();
+
+	Super::Deinitialize();
+}
+
+AActor* UAbilityPoolSubsystem::SpawnMember(UClass* Class, const FTransform& Transform, AActor* NewOwner, APawn* NewInstigator)
+{
+	FActorSpawnParameters Params;
+	Params.Owner = NewOwner;
+	Params.Instigator = NewInstigator;
+	Params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	AActor* Actor = GetWorld()->SpawnActor<AActor>(Class, Transform, Params);
+	if (Actor == nullptr) {
+		return nullptr;
+	}
+
+	Members.Add(Actor);
+	Actor->OnDestroyed.AddDynamic(this, &UAbilityPoolSubsystem::OnMemberDestroyed);
+	return Actor;
+}
+
+void UAbilityPoolSubsystem::Activate(AActor& Actor, const FTransform& Transform, AActor* NewOwner, APawn* NewInstigator)
+{
+	Actor.SetOwner(NewOwner);
+	Actor.SetInstigator(NewInstigator);
+	Actor.SetActorTransform(Transform, false, nullptr, ETeleportType::ResetPhysics);
+	Actor.SetActorHiddenInGame(false);
+	Actor.SetActorEnableCollision(true);
+	Actor.SetActorTickEnabled(true);
+
+	TInlineComponentArray<UActorComponent*> Components(&Actor);
+	for (UActorComponent* Component : Components) {
+		if (UProjectileMovementComponent* Projectile = Cast<UProjectileMovementComponent>(Component)) {
+			// What InitializeComponent does on spawn: fly along the new facing at InitialSpeed
+			Projectile->SetUpdatedComponent(Actor.GetRootComponent());
+			Projectile->Velocity = Transform.GetRotation().GetForwardVector() * Projectile->InitialSpeed;
+			Projectile->SetComponentTickEnabled(true);
+		} else if (UFXSystemComponent* Effect = Cast<UFXSystemComponent>(Component)) {
+			if (Effect->bAutoActivate) {
+				Effect->Activate(true);
+			}
+		} else if (Component->bAutoActivate) {
+			Component->Activate(true);
+		}
+	}
+
+	if (Actor.Implements<UPooledActor>()) {
+		IPooledActor::Execute_OnAcquiredFromPool(&Actor);
+	}
+}
+
+void UAbilityPoolSubsystem::Deactivate(AActor& Actor)
+{
+	if (Actor.Implements<UPooledActor>()) {
+		IPooledActor::Execute_OnReleasedToPool(&Actor);
+	}
+
+	GetWorld()->GetTimerManager().ClearAllTimersForObject(&Actor);
+	Actor.SetLifeSpan(0.0f);
+	Actor.DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+	Actor.SetActorHiddenInGame(true);
+	Actor.SetActorEnableCollision(false);
+	Actor.SetActorTickEnabled(false);
+
+	TInlineComponentArray<UActorComponent*> Components(&Actor);
+	for (UActorComponent* Component : Components) {
+		if (UProjectileMovementComponent* Projectile = Cast<UProjectileMovementComponent>(Component)) {
+			Projectile->StopMovementImmediately();
+			Projectile->SetComponentTickEnabled(false);
+		} else if (UFXSystemComponent* Effect = Cast<UFXSystemComponent>(Component)) {
+			Effect->DeactivateImmediate();
+		} else if (Component->bAutoActivate) {
+			Component->Deactivate();
+		}
+	}
+}
+
+void UAbilityPoolSubsystem::CollectTableClasses(TArray<UClass*>& OutClasses) const
+{
+	for (const TSoftObjectPtr<UDataTable>& TablePtr : AbilityTables) {
+		const UDataTable* Table = TablePtr.LoadSynchronous();
+		const UScriptStruct* RowStruct = Table != nullptr ? Table->GetRowStruct() : nullptr;
+		if (RowStruct == nullptr) {
+			continue;
+		}
+
+		// The row structs are Blueprint structs, so look for actor classes by reflection
+		for (TFieldIterator<FProperty> It(RowStruct); It; ++It) {
+			const FClassProperty* ClassProperty = CastField<FClassProperty>(*It);
+			const FSoftClassProperty* SoftClassProperty = CastField<FSoftClassProperty>(*It);
+			const UClass* MetaClass = ClassProperty != nullptr ? ClassProperty->MetaClass : SoftClassProperty != nullptr ? SoftClassProperty->MetaClass : nullptr;
+			if (MetaClass == nullptr || !MetaClass->IsChildOf(AActor::StaticClass())) {
+				continue;
+			}
+
+			for (const TPair<FName, uint8*>& Row : Table->GetRowMap()) {
+				UClass* Class = nullptr;
+				if (ClassProperty != nullptr) {
+					Class = Cast<UClass>(ClassProperty->GetObjectPropertyValue_InContainer(Row.Value));
+				} else {
+					Class = Cast<UClass>(SoftClassProperty->GetPropertyValue_InContainer(Row.Value).LoadSynchronous());
+				}
+				if (Class != nullptr) {
+					OutClasses.AddUnique(Class);
+				}
+			}
+		}
+	}
+}
+
+void UAbilityPoolSubsystem::OnMemberDestroyed(AActor* Actor)
+{
+	FMember Member;
+	if (!Members.RemoveAndCopyValue(Actor, Member)) {
+		return;
+	}
+
+	// Something destroyed a pooled actor instead of releasing it; forget it so the pool can replace it
+	if (FPool* Pool = Pools.Find(Actor->GetClass())) {
+		if (Member.bActive) {
+			Pool->Stats.Active--;
+			DEC_DWORD_STAT(STAT_AbilityPoolActive);
+		} else if (Pool->Free.Remove(Actor) > 0) {
+			DEC_DWORD_STAT(STAT_AbilityPoolFree);
+		}
+	}
+}
@@ -0,0 +1,14 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AbilityStats.h"
+
+DEFINE_STAT(STAT_AbilityAcquire);
+DEFINE_STAT(STAT_AbilityRelease);
+DEFINE_STAT(STAT_AbilityPrewarm);
+
+DEFINE_STAT(STAT_AbilityPoolActive);
+DEFINE_STAT(STAT_AbilityPoolFree);
+DEFINE_STAT(STAT_AbilityPoolHits);
+DEFINE_STAT(STAT_AbilityPoolMisses);
+DEFINE_STAT(STAT_AbilityPoolOverflows);
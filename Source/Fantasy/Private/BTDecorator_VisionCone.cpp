@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BTDecorator_VisionCone.h"
+#include "VisionConeSubsystem.h"
+#include "AIController.h"
+#include "BehaviorTree/BehaviorTreeComponent.h"
+#include "BehaviorTree/BlackboardComponent.h"
+#include "BehaviorTree/BlackboardData.h"
+#include "Engine/World.h"
+
+UBTDecorator_VisionCone::UBTDecorator_VisionCone()
+{
+	NodeName = "Vision Cone";
+	TargetKey.AddObjectFilter(this, GET_MEMBER_NAME_CHECKED(UBTDecorator_VisionCone, TargetKey), AActor::StaticClass());
+	TargetKey.AllowNoneAsValue(true);
+
+	// Ticks only to notice the cached result changing and abort the running branch
+	bNotifyBecomeRelevant = true;
+	bNotifyTick = true;
+}
+
+void UBTDecorator_VisionCone::InitializeFromAsset(UBehaviorTree& Asset)
+{
+	Super::InitializeFromAsset(Asset);
+
+	if (const UBlackboardData* Blackboard = GetBlackboardAsset()) {
+		TargetKey.ResolveSelectedKey(*Blackboard);
+	}
+}
+
+bool UBTDecorator_VisionCone::CalculateRawConditionValue(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory) const
+{
+	const AAIController* Controller = OwnerComp.GetAIOwner();
+	const UVisionConeSubsystem* Vision = Controller != nullptr ? Controller->GetWorld()->GetSubsystem<UVisionConeSubsystem>() : nullptr;
+	if (Vision == nullptr) {
+		return false;
+	}
+
+	if (TargetKey.IsSet()) {
+		const UBlackboardComponent* Blackboard = OwnerComp.GetBlackboardComponent();
+		const AActor* Target = Blackboard != nullptr ? Cast<AActor>(Blackboard->GetValueAsObject(TargetKey.SelectedKeyName)) : nullptr;
+		return Target != nullptr && Vision->CanSee(Controller, Target);
+	}
+	return Vision->GetVisibleTarget(Controller) != nullptr;
+}
+
+uint16 UBTDecorator_VisionCone::GetInstanceMemorySize() const
+{
+	return sizeof(FVisionConeMemory);
+}
+
+FString UBTDecorator_VisionCone::GetStaticDescription() const
+{
+	const FString Target = TargetKey.IsSet() ? TargetKey.SelectedKeyName.ToString() : TEXT("any player");
+	return FString::Printf(TEXT("%s: can see %s"), *Super::GetStaticDescription(), *Target);
+}
+
+void UBTDecorator_VisionCone::OnBecomeRelevant(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory)
+{
+	reinterpret_cast<FVisionConeMemory*>(NodeMemory)->bLastValue = CalculateRawConditionValue(OwnerComp, NodeMemory);
+}
+
+void UBTDecorator_VisionCone::TickNode(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory, float DeltaSeconds)
+{
+	FVisionConeMemory* Memory = reinterpret_cast<FVisionConeMemory*>(NodeMemory);
+	const bool bValue = CalculateRawConditionValue(OwnerComp, NodeMemory);
+	if (bValue != Memory->bLastValue) {
+		Memory->bLastValue = bValue;
+		OwnerComp.RequestExecution(this);
+	}
+}
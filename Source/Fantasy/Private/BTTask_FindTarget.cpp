@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BTTask_FindTarget.h"
+#include "BaseCharacter.h"
+#include "FightDirectorSubsystem.h"
+#include "AIController.h"
+#include "BehaviorTree/BlackboardComponent.h"
+#include "Engine/World.h"
+
+UBTTask_FindTarget::UBTTask_FindTarget()
+{
+	NodeName = "Find Target";
+	BlackboardKey.AddObjectFilter(this, GET_MEMBER_NAME_CHECKED(UBTTask_FindTarget, BlackboardKey), AActor::StaticClass());
+
+	Query.Team = ETargetingTeamFilter::Hostile;
+	Query.CacheTime = 0.25f;
+}
+
+EBTNodeResult::Type UBTTask_FindTarget::ExecuteTask(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory)
+{
+	AAIController* Controller = OwnerComp.GetAIOwner();
+	APawn* Pawn = Controller != nullptr ? Controller->GetPawn() : nullptr;
+	UBlackboardComponent* Blackboard = OwnerComp.GetBlackboardComponent();
+	UTargetingSubsystem* Targeting = GetWorld()->GetSubsystem<UTargetingSubsystem>();
+	if (Pawn == nullptr || Blackboard == nullptr || Targeting == nullptr) {
+		return EBTNodeResult::Failed;
+	}
+
+	FTargetingQuery PawnQuery = Query;
+	PawnQuery.Querier = Pawn;
+	PawnQuery.Origin = Pawn->GetActorLocation();
+	PawnQuery.Direction = Pawn->GetActorForwardVector();
+
+	ABaseCharacter* Target = Targeting->FindBestTarget(PawnQuery);
+	Blackboard->SetValueAsObject(BlackboardKey.SelectedKeyName, Target);
+	if (UFightDirectorSubsystem* FightDirector = GetWorld()->GetSubsystem<UFightDirectorSubsystem>()) {
+		FightDirector->SetAttackTarget(Controller, Target);
+	}
+	return Target != nullptr ? EBTNodeResult::Succeeded : EBTNodeResult::Failed;
+}
+
+FString UBTTask_FindTarget::GetStaticDescription() const
+{
+	return FString::Printf(TEXT("%s: best target within %.0f, %.0f degrees"), *Super::GetStaticDescription(), Query.Range, Query.HalfAngle);
+}
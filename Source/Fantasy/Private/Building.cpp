@@ -5,11 +5,59 @@
 #include "ProceduralMeshComponent.h"
 #include <Components/SplineComponent.h>
 #include "KismetProceduralMeshLibrary.h"
-#include <Kismet/KismetMathLibrary.h>
 #include <DrawDebugHelpers.h>
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "BuildingGeometryCache.h"
+#include "BuildingStats.h"
 
 #define INDEX(_x, _y, _z) (((_z) * Length * Width) + ((_y) * Width) + (_x))
 
+static const TArray<FVector2D> NoUVs;
+static const TArray<FColor> NoColors;
+static const TArray<FProcMeshTangent> NoTangents;
+
+static void CountSections(UProceduralMeshComponent& Mesh, int64& Vertices, int64& Triangles, int32& Sections)
+{
+	for (int i = 0; i < Mesh.GetNumSections(); ++i) {
+		const FProcMeshSection* Section = Mesh.GetProcMeshSection(i);
+		if (Section != nullptr && Section->ProcVertexBuffer.Num() > 0) {
+			Vertices += Section->ProcVertexBuffer.Num();
+			Triangles += Section->ProcIndexBuffer.Num() / 3;
+			++Sections;
+		}
+	}
+}
+
+// Corner is the bottom left seen from outside; V runs down the quad, U along it every TileLength
+static void AddQuad(TMesh& Mesh, const FVector& Corner, const FVector& Right, float Width, float Height, float TileLength)
+{
+	const int First = Mesh.vertices.Num();
+	const FVector Normal = FVector::CrossProduct(FVector::UpVector, Right);
+	for (int Vertex = 0; Vertex < 4; ++Vertex) {
+		const float X = (Vertex == 1 || Vertex == 2) ? Width : 0.0f;
+		const float Z = Vertex >= 2 ? Height : 0.0f;
+		Mesh.vertices.Add(Corner + Right * X + FVector::UpVector * Z);
+		Mesh.normals.Add(Normal);
+		Mesh.tangents.Add(FProcMeshTangent(Right, false));
+		Mesh.uvs.Add(FVector2D(X / TileLength, Vertex >= 2 ? 0.0f : 1.0f));
+	}
+	// Clockwise seen from outside
+	Mesh.tris.Append({ First, First + 3, First + 2, First, First + 2, First + 1 });
+}
+
+// Upright sides of a box in the frame of Along and Across; ends only when it has some depth
+static void AddBoxSides(TMesh& Mesh, const FVector& Base, const FVector& Along, const FVector& Across, float MinX, float MaxX, float MinY, float MaxY, float Height, float TileLength)
+{
+	AddQuad(Mesh, Base + Along * MinX + Across * MaxY, Along, MaxX - MinX, Height, TileLength);
+	AddQuad(Mesh, Base + Along * MaxX + Across * MinY, -Along, MaxX - MinX, Height, TileLength);
+	if (MaxY - MinY > 1.0f) {
+		AddQuad(Mesh, Base + Along * MaxX + Across * MaxY, -Across, MaxY - MinY, Height, TileLength);
+		AddQuad(Mesh, Base + Along * MinX + Across * MinY, Across, MaxY - MinY, Height, TileLength);
+	}
+}
+
 // Sets default values
 ABuilding::ABuilding()
 {
@@ -28,6 +76,18 @@ ABuilding::ABuilding()
 
 ABuilding::~ABuilding()
 {
+	// Abandon any build still running on the workers
+	BuildSerial->Increment();
+}
+
+void ABuilding::BeginDestroy()
+{
+	if (bCounted) {
+		SetCounters(0, 0, 0, 0);
+		DEC_DWORD_STAT(STAT_BuildingCount);
+		bCounted = false;
+	}
+	Super::BeginDestroy();
 }
 
 
@@ -53,31 +113,211 @@ void ABuilding::OnConstruction(const FTransform& Transform)
 		}
 	}
 
+#if WITH_EDITOR
+	// Rapid edits, like dragging a spline point, only get the preview; Tick builds the real thing once they settle
+	const UWorld* World = GetWorld();
+	if (bInteractivePreview && World != nullptr && !World->IsGameWorld()) {
+		const double Now = FPlatformTime::Seconds();
+		const bool bRapid = bInteractiveEdit || bPreviewActive || Now - LastEditTime < PreviewSettleSeconds;
+		LastEditTime = Now;
+		if (bRapid) {
+			CreatePreview();
+			return;
+		}
+	}
+#endif
+
 	CreateMesh();
 }
 
+#if WITH_EDITOR
+void ABuilding::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	bInteractiveEdit = PropertyChangedEvent.ChangeType == EPropertyChangeType::Interactive;
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+}
+
+void ABuilding::PostEditMove(bool bFinished)
+{
+	bInteractiveEdit = !bFinished;
+	Super::PostEditMove(bFinished);
+}
+#endif
+
+bool ABuilding::ShouldTickIfViewportsOnly() const
+{
+	return bPreviewActive;
+}
+
+void ABuilding::CreatePreview()
+{
+	constexpr float PreviewDepth = 20.0f;
+
+	// Anything still generating is outdated by this edit
+	BuildSerial->Increment();
+	bBuildInFlight = false;
+	PendingUpload.Reset();
+
+	if (PreviewComponent == nullptr) {
+		PreviewComponent = CreateLODComponent(TEXT("Preview"));
+	}
+	if (!bPreviewActive) {
+		bPreviewActive = true;
+		MeshComponent->SetVisibility(false, true);
+		PreviewComponent->SetVisibility(true);
+	}
+
+	const int TotalBuildingSections = GetBuildingSectionCount();
+	uint32 SplineKey = GetTypeHash(TotalBuildingSections);
+	for (int BuildingSection = 0; BuildingSection < TotalBuildingSections; ++BuildingSection) {
+		SplineKey = HashCombine(SplineKey, GetSegmentKey(BuildingSection));
+	}
+	if (SplineKey != ArcLengthKey || ArcLengths.Distances.Num() == 0) {
+		ArcLengthKey = SplineKey;
+		ArcLengths.Build(*SplineComponent, TotalBuildingSections, ArcLengthSamplesPerSegment);
+	}
+
+	// Layout only needs to know which parts exist
+	FBuildingParts Parts;
+	Parts.Parts.SetNum(MeshTypes.Num());
+	Parts.Lengths.SetNum(MeshTypes.Num());
+	for (int meshType = 0; meshType < MeshTypes.Num(); ++meshType) {
+		Parts.Parts[meshType] = FBuildingPartCache::Get().Find(MeshTypes[meshType].StaticMesh);
+		Parts.Lengths[meshType] = MeshTypes[meshType].Length;
+	}
+	Parts.BuildViews();
+
+	TMesh& Mesh = UploadMesh;
+	Mesh.Presize(0, 0);
+	TMap<uint32, FBuildingLayoutPtr> Layouts;
+	float HeightOffset = 0;
+	for (const auto& floor : Floors) {
+		for (int BuildingSection = 0; BuildingSection < TotalBuildingSections; ++BuildingSection) {
+			const FBuildingLayoutPtr Layout = FindLayout(Layouts, Parts, floor.Sections[BuildingSection], BuildingSection);
+			for (const BuildingCore::FPlacement& Placement : Layout->Placements) {
+				const FVector Along = BuildingCore::GetRotation(Placement).Vector().GetSafeNormal2D();
+				if (Along.IsZero()) {
+					continue;
+				}
+				const float Width = MeshTypes[Placement.MeshType].Length * Layout->PatternScale;
+				AddBoxSides(Mesh, BuildingCore::ToVector(Placement.Start) + FVector::UpVector * HeightOffset, Along, FVector::CrossProduct(FVector::UpVector, Along),
+					0.0f, Width, -PreviewDepth * 0.5f, PreviewDepth * 0.5f, floor.Height, Width);
+			}
+		}
+		HeightOffset += floor.Height;
+	}
+
+	PreviewComponent->ClearAllMeshSections();
+	if (Mesh.vertices.Num() > 0) {
+		PreviewComponent->CreateMeshSection(0, Mesh.vertices, Mesh.tris, Mesh.normals, Mesh.uvs, NoUVs, NoUVs, NoUVs, NoColors, Mesh.tangents, false);
+	}
+}
+
+void ABuilding::EndPreview()
+{
+	bPreviewActive = false;
+	if (PreviewComponent != nullptr) {
+		PreviewComponent->DestroyComponent();
+		PreviewComponent = nullptr;
+	}
+	MeshComponent->SetVisibility(true, true);
+}
+
 // Called when the game starts or when spawned
 void ABuilding::BeginPlay()
 {
 	Super::BeginPlay();
-	
+
+	RegisterCoverPoints();
+}
+
+void ABuilding::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UCoverPointSubsystem* Cover = GetWorld()->GetSubsystem<UCoverPointSubsystem>()) {
+		Cover->UnregisterBuilding(this);
+	}
+	Super::EndPlay(EndPlayReason);
+}
+
+int ABuilding::GetBuildingSectionCount() const
+{
+	const int pointCount = SplineComponent->GetNumberOfSplinePoints();
+	int TotalBuildingSections = pointCount - 1;
+	if (SplineComponent->IsClosedLoop()) {
+		++TotalBuildingSections;
+	}
+	return FMath::Max(0, TotalBuildingSections);
+}
+
+uint32 ABuilding::GetMeshTypesKey() const
+{
+	uint32 Key = GetTypeHash(MeshTypes.Num());
+	for (const auto& MeshType : MeshTypes) {
+		// Path rather than pointer, so the key also holds for the on-disk geometry cache
+		Key = HashCombine(Key, GetTypeHash(GetPathNameSafe(MeshType.StaticMesh)));
+		Key = HashCombine(Key, GetTypeHash(MeshType.Length));
+		Key = HashCombine(Key, GetTypeHash(MeshType.Height));
+	}
+	return Key;
+}
+
+uint32 ABuilding::GetSegmentKey(int BuildingSection) const
+{
+	const int pointCount = SplineComponent->GetNumberOfSplinePoints();
+	const bool closedLoop = SplineComponent->IsClosedLoop();
+
+	uint32 Key = HashCombine(GetTypeHash(closedLoop), GetTypeHash(ArcLengthSamplesPerSegment));
+	// The last pattern item of a segment aims past its end point, so the point after that matters as well
+	for (int i = BuildingSection; i <= BuildingSection + 2; ++i) {
+		const int point = closedLoop ? i % pointCount : FMath::Min(i, pointCount - 1);
+		Key = HashCombine(Key, GetTypeHash(SplineComponent->GetLocationAtSplinePoint(point, ESplineCoordinateSpace::Local)));
+		Key = HashCombine(Key, GetTypeHash(SplineComponent->GetArriveTangentAtSplinePoint(point, ESplineCoordinateSpace::Local)));
+		Key = HashCombine(Key, GetTypeHash(SplineComponent->GetLeaveTangentAtSplinePoint(point, ESplineCoordinateSpace::Local)));
+		Key = HashCombine(Key, GetTypeHash(static_cast<uint8>(SplineComponent->GetSplinePointType(point))));
+	}
+	return Key;
 }
 
-struct TMesh {
-	TArray<FVector> vertices;
-	TArray<int32> tris;
-	TArray<FVector2D> uvs;
-	TArray<FVector> normals;
-	TArray<FProcMeshTangent> tangents;
-	int triangleCount = 0;
-};
+uint32 ABuilding::GetFillKey(float HeightOffset) const
+{
+	uint32 Key = GetTypeHash(FillTop);
+	Key = HashCombine(Key, GetTypeHash(FillBottom));
+	if (!FillTop && !FillBottom) {
+		return Key;
+	}
+
+	Key = HashCombine(Key, GetTypeHash(HeightOffset - TopSink));
+	Key = HashCombine(Key, GetTypeHash(FillMode));
+	Key = HashCombine(Key, GetTypeHash(FillSubdivisions));
+	Key = HashCombine(Key, GetTypeHash(FillSimplifyTolerance));
+	Key = HashCombine(Key, GetTypeHash(GetTransform().ToMatrixWithScale().ComputeHash()));
+	for (int BuildingSection = 0; BuildingSection < GetBuildingSectionCount(); ++BuildingSection) {
+		Key = HashCombine(Key, GetSegmentKey(BuildingSection));
+	}
+	return Key;
+}
 
 void ABuilding::CreateMesh()
 {
-	MeshComponent->ClearAllMeshSections();
+	FANTASY_SCOPE(STAT_BuildingCreateMesh);
 
-	TMap<UMaterialInterface*, TMesh> Meshes;
+	TSharedRef<FBuildingBuild, ESPMode::ThreadSafe> Build = MakeShared<FBuildingBuild, ESPMode::ThreadSafe>();
+	Build->Serial = BuildSerial->Increment();
+	bBuildInFlight = false;
+	PendingUpload.Reset();
+	Timings = FBuildingTimings();
+	double PhaseStart = FPlatformTime::Seconds();
+
+	FBuildingParts& Parts = Build->Parts;
+	Parts.Parts.SetNum(MeshTypes.Num());
+	Parts.SectionSlots.SetNum(MeshTypes.Num());
+	Parts.Lengths.SetNum(MeshTypes.Num());
+	Parts.Heights.SetNum(MeshTypes.Num());
+
+	TArray<UMaterialInterface*> NewMaterialSlots;
 	for (int meshType = 0; meshType < MeshTypes.Num(); ++meshType) {
+		Parts.Lengths[meshType] = MeshTypes[meshType].Length;
+		Parts.Heights[meshType] = MeshTypes[meshType].Height;
 		if (MeshTypes[meshType].StaticMesh == nullptr) {
 			continue;
 		}
@@ -85,262 +325,1473 @@ void ABuilding::CreateMesh()
 		const auto& DebugMaterials = MeshTypes[meshType].StaticMesh->GetStaticMaterials();
 		for (int material = 0; material < DebugMaterials.Num(); ++material) {
 			const auto& Material = DebugMaterials[material];
-			Meshes.FindOrAdd(Material.MaterialInterface, TMesh());
+			NewMaterialSlots.AddUnique(Material.MaterialInterface);
+		}
+
+		Parts.Parts[meshType] = FBuildingPartCache::Get().Find(MeshTypes[meshType].StaticMesh);
+	}
+
+	for (int meshType = 0; meshType < MeshTypes.Num(); ++meshType) {
+		if (Parts.Parts[meshType].IsValid()) {
+			for (const auto& PartSection : Parts.Parts[meshType]->Sections) {
+				Parts.SectionSlots[meshType].Add(NewMaterialSlots.IndexOfByKey(PartSection.Material));
+			}
+		}
+	}
+	Parts.BuildViews();
+
+	const int TotalBuildingSections = GetBuildingSectionCount();
+	uint32 NewMeshTypesKey = GetMeshTypesKey();
+	for (const auto& Part : Parts.Parts) {
+		NewMeshTypesKey = HashCombine(NewMeshTypesKey, Part.IsValid() ? Part->Version : 0);
+	}
+	NewMeshTypesKey = HashCombine(NewMeshTypesKey, GetTypeHash(bOptimizeMeshes));
+	// Section collision flags and batching are decided on upload, so they need a full re-upload
+	NewMeshTypesKey = HashCombine(NewMeshTypesKey, GetTypeHash(CollisionMode));
+	NewMeshTypesKey = HashCombine(NewMeshTypesKey, GetTypeHash(bBatchMaterials));
+	if (bBatchMaterials) {
+		NewMeshTypesKey = HashCombine(NewMeshTypesKey, GetTypeHash(GetPathNameSafe(BatchedMaterial)));
+		for (const UMaterialInterface* Material : BatchLayerMaterials) {
+			NewMeshTypesKey = HashCombine(NewMeshTypesKey, GetTypeHash(GetPathNameSafe(Material)));
 		}
 	}
+	for (const UMaterialInterface* Material : ComplexCollisionMaterials) {
+		NewMeshTypesKey = HashCombine(NewMeshTypesKey, GetTypeHash(GetPathNameSafe(Material)));
+	}
+	if (bOptimizeMeshes) {
+		NewMeshTypesKey = HashCombine(NewMeshTypesKey, GetTypeHash(WeldTolerance));
+	}
+
+	TArray<uint32> SegmentKeys;
+	SegmentKeys.SetNumUninitialized(TotalBuildingSections);
+	uint32 SplineKey = GetTypeHash(TotalBuildingSections);
+	for (int BuildingSection = 0; BuildingSection < TotalBuildingSections; ++BuildingSection) {
+		SegmentKeys[BuildingSection] = GetSegmentKey(BuildingSection);
+		SplineKey = HashCombine(SplineKey, SegmentKeys[BuildingSection]);
+	}
+
+	if (SplineKey != ArcLengthKey || ArcLengths.Distances.Num() == 0) {
+		ArcLengthKey = SplineKey;
+		ArcLengths.Build(*SplineComponent, TotalBuildingSections, ArcLengthSamplesPerSegment);
+	}
+	Timings.Parts = FPlatformTime::Seconds() - PhaseStart;
+
+	UpdateCoverPoints(Parts, SegmentKeys);
+
+	if (OutputMode == EBuildingOutputMode::Instanced) {
+		// Merged geometry is regenerated from scratch when switching back
+		if (MaterialSlots.Num() > 0 || Chunks.Num() > 0) {
+			MeshComponent->ClearAllMeshSections();
+			MaterialSlots.Reset();
+			Chunks.Reset();
+			MeshTypesKey = 0;
+			FillKey = 0;
+		}
+		DestroyLODComponents();
+		CreateInstances(Parts, SegmentKeys);
+		return;
+	}
+	DestroyInstanceComponents();
+	if (!bGenerateLODs) {
+		DestroyLODComponents();
+	}
+
+	// Anything that changes the section layout invalidates every chunk
+	const bool rebuildAll = NewMaterialSlots != MaterialSlots
+		|| NewMeshTypesKey != MeshTypesKey
+		|| TotalBuildingSections != ChunkSections
+		|| Chunks.Num() != Floors.Num() * TotalBuildingSections;
+	if (rebuildAll) {
+		MaterialSlots = MoveTemp(NewMaterialSlots);
+		MeshTypesKey = NewMeshTypesKey;
+		ChunkSections = TotalBuildingSections;
+		Chunks.Reset();
+		Chunks.SetNum(Floors.Num() * TotalBuildingSections);
+		LODChunks.Reset();
+		bSectionsStale = true;
+		PendingMaterials.Init(true, MaterialSlots.Num());
+	}
+	Build->SlotCount = MaterialSlots.Num();
+
+	TArray<uint32> ChunkKeys;
+	TArray<float> HeightOffsets;
+	ChunkKeys.SetNumUninitialized(Chunks.Num());
+	HeightOffsets.SetNumUninitialized(Floors.Num());
 
 	float HeightOffset = 0;
+	bool anyValid = false;
 	for (int f = 0; f < Floors.Num(); ++f) {
 		const auto& floor = Floors[f];
+		HeightOffsets[f] = HeightOffset;
+
+		uint32 FloorKey = HashCombine(MeshTypesKey, GetTypeHash(HeightOffset));
+		FloorKey = HashCombine(FloorKey, GetTypeHash(floor.Height));
 
-		const int pointCount = SplineComponent->GetNumberOfSplinePoints();
-		int TotalBuildingSections = pointCount - 1;
-		if (SplineComponent->IsClosedLoop()) {
-			++TotalBuildingSections;
-		}
 		for (int BuildingSection = 0; BuildingSection < TotalBuildingSections; ++BuildingSection) {
-			const auto& currentSection = floor.Sections[BuildingSection];
+			const uint32 LayoutKey = HashCombine(SegmentKeys[BuildingSection], GetPatternKey(floor.Sections[BuildingSection]));
+			const int ChunkIndex = f * TotalBuildingSections + BuildingSection;
+			ChunkKeys[ChunkIndex] = HashCombine(FloorKey, LayoutKey);
+			anyValid |= Chunks[ChunkIndex].bValid;
+		}
+		HeightOffset += Floors[f].Height;
+	}
+	Build->TotalHeight = HeightOffset;
 
-			const float startDistance = SplineComponent->GetDistanceAlongSplineAtSplinePoint(BuildingSection);
-			const float endDistance = SplineComponent->GetDistanceAlongSplineAtSplinePoint(BuildingSection + 1);
+	// Floors sharing a segment pattern share its layout
+	TMap<uint32, FBuildingLayoutPtr> Layouts;
 
-			const float distance = endDistance - startDistance;
+	// With nothing generated yet, the whole building may be on disk already
+	Build->bFullBuild = !anyValid;
+	if (bUseGeometryCache && Build->bFullBuild) {
+		Build->CacheKey = GetGeometryCacheKey(ChunkKeys, GetFillKey(HeightOffset));
+		PhaseStart = FPlatformTime::Seconds();
+		TBitArray<> CollisionSections(false, MaterialSlots.Num() + 2);
+		for (int i = 0; i < CollisionSections.Num(); ++i) {
+			CollisionSections[i] = HasSectionCollision(i);
+		}
+		if (FBuildingGeometryCache::Load(Build->CacheKey, *MeshComponent, MaterialSlots.Num() + 2, CollisionSections)) {
+			FillKey = GetFillKey(HeightOffset);
+			UpdateCollision(Parts, HeightOffset, true);
+			// The uploaded sections came from disk, the next build replaces all of them
+			bSectionsStale = true;
+			ApplyMaterials();
+			Timings.Upload = FPlatformTime::Seconds() - PhaseStart;
 
-			const int patternSize = currentSection.Pattern.Num();
-			
-			float patternLength = 0.0f;
-			int patternCount;
-			for (patternCount = 0; patternLength < distance; ++patternCount) {
-				const int patternS = patternCount % patternSize;
-				const int& PatternSectionIndex = currentSection.Pattern[patternS];
-				const auto& PatternItem = MeshTypes[PatternSectionIndex];
+			int64 Vertices = 0;
+			int64 Triangles = 0;
+			int32 Sections = 0;
+			CountSections(*MeshComponent, Vertices, Triangles, Sections);
+			SetCounters(Vertices, Triangles, Sections, BuildingMemory::GetMergedBytes(Vertices, Triangles * 3));
 
-				patternLength += PatternItem.Length;
+			// The cache holds LOD0 only
+			if (bGenerateLODs) {
+				Build->bLODOnly = true;
+				AddLODJobs(*Build, Layouts, ChunkKeys, HeightOffsets);
+				StartBuild(Build);
 			}
-			const float patternScale = distance / patternLength;
+			return;
+		}
+	}
 
-			float currentLength = 0;
-			for (int PatternSection = 0; PatternSection < patternCount; ++PatternSection) {
-				const int PatternS = PatternSection % patternSize;
-				const int& PatternSectionIndex = currentSection.Pattern[PatternS];
-				const auto& PatternItem = MeshTypes[PatternSectionIndex];
+	for (int f = 0; f < Floors.Num(); ++f) {
+		const auto& floor = Floors[f];
 
-				float a = startDistance + currentLength;
-				float b = a + PatternItem.Length;
-				currentLength += PatternItem.Length * patternScale;
+		for (int BuildingSection = 0; BuildingSection < TotalBuildingSections; ++BuildingSection) {
+			const int ChunkIndex = f * TotalBuildingSections + BuildingSection;
+			const uint32 Key = ChunkKeys[ChunkIndex];
+			if (Chunks[ChunkIndex].bValid && Chunks[ChunkIndex].Key == Key) {
+				++Build->SegmentsReused;
+				continue;
+			}
 
-				FVector startPosition = SplineComponent->GetLocationAtDistanceAlongSpline(a, ESplineCoordinateSpace::Local);
-				FVector endPosition = SplineComponent->GetLocationAtDistanceAlongSpline(b, ESplineCoordinateSpace::Local);
+			// Sections the chunk contributed to need uploading again, whichever build ends up replacing it
+			FBuildingChunk& Chunk = Chunks[ChunkIndex];
+			for (int material = 0; material < Chunk.Meshes.Num(); ++material) {
+				if (Chunk.Meshes[material].vertices.Num() > 0) {
+					PendingMaterials[material] = true;
+				}
+			}
 
-				FVector ZOffset = FVector::UpVector * HeightOffset;
-				if (MeshTypes.Num() == 0
-					|| MeshTypes[PatternSectionIndex].StaticMesh == nullptr) {
-					break; // ERROR
-				} else {
-					UStaticMesh const * StaticMesh = PatternItem.StaticMesh;
-					const auto& MeshLOD0 = StaticMesh->GetRenderData()->LODResources[0];
-					
-					for (int meshSectionIndex = 0; meshSectionIndex < MeshLOD0.Sections.Num(); ++meshSectionIndex) {
-						const auto& meshSection = MeshLOD0.Sections[meshSectionIndex];
-						const auto& material = StaticMesh->GetMaterial(meshSection.MaterialIndex);
-
-						FTransform transform = FTransform(
-							UKismetMathLibrary::FindLookAtRotation(startPosition, endPosition),
-							startPosition + ZOffset,
-							FVector(patternScale, 1.0f, floor.Height / PatternItem.Height));
-						FTransform normalTransform = FTransform(
-							UKismetMathLibrary::FindLookAtRotation(startPosition, endPosition),
-							FVector::ZeroVector,
-							FVector::OneVector);
-
-						const auto addVertex = [&](int index) {
-							FVector pos = MeshLOD0.VertexBuffers.PositionVertexBuffer.VertexPosition(index);
-							// TODO: Scale
-							FVector newPos = transform.TransformPosition(pos);
-							Meshes[material].vertices.Add(newPos);
-							Meshes[material].uvs.Add(MeshLOD0.VertexBuffers.StaticMeshVertexBuffer.GetVertexUV(index, 0));
-							Meshes[material].normals.Add(normalTransform.TransformVector(MeshLOD0.VertexBuffers.StaticMeshVertexBuffer.VertexTangentZ(index)));
-							Meshes[material].tangents.Add(FProcMeshTangent(
-								normalTransform.TransformVector(MeshLOD0.VertexBuffers.StaticMeshVertexBuffer.VertexTangentX(index)), false));
-						};
-
-						for (uint32 v = meshSection.MinVertexIndex; v <= meshSection.MaxVertexIndex; ++v) {
-							addVertex(v);
-						}
+			// The new chunk is generated into the old one's buffers
+			FBuildingChunk& Result = Build->Results.AddDefaulted_GetRef();
+			Result.Meshes = MoveTemp(Chunk.Meshes);
+			Chunk.bValid = false;
 
-						for (uint32 t = 0; t < meshSection.NumTriangles; ++t) {
-							int tIndex = t * 3 + meshSection.FirstIndex;
+			FBuildingChunkJob& Job = Build->Jobs.AddDefaulted_GetRef();
+			Job.Chunk = ChunkIndex;
+			Job.Key = Key;
+			Job.HeightOffset = HeightOffsets[f];
+			Job.FloorHeight = floor.Height;
+			Job.bOptimize = bOptimizeMeshes;
+			Job.WeldTolerance = WeldTolerance;
 
-							int offset = Meshes[material].triangleCount - meshSection.MinVertexIndex;
-							Meshes[material].tris.Add(offset + MeshLOD0.IndexBuffer.GetIndex(tIndex));
-							Meshes[material].tris.Add(offset + MeshLOD0.IndexBuffer.GetIndex(tIndex + 1));
-							Meshes[material].tris.Add(offset + MeshLOD0.IndexBuffer.GetIndex(tIndex + 2));
-						}
-						Meshes[material].triangleCount = Meshes[material].vertices.Num();
-					}
-				}
-			}
+			PhaseStart = FPlatformTime::Seconds();
+			Job.Layout = FindLayout(Layouts, Parts, floor.Sections[BuildingSection], BuildingSection);
+			Timings.Layout += FPlatformTime::Seconds() - PhaseStart;
 		}
-		HeightOffset += Floors[f].Height;
 	}
 
-	if (FillTop || FillBottom) {
-		constexpr float TriangleSize = 64.0f;
+	if (bGenerateLODs) {
+		AddLODJobs(*Build, Layouts, ChunkKeys, HeightOffsets);
+	}
+	StartBuild(Build);
+}
 
-		const auto& ComponentBounds = SplineComponent->Bounds.BoxExtent;
-		const auto& ComponentOrigin = SplineComponent->Bounds.Origin;
-		int NumX = FMath::CeilToInt((ComponentBounds.X / TriangleSize) + 1);
-		int NumY = FMath::CeilToInt((ComponentBounds.Y / ((TriangleSize / 2.0f) * FMath::Tan(FMath::DegreesToRadians(60)))) + 1);
+void ABuilding::StartBuild(const TSharedRef<FBuildingBuild, ESPMode::ThreadSafe>& Build)
+{
+	if (bRepeatFloors) {
+		Build->SegmentsRepeated = LinkRepeatedJobs(Build->Jobs);
+		LinkRepeatedJobs(Build->LODJobs);
+	}
 
-		TArray<FVector> generalVertices;
-		TArray<int8> pointIndex;
-		for (int y = -NumY; y <= NumY; ++y) {
-			for (int x = -NumX; x <= NumX; ++x) {
-				int CurrentX = ComponentOrigin.X + (TriangleSize * x) + ((TriangleSize / 2.0f) * (FMath::Abs(y + NumY) % 2));
-				int CurrentY = ComponentOrigin.Y + (TriangleSize / 2.0f * FMath::Tan(FMath::DegreesToRadians(60)) * y);
-				FVector CurrentLocation(CurrentX, CurrentY, ComponentOrigin.Z);
-				
-				FVector CurrentEdgeLocation = SplineComponent->FindLocationClosestToWorldLocation(CurrentLocation, ESplineCoordinateSpace::World);
-				FVector DistanceClosest = SplineComponent->FindDirectionClosestToWorldLocation(CurrentLocation, ESplineCoordinateSpace::World);
-				const bool inside = FVector::DotProduct(CurrentEdgeLocation - CurrentLocation, FVector::CrossProduct(FVector::UpVector, DistanceClosest)) > 0;
-				const bool edge = (CurrentEdgeLocation - CurrentLocation).Size() < TriangleSize;
+	if (!bAsyncGeneration || (Build->Jobs.Num() == 0 && Build->LODJobs.Num() == 0)) {
+		GenerateChunks(*Build, *BuildSerial);
+		ApplyBuild(*Build);
+		return;
+	}
 
-				if (inside) {
-					// Inside
-					generalVertices.Add(CurrentLocation);
-					pointIndex.Add(0);
-				} else if (edge) {
-					// Edge
-					generalVertices.Add(CurrentEdgeLocation);
-					pointIndex.Add(1);
+	bBuildInFlight = true;
+	TWeakObjectPtr<ABuilding> WeakThis(this);
+	TSharedRef<FThreadSafeCounter, ESPMode::ThreadSafe> LatestSerial = BuildSerial;
+	Async(EAsyncExecution::TaskGraph, [WeakThis, Build, LatestSerial]() {
+		if (!GenerateChunks(*Build, *LatestSerial)) {
+			return;
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Build]() {
+			ABuilding* Building = WeakThis.Get();
+			if (Building != nullptr && Building->BuildSerial->GetValue() == Build->Serial) {
+				Building->bBuildInFlight = false;
+				if (Building->bUploadScheduled) {
+					Building->PendingUpload = Build;
 				} else {
-					// Outside
-					generalVertices.Add(CurrentLocation);
-					pointIndex.Add(-1);
+					Building->ApplyBuild(*Build);
 				}
 			}
-		}
+		});
+	});
+}
 
-		float Scale;
-		constexpr float Padding = 0.0f;
-		if (ComponentOrigin.X > ComponentOrigin.Y) {
-			Scale = (1 - Padding) / (ComponentOrigin.X * 2);
-		} else {
-			Scale = (1 - Padding) / (ComponentOrigin.Y * 2);
-		}
-		const FVector OriginScaled = Scale * ComponentOrigin;
-		TArray<FVector2D> UVs;
-		for (int i = 0; i < generalVertices.Num(); ++i) {
-			UVs.Add(FVector2D(
-				generalVertices[i].X * Scale + 0.5f + (OriginScaled.X * -1),
-				generalVertices[i].Y * Scale + 0.5f + (OriginScaled.Y * -1)));
-		}
+void ABuilding::ApplyPendingUpload()
+{
+	if (PendingUpload.IsValid()) {
+		TSharedPtr<FBuildingBuild, ESPMode::ThreadSafe> Build = MoveTemp(PendingUpload);
+		ApplyBuild(*Build);
+	}
+}
 
-		const int GridX = NumX * 2;
-		if (FillBottom) {
-			TArray<FVector> vertices;
-			TArray<FVector> normals;
-			TArray<int32> triangles;
+void ABuilding::AddLODJobs(FBuildingBuild& Build, TMap<uint32, FBuildingLayoutPtr>& Layouts, const TArray<uint32>& ChunkKeys, const TArray<float>& HeightOffsets)
+{
+	FBuildingParts& LODParts = Build.LODParts;
+	LODParts.Parts.SetNum(MeshTypes.Num());
+	LODParts.SectionSlots.SetNum(MeshTypes.Num());
+	LODParts.Lengths = Build.Parts.Lengths;
+	LODParts.Heights = Build.Parts.Heights;
 
-			for (int i = GridX + 1; i <= generalVertices.Num() - 2; ++i) {
-				if ((i + 1) % (GridX + 1) == 0) {
-					continue;
-				}
-				int a = ((((i / (GridX + 1)) % 2) * -1) + 1) + i;
-				int b = i - (GridX + 1);
-				int c = i - (GridX + 1) + 1;
-
-				if (pointIndex[a] >= 0 && pointIndex[b] >= 0 && pointIndex[c] >= 0) {
-					// Inverted Tris
-					triangles.Add(a);
-					triangles.Add(b);
-					triangles.Add(c);
-				}
+	uint32 PartsKey = GetTypeHash(LODPartLevel);
+	for (int meshType = 0; meshType < MeshTypes.Num(); ++meshType) {
+		LODParts.Parts[meshType] = FBuildingPartCache::Get().Find(MeshTypes[meshType].StaticMesh, LODPartLevel);
+		if (!LODParts.Parts[meshType].IsValid()) {
+			continue;
+		}
+		// Materials LOD0 never uses have no slot, their sections are left out
+		for (const auto& PartSection : LODParts.Parts[meshType]->Sections) {
+			LODParts.SectionSlots[meshType].Add(MaterialSlots.IndexOfByKey(PartSection.Material));
+		}
+		PartsKey = HashCombine(PartsKey, LODParts.Parts[meshType]->Version);
+	}
+	LODParts.BuildViews();
 
-				a = i;
-				b = i - ((GridX + 1) - ((i / (GridX + 1)) % 2));
-				c = i + 1;
+	if (LODChunks.Num() != Chunks.Num()) {
+		LODChunks.Reset();
+		LODChunks.SetNum(Chunks.Num());
+	}
 
-				if (pointIndex[a] >= 0 && pointIndex[b] >= 0 && pointIndex[c] >= 0) {
-					// Tris
-					triangles.Add(a);
-					triangles.Add(b);
-					triangles.Add(c);
-				}
+	const int TotalBuildingSections = ChunkSections;
+	for (int f = 0; f < Floors.Num(); ++f) {
+		const auto& floor = Floors[f];
+		for (int BuildingSection = 0; BuildingSection < TotalBuildingSections; ++BuildingSection) {
+			const int ChunkIndex = f * TotalBuildingSections + BuildingSection;
+			const uint32 Key = HashCombine(ChunkKeys[ChunkIndex], PartsKey);
+			FBuildingChunk& Chunk = LODChunks[ChunkIndex];
+			if (Chunk.bValid && Chunk.Key == Key) {
+				continue;
 			}
 
-			for (int i = 0; i < generalVertices.Num(); ++i) {
-				normals.Add(FVector::DownVector);
-				vertices.Add(GetTransform().InverseTransformPosition(generalVertices[i]));
-			}
+			FBuildingChunk& Result = Build.LODResults.AddDefaulted_GetRef();
+			Result.Meshes = MoveTemp(Chunk.Meshes);
+			Chunk.bValid = false;
 
-			MeshComponent->CreateMeshSection(Meshes.Num(), vertices, triangles, normals, UVs, TArray<FVector2D>(), TArray<FVector2D>(), TArray<FVector2D>(), TArray<FColor>(), TArray<FProcMeshTangent>(), true);
-			MeshComponent->SetMaterial(Meshes.Num(), BottomMaterial);
+			// Same layout as LOD0, so the two line up when they swap
+			FBuildingChunkJob& Job = Build.LODJobs.AddDefaulted_GetRef();
+			Job.Chunk = ChunkIndex;
+			Job.Key = Key;
+			Job.HeightOffset = HeightOffsets[f];
+			Job.FloorHeight = floor.Height;
+			Job.bOptimize = bOptimizeMeshes;
+			Job.WeldTolerance = WeldTolerance;
+			Job.Layout = FindLayout(Layouts, Build.Parts, floor.Sections[BuildingSection], BuildingSection);
 		}
+	}
+}
 
-		if (FillTop) {
-			TArray<FVector> vertices;
-			TArray<FVector> normals;
-			TArray<int32> triangles;
+uint32 ABuilding::GetPatternKey(const FBuildingSection& Section)
+{
+	uint32 Key = GetTypeHash(Section.Pattern.Num());
+	for (uint8 PatternIndex : Section.Pattern) {
+		Key = HashCombine(Key, GetTypeHash(PatternIndex));
+	}
+	return Key;
+}
 
-			for (int i = GridX + 1; i <= generalVertices.Num() - 2; ++i) {
-				if ((i + 1) % (GridX + 1) == 0) {
-					continue;
-				}
-				int a = ((((i / (GridX + 1)) % 2) * -1) + 1) + i;
-				int b = i - (GridX + 1) + 1;
-				int c = i - (GridX + 1);
-
-				if (pointIndex[a] >= 0 && pointIndex[b] >= 0 && pointIndex[c] >= 0) {
-					// Inverted Tris
-					triangles.Add(a);
-					triangles.Add(b);
-					triangles.Add(c);
-				}
+FBuildingLayoutPtr ABuilding::FindLayout(TMap<uint32, FBuildingLayoutPtr>& Layouts, const FBuildingParts& Parts, const FBuildingSection& Section, int BuildingSection) const
+{
+	FBuildingLayoutPtr& Layout = Layouts.FindOrAdd(HashCombine(GetPatternKey(Section), GetTypeHash(BuildingSection)));
+	if (!Layout.IsValid()) {
+		Layout = LayoutSegment(Parts, Section, BuildingSection);
+	}
+	return Layout;
+}
 
-				a = i;
-				b = i + 1;
-				c = i - ((GridX + 1) - ((i / (GridX + 1)) % 2));
+FBuildingLayoutPtr ABuilding::LayoutSegment(const FBuildingParts& Parts, const FBuildingSection& currentSection, int BuildingSection) const
+{
+	FANTASY_SCOPE(STAT_BuildingLayout);
 
-				if (pointIndex[a] >= 0 && pointIndex[b] >= 0 && pointIndex[c] >= 0) {
-					// Tris
-					triangles.Add(a);
-					triangles.Add(b);
-					triangles.Add(c);
-				}
+	TSharedPtr<FBuildingLayout, ESPMode::ThreadSafe> Layout = MakeShared<FBuildingLayout, ESPMode::ThreadSafe>();
+	BuildingCore::LayoutSegment(ArcLengths.GetView(), BuildingSection, currentSection.Pattern.GetData(), currentSection.Pattern.Num(), Parts.Views, *Layout);
+	return Layout;
+}
+
+bool ABuilding::GenerateChunks(FBuildingBuild& Build, const FThreadSafeCounter& LatestSerial)
+{
+	check(Build.Results.Num() == Build.Jobs.Num());
+	check(Build.LODResults.Num() == Build.LODJobs.Num());
+	const double Start = FPlatformTime::Seconds();
+	const int JobCount = Build.Jobs.Num();
+	Build.OptimizeStats.SetNum(JobCount + Build.LODJobs.Num());
+
+	// Distinct chunks first, then the repeats copy them
+	for (const bool bRepeats : { false, true }) {
+		ParallelFor(JobCount + Build.LODJobs.Num(), [&Build, &LatestSerial, JobCount, bRepeats](int32 JobIndex) {
+			if (LatestSerial.GetValue() != Build.Serial) {
+				return; // Stale
+			}
+			const bool bLOD = JobIndex >= JobCount;
+			const int ListIndex = bLOD ? JobIndex - JobCount : JobIndex;
+			const FBuildingChunkJob& Job = bLOD ? Build.LODJobs[ListIndex] : Build.Jobs[ListIndex];
+			if ((Job.SourceJob != INDEX_NONE) != bRepeats) {
+				return;
 			}
 
-			const float offset = HeightOffset - TopSink;
-			for (int i = 0; i < generalVertices.Num(); ++i) {
-				normals.Add(FVector::UpVector);
-				vertices.Add(GetTransform().InverseTransformPosition(generalVertices[i]));
-				vertices[i].Z += offset;
+			TArray<FBuildingChunk>& Results = bLOD ? Build.LODResults : Build.Results;
+			if (bRepeats) {
+				const TArray<FBuildingChunkJob>& Jobs = bLOD ? Build.LODJobs : Build.Jobs;
+				const float ZOffset = Job.HeightOffset - Jobs[Job.SourceJob].HeightOffset;
+				Build.Allocations.Add(RepeatChunk(Results[ListIndex], Results[Job.SourceJob], ZOffset));
+				Build.OptimizeStats[JobIndex] = Build.OptimizeStats[(bLOD ? JobCount : 0) + Job.SourceJob];
+			} else {
+				Build.Allocations.Add(CreateChunk(Results[ListIndex], bLOD ? Build.LODParts : Build.Parts, Job, Build.SlotCount, Build.OptimizeStats[JobIndex]));
 			}
+		});
+	}
+	Build.GenerateSeconds = FPlatformTime::Seconds() - Start;
+	return LatestSerial.GetValue() == Build.Serial;
+}
 
-			MeshComponent->CreateMeshSection(Meshes.Num() + 1, vertices, triangles, normals, UVs, TArray<FVector2D>(), TArray<FVector2D>(), TArray<FVector2D>(), TArray<FColor>(), TArray<FProcMeshTangent>(), true);
-			MeshComponent->SetMaterial(Meshes.Num() + 1, TopMaterial);
-		}
+int ABuilding::RepeatChunk(FBuildingChunk& Chunk, const FBuildingChunk& Source, float ZOffset)
+{
+	FANTASY_SCOPE(STAT_BuildingRepeat);
+
+	int Allocations = 0;
+	Chunk.Meshes.SetNum(Source.Meshes.Num(), false);
+	for (int slot = 0; slot < Source.Meshes.Num(); ++slot) {
+		Allocations += Chunk.Meshes[slot].CopyRaised(Source.Meshes[slot], ZOffset);
 	}
+	return Allocations;
+}
 
-	int i = 0;
-	for (auto Itr = Meshes.CreateConstIterator(); Itr; ++Itr) {
-		const auto& Mesh = Itr.Value();
-		MeshComponent->CreateMeshSection(i, Mesh.vertices, Mesh.tris, Mesh.normals, Mesh.uvs, TArray<FVector2D>(), TArray<FVector2D>(), TArray<FVector2D>(), TArray<FColor>(), Mesh.tangents, true);
-		const auto& DebugMaterial = Itr.Key();
-		const auto& FinalMaterial = Materials.Find(DebugMaterial);
-		if (FinalMaterial == nullptr || *FinalMaterial == nullptr) {
-			MeshComponent->SetMaterial(i, DebugMaterial);
+int ABuilding::LinkRepeatedJobs(TArray<FBuildingChunkJob>& Jobs)
+{
+	// Layouts are shared per segment and pattern, so a chunk is fully described by its layout and floor height
+	TMap<TPair<const FBuildingLayout*, float>, int> FirstJobs;
+	int Repeats = 0;
+	for (int JobIndex = 0; JobIndex < Jobs.Num(); ++JobIndex) {
+		FBuildingChunkJob& Job = Jobs[JobIndex];
+		const TPair<const FBuildingLayout*, float> Key(Job.Layout.Get(), Job.FloorHeight);
+		if (const int* First = FirstJobs.Find(Key)) {
+			Job.SourceJob = *First;
+			++Repeats;
 		} else {
-			MeshComponent->SetMaterial(i, *FinalMaterial);
+			Job.SourceJob = INDEX_NONE;
+			FirstJobs.Add(Key, JobIndex);
 		}
-		++i;
 	}
+	return Repeats;
 }
 
-// Called every frame
-void ABuilding::Tick(float DeltaTime)
+int ABuilding::CreateChunk(FBuildingChunk& Chunk, const FBuildingParts& Parts, const FBuildingChunkJob& Job, int SlotCount, BuildingOptimize::FStats& Stats)
 {
-	Super::Tick(DeltaTime);
+	FANTASY_SCOPE(STAT_BuildingEmit);
+
+	// Counting pass: exact vertex and index totals per material slot
+	TArray<int32, TInlineAllocator<16>> VertexCounts;
+	TArray<int32, TInlineAllocator<16>> IndexCounts;
+	VertexCounts.SetNumUninitialized(SlotCount);
+	IndexCounts.SetNumUninitialized(SlotCount);
+	BuildingCore::CountChunk(*Job.Layout, Parts.Views, SlotCount, VertexCounts.GetData(), IndexCounts.GetData());
 
+	int Allocations = 0;
+	Chunk.Meshes.SetNum(SlotCount, false);
+	TArray<BuildingCore::FSlotBuffers, TInlineAllocator<16>> Slots;
+	Slots.SetNum(SlotCount);
+	for (int slot = 0; slot < SlotCount; ++slot) {
+		TMesh& Mesh = Chunk.Meshes[slot];
+		Allocations += Mesh.Presize(VertexCounts[slot], IndexCounts[slot]);
+		Slots[slot].Positions = BuildingCore::ToCore(Mesh.vertices.GetData());
+		Slots[slot].Normals = BuildingCore::ToCore(Mesh.normals.GetData());
+		Slots[slot].Tangents = BuildingCore::ToCore(Mesh.tangents.GetData());
+		Slots[slot].UVs = BuildingCore::ToCore(Mesh.uvs.GetData());
+		Slots[slot].Indices = Mesh.tris.GetData();
+	}
+
+	// Fill pass: every slot is written in place, nothing grows
+	BuildingCore::FFloorSpec Floor;
+	Floor.HeightOffset = Job.HeightOffset;
+	Floor.Height = Job.FloorHeight;
+	BuildingCore::EmitChunk(*Job.Layout, Parts.Views, Floor, Slots.GetData(), SlotCount);
+
+	if (Job.bOptimize) {
+		for (TMesh& Mesh : Chunk.Meshes) {
+			if (Mesh.tris.Num() > 0) {
+				BuildingOptimize::Optimize(Mesh, Job.WeldTolerance, Stats);
+			}
+		}
+	}
+
+	return Allocations;
+}
+
+void ABuilding::ApplyBuild(FBuildingBuild& Build)
+{
+	if (Build.bLODOnly) {
+		ApplyLODs(Build);
+		return;
+	}
+
+	TBitArray<> DirtyMaterials = PendingMaterials;
+	PendingMaterials.Init(false, MaterialSlots.Num());
+	if (bSectionsStale) {
+		MeshComponent->ClearAllMeshSections();
+		FillKey = 0;
+		bSectionsStale = false;
+	}
+
+	for (int JobIndex = 0; JobIndex < Build.Jobs.Num(); ++JobIndex) {
+		FBuildingChunk& Chunk = Chunks[Build.Jobs[JobIndex].Chunk];
+		Chunk = MoveTemp(Build.Results[JobIndex]);
+		Chunk.Key = Build.Jobs[JobIndex].Key;
+		Chunk.Placements = Build.Jobs[JobIndex].Layout->Placements.size();
+		Chunk.bValid = true;
+
+		for (int material = 0; material < Chunk.Meshes.Num(); ++material) {
+			if (Chunk.Meshes[material].vertices.Num() > 0) {
+				DirtyMaterials[material] = true;
+			}
+		}
+	}
+
+	SegmentsRebuilt = Build.Jobs.Num();
+	SegmentsReused = Build.SegmentsReused;
+	SegmentsRepeated = Build.SegmentsRepeated;
+	BufferAllocations = Build.Allocations.GetValue();
+	Timings.Generate = Build.GenerateSeconds;
+
+	if (bOptimizeMeshes && Build.Jobs.Num() > 0) {
+		BuildingOptimize::FStats Optimized;
+		for (int JobIndex = 0; JobIndex < Build.Jobs.Num(); ++JobIndex) {
+			Optimized += Build.OptimizeStats[JobIndex];
+		}
+		OptimizeVerticesBefore = Optimized.VerticesBefore;
+		OptimizeVerticesAfter = Optimized.VerticesAfter;
+		OptimizeACMRBefore = Optimized.TrianglesBefore > 0 ? static_cast<float>(Optimized.CacheMissesBefore) / Optimized.TrianglesBefore : 0.0f;
+		OptimizeACMRAfter = Optimized.TrianglesAfter > 0 ? static_cast<float>(Optimized.CacheMissesAfter) / Optimized.TrianglesAfter : 0.0f;
+		UE_LOG(LogTemp, Verbose, TEXT("%s: optimized %d to %d vertices, ACMR %.3f to %.3f"), *GetName(),
+			OptimizeVerticesBefore, OptimizeVerticesAfter, OptimizeACMRBefore, OptimizeACMRAfter);
+	}
+
+	const uint32 NewFillKey = GetFillKey(Build.TotalHeight);
+	if (NewFillKey != FillKey) {
+		FillKey = NewFillKey;
+		CreateFill(Build.TotalHeight);
+	}
+	UpdateCollision(Build.Parts, Build.TotalHeight, true);
+
+	const double UploadStart = FPlatformTime::Seconds();
+
+	// Batched slots all upload into the section of the first one
+	TArray<int32> BatchLayers;
+	const int BatchSection = GetBatchLayers(BatchLayers);
+	bool bBatchDirty = false;
+	for (int i = 0; i < MaterialSlots.Num(); ++i) {
+		bBatchDirty |= BatchLayers[i] != INDEX_NONE && DirtyMaterials[i];
+	}
+
+	TArray<int, TInlineAllocator<16>> SectionSlots;
+	for (int i = 0; i < MaterialSlots.Num(); ++i) {
+		SectionSlots.Reset();
+		if (i == BatchSection && bBatchDirty) {
+			for (int slot = 0; slot < MaterialSlots.Num(); ++slot) {
+				if (BatchLayers[slot] != INDEX_NONE) {
+					SectionSlots.Add(slot);
+				}
+			}
+		} else if (DirtyMaterials[i] && BatchLayers[i] == INDEX_NONE) {
+			SectionSlots.Add(i);
+		} else {
+			continue;
+		}
+
+		TMesh& Mesh = UploadMesh;
+		bool bCollision = false;
+		{
+			FANTASY_SCOPE(STAT_BuildingAssemble);
+
+			int SlotVertices = 0;
+			int SlotIndices = 0;
+			for (const auto& Chunk : Chunks) {
+				for (int slot : SectionSlots) {
+					if (Chunk.Meshes.IsValidIndex(slot)) {
+						SlotVertices += Chunk.Meshes[slot].vertices.Num();
+						SlotIndices += Chunk.Meshes[slot].tris.Num();
+					}
+				}
+			}
+
+			// Size the scratch mesh once, then append into its capacity
+			BufferAllocations += Mesh.Presize(SlotVertices, SlotIndices);
+			Mesh.Presize(0, 0);
+			if (i == BatchSection) {
+				UploadLayers.SetNumUninitialized(SlotVertices, false);
+			}
+			for (const auto& Chunk : Chunks) {
+				for (int slot : SectionSlots) {
+					if (Chunk.Meshes.IsValidIndex(slot)) {
+						const int First = Mesh.vertices.Num();
+						Mesh.Append(Chunk.Meshes[slot]);
+						// Texture array layer of each vertex, read from UV1.x by BatchedMaterial
+						for (int v = First; v < Mesh.vertices.Num() && i == BatchSection; ++v) {
+							UploadLayers[v] = FVector2D(static_cast<float>(BatchLayers[slot]), 0.0f);
+						}
+					}
+				}
+			}
+			for (int slot : SectionSlots) {
+				bCollision |= HasSectionCollision(slot);
+			}
+		}
+
+		FANTASY_SCOPE(STAT_BuildingUpload);
+		if (Mesh.vertices.Num() == 0) {
+			MeshComponent->ClearMeshSection(i);
+		} else {
+			MeshComponent->CreateMeshSection(i, Mesh.vertices, Mesh.tris, Mesh.normals, Mesh.uvs, i == BatchSection ? UploadLayers : NoUVs, NoUVs, NoUVs, NoColors, Mesh.tangents, bCollision);
+		}
+	}
+
+	// Batched slots other than the batch section stay empty
+	for (int i = 0; i < MaterialSlots.Num(); ++i) {
+		if (BatchLayers[i] != INDEX_NONE && i != BatchSection && DirtyMaterials[i]) {
+			MeshComponent->ClearMeshSection(i);
+		}
+	}
+	ApplyMaterials();
+	Timings.Upload = FPlatformTime::Seconds() - UploadStart;
+
+	if (bUseGeometryCache && Build.bFullBuild) {
+		FBuildingGeometryCache::Save(Build.CacheKey, *MeshComponent, MaterialSlots.Num() + 2);
+	}
+
+	int64 Vertices = 0;
+	int64 Indices = 0;
+	int64 Instances = 0;
+	for (const auto& Chunk : Chunks) {
+		for (const auto& Mesh : Chunk.Meshes) {
+			Vertices += Mesh.vertices.Num();
+			Indices += Mesh.tris.Num();
+		}
+		Instances += Chunk.Placements;
+	}
+	MergedMemoryBytes = BuildingMemory::GetMergedBytes(Vertices, Indices);
+	InstancedMemoryBytes = BuildingMemory::GetInstancedBytes(Instances);
+
+	int64 UploadedVertices = 0;
+	int64 UploadedTriangles = 0;
+	int32 UploadedSections = 0;
+	CountSections(*MeshComponent, UploadedVertices, UploadedTriangles, UploadedSections);
+	SetCounters(UploadedVertices, UploadedTriangles, UploadedSections, BuildingMemory::GetMergedBytes(UploadedVertices, UploadedTriangles * 3));
+
+	UE_LOG(LogTemp, Verbose, TEXT("%s: rebuilt %d segments (%d repeated), reused %d, %d buffer allocations"), *GetName(), SegmentsRebuilt, SegmentsRepeated, SegmentsReused, BufferAllocations);
+
+	if (bGenerateLODs) {
+		ApplyLODs(Build);
+	}
+}
+
+void ABuilding::ApplyLODs(FBuildingBuild& Build)
+{
+	FANTASY_SCOPE(STAT_BuildingLODUpload);
+
+	if (MidLODComponent == nullptr) {
+		MidLODComponent = CreateLODComponent(TEXT("MidLOD"));
+	}
+	if (FarLODComponent == nullptr) {
+		FarLODComponent = CreateLODComponent(TEXT("FarLOD"));
+	}
+
+	for (int JobIndex = 0; JobIndex < Build.LODJobs.Num(); ++JobIndex) {
+		FBuildingChunk& Chunk = LODChunks[Build.LODJobs[JobIndex].Chunk];
+		Chunk = MoveTemp(Build.LODResults[JobIndex]);
+		Chunk.Key = Build.LODJobs[JobIndex].Key;
+		Chunk.Placements = Build.LODJobs[JobIndex].Layout->Placements.size();
+		Chunk.bValid = true;
+	}
+
+	// Only re-upload when a chunk or the fill it copies has changed
+	uint32 Key = HashCombine(FillKey, GetTypeHash(MaterialSlots.Num()));
+	for (const auto& Chunk : LODChunks) {
+		Key = HashCombine(Key, Chunk.bValid ? Chunk.Key : 0);
+	}
+	if (Key != MidLODKey) {
+		MidLODKey = Key;
+		MidLODComponent->ClearAllMeshSections();
+		MidLODTriangleCount = 0;
+
+		for (int slot = 0; slot < MaterialSlots.Num(); ++slot) {
+			TMesh& Mesh = UploadMesh;
+			int SlotVertices = 0;
+			int SlotIndices = 0;
+			for (const auto& Chunk : LODChunks) {
+				if (Chunk.Meshes.IsValidIndex(slot)) {
+					SlotVertices += Chunk.Meshes[slot].vertices.Num();
+					SlotIndices += Chunk.Meshes[slot].tris.Num();
+				}
+			}
+			if (SlotVertices == 0) {
+				continue;
+			}
+
+			Mesh.Presize(SlotVertices, SlotIndices);
+			Mesh.Presize(0, 0);
+			for (const auto& Chunk : LODChunks) {
+				if (Chunk.Meshes.IsValidIndex(slot)) {
+					Mesh.Append(Chunk.Meshes[slot]);
+				}
+			}
+			MidLODComponent->CreateMeshSection(slot, Mesh.vertices, Mesh.tris, Mesh.normals, Mesh.uvs, NoUVs, NoUVs, NoUVs, NoColors, Mesh.tangents, false);
+			MidLODTriangleCount += SlotIndices / 3;
+		}
+
+		// The fill is cheap already, the mid LOD draws the same one
+		for (int Section = MaterialSlots.Num(); Section < MaterialSlots.Num() + 2; ++Section) {
+			const FProcMeshSection* Fill = MeshComponent->GetProcMeshSection(Section);
+			if (Fill != nullptr && Fill->ProcVertexBuffer.Num() > 0) {
+				FProcMeshSection Copy = *Fill;
+				Copy.bEnableCollision = false;
+				MidLODComponent->SetProcMeshSection(Section, Copy);
+				MidLODTriangleCount += Fill->ProcIndexBuffer.Num() / 3;
+			}
+		}
+	}
+	for (int Section = 0; Section < MaterialSlots.Num() + 2; ++Section) {
+		MidLODComponent->SetMaterial(Section, Section < MaterialSlots.Num() ? GetFinalMaterial(Section) : MeshComponent->GetMaterial(Section));
+	}
+
+	CreateFarLOD(Build.TotalHeight);
+	UpdateLODDistances();
+}
+
+void ABuilding::CreateFarLOD(float TotalHeight)
+{
+	uint32 Key = HashCombine(ArcLengthKey, FillKey);
+	Key = HashCombine(Key, GetTypeHash(TotalHeight));
+	Key = HashCombine(Key, GetTypeHash(FacadeTileLength));
+	for (const auto& floor : Floors) {
+		Key = HashCombine(Key, GetTypeHash(floor.Height));
+	}
+	if (Key != FarLODKey) {
+		FarLODKey = Key;
+		FarLODComponent->ClearAllMeshSections();
+		FarLODTriangleCount = 0;
+
+		TMesh& Mesh = UploadMesh;
+		Mesh.Presize(0, 0);
+		for (int BuildingSection = 0; BuildingSection < GetBuildingSectionCount(); ++BuildingSection) {
+			FVector Start, Along, Across;
+			FBox Extent;
+			if (!GetSegmentBounds(BuildingSection, Start, Along, Across, Extent)) {
+				continue;
+			}
+
+			float HeightOffset = Extent.Min.Z;
+			for (const auto& floor : Floors) {
+				AddBoxSides(Mesh, Start + FVector::UpVector * HeightOffset, Along, Across, Extent.Min.X, Extent.Max.X, Extent.Min.Y, Extent.Max.Y, floor.Height, FacadeTileLength);
+				HeightOffset += floor.Height;
+			}
+		}
+		if (Mesh.vertices.Num() > 0) {
+			FarLODComponent->CreateMeshSection(0, Mesh.vertices, Mesh.tris, Mesh.normals, Mesh.uvs, NoUVs, NoUVs, NoUVs, NoColors, Mesh.tangents, false);
+			FarLODTriangleCount += Mesh.tris.Num() / 3;
+		}
+
+		// A flat roof over the lowest point of the footprint, triangulated like the fill
+		if (SplineComponent->IsClosedLoop() && ArcLengths.Locations.Num() > 0) {
+			TArray<FVector2D> Polygon;
+			Polygon.Reserve(ArcLengths.Locations.Num());
+			float MinZ = ArcLengths.Locations[0].Z;
+			for (const FVector& Location : ArcLengths.Locations) {
+				Polygon.Add(FVector2D(Location.X, Location.Y));
+				MinZ = FMath::Min(MinZ, Location.Z);
+			}
+			BuildingFill::SimplifyPolygon(Polygon, FillSimplifyTolerance);
+
+			TArray<int32> Triangles;
+			if (BuildingFill::TriangulatePolygon(Polygon, Triangles)) {
+				Mesh.Presize(0, 0);
+				for (const FVector2D& Point : Polygon) {
+					Mesh.vertices.Add(FVector(Point.X, Point.Y, MinZ + TotalHeight));
+					Mesh.normals.Add(FVector::UpVector);
+					Mesh.tangents.Add(FProcMeshTangent(FVector::ForwardVector, false));
+					Mesh.uvs.Add(Point / FacadeTileLength);
+				}
+				FarLODComponent->CreateMeshSection(1, Mesh.vertices, Triangles, Mesh.normals, Mesh.uvs, NoUVs, NoUVs, NoUVs, NoColors, Mesh.tangents, false);
+				FarLODTriangleCount += Triangles.Num() / 3;
+			}
+		}
+	}
+
+	FarLODComponent->SetMaterial(0, FarFacadeMaterial);
+	FarLODComponent->SetMaterial(1, FillTop && TopMaterial != nullptr ? TopMaterial : FarFacadeMaterial);
+}
+
+void ABuilding::UpdateLODDistances()
+{
+	// Screen size is the bounds diameter over the screen height; with a 90 degree field of view that is radius over distance
+	const float Radius = FMath::Max(MeshComponent->Bounds.SphereRadius, 1.0f);
+	const float MidDistance = Radius / MidLODScreenSize;
+	const float FarDistance = FMath::Max(MidDistance, Radius / FarLODScreenSize);
+
+	MeshComponent->SetCullDistance(MidDistance);
+	MidLODComponent->MinDrawDistance = MidDistance;
+	MidLODComponent->SetCullDistance(FarDistance);
+	MidLODComponent->MarkRenderStateDirty();
+	FarLODComponent->MinDrawDistance = FarDistance;
+	FarLODComponent->MarkRenderStateDirty();
+}
+
+UProceduralMeshComponent* ABuilding::CreateLODComponent(FName Name)
+{
+	UProceduralMeshComponent* Component = NewObject<UProceduralMeshComponent>(this, MakeUniqueObjectName(this, UProceduralMeshComponent::StaticClass(), Name));
+	Component->CreationMethod = EComponentCreationMethod::Instance;
+	Component->SetupAttachment(MeshComponent);
+	// LOD0 keeps colliding at every distance
+	Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Component->RegisterComponent();
+	AddInstanceComponent(Component);
+	return Component;
+}
+
+void ABuilding::DestroyLODComponents()
+{
+	LODChunks.Reset();
+	MidLODKey = 0;
+	FarLODKey = 0;
+	if (MidLODComponent == nullptr && FarLODComponent == nullptr) {
+		return;
+	}
+
+	for (UProceduralMeshComponent* Component : { MidLODComponent, FarLODComponent }) {
+		if (Component != nullptr) {
+			Component->DestroyComponent();
+		}
+	}
+	MidLODComponent = nullptr;
+	FarLODComponent = nullptr;
+	MidLODTriangleCount = 0;
+	FarLODTriangleCount = 0;
+	MeshComponent->SetCullDistance(MeshComponent->LDMaxDrawDistance);
+}
+
+void ABuilding::ApplyMaterials()
+{
+	TArray<int32> BatchLayers;
+	const int BatchSection = GetBatchLayers(BatchLayers);
+	for (int i = 0; i < MaterialSlots.Num(); ++i) {
+		MeshComponent->SetMaterial(i, i == BatchSection ? BatchedMaterial : GetFinalMaterial(i));
+	}
+
+	const int FillSection = MaterialSlots.Num();
+	if (FillBottom) {
+		MeshComponent->SetMaterial(FillSection, BottomMaterial);
+	}
+	if (FillTop) {
+		MeshComponent->SetMaterial(FillSection + 1, TopMaterial);
+	}
+}
+
+UMaterialInterface* ABuilding::GetFinalMaterial(int Slot) const
+{
+	UMaterialInterface* const* FinalMaterial = Materials.Find(MaterialSlots[Slot]);
+	return FinalMaterial == nullptr || *FinalMaterial == nullptr ? MaterialSlots[Slot] : *FinalMaterial;
+}
+
+int ABuilding::GetBatchLayers(TArray<int32>& OutLayers) const
+{
+	OutLayers.Init(INDEX_NONE, MaterialSlots.Num());
+	if (!bBatchMaterials || BatchedMaterial == nullptr) {
+		return INDEX_NONE;
+	}
+
+	int BatchSection = INDEX_NONE;
+	for (int i = 0; i < MaterialSlots.Num(); ++i) {
+		OutLayers[i] = BatchLayerMaterials.IndexOfByKey(GetFinalMaterial(i));
+		if (OutLayers[i] != INDEX_NONE && BatchSection == INDEX_NONE) {
+			BatchSection = i;
+		}
+	}
+	return BatchSection;
+}
+
+FSHAHash ABuilding::GetGeometryCacheKey(const TArray<uint32>& ChunkKeys, uint32 InFillKey) const
+{
+	FSHA1 Hash;
+	Hash.Update(reinterpret_cast<const uint8*>(&FBuildingGeometryCache::FormatVersion), sizeof(FBuildingGeometryCache::FormatVersion));
+	Hash.Update(reinterpret_cast<const uint8*>(ChunkKeys.GetData()), ChunkKeys.Num() * sizeof(uint32));
+	Hash.Update(reinterpret_cast<const uint8*>(&InFillKey), sizeof(InFillKey));
+	for (const UMaterialInterface* Material : MaterialSlots) {
+		const FString Path = GetPathNameSafe(Material);
+		Hash.UpdateWithString(*Path, Path.Len());
+	}
+	return Hash.Finalize();
+}
+
+void ABuilding::CreateInstances(const FBuildingParts& Parts, const TArray<uint32>& SegmentKeys)
+{
+	const int TotalBuildingSections = SegmentKeys.Num();
+
+	TArray<TArray<FTransform>> Transforms;
+	Transforms.SetNum(MeshTypes.Num());
+	int64 Vertices = 0;
+	int64 Indices = 0;
+
+	double PhaseStart = FPlatformTime::Seconds();
+	TMap<uint32, FBuildingLayoutPtr> Layouts;
+	float HeightOffset = 0;
+	for (int f = 0; f < Floors.Num(); ++f) {
+		const auto& floor = Floors[f];
+		for (int BuildingSection = 0; BuildingSection < TotalBuildingSections; ++BuildingSection) {
+			const FBuildingLayoutPtr Layout = FindLayout(Layouts, Parts, floor.Sections[BuildingSection], BuildingSection);
+			for (const BuildingCore::FPlacement& Placement : Layout->Placements) {
+				Transforms[Placement.MeshType].Add(FTransform(
+					BuildingCore::GetRotation(Placement),
+					BuildingCore::ToVector(Placement.Start) + FVector::UpVector * HeightOffset,
+					FVector(Layout->PatternScale, 1.0f, floor.Height / Parts.Heights[Placement.MeshType])));
+
+				for (const auto& PartSection : Parts.Parts[Placement.MeshType]->Sections) {
+					Vertices += PartSection.Positions.Num();
+					Indices += PartSection.Indices.Num();
+				}
+			}
+		}
+		HeightOffset += floor.Height;
+	}
+
+	Timings.Layout = FPlatformTime::Seconds() - PhaseStart;
+
+	PhaseStart = FPlatformTime::Seconds();
+	UpdateInstanceComponents();
+	int64 Instances = 0;
+	for (int meshType = 0; meshType < InstanceComponents.Num(); ++meshType) {
+		InstanceComponents[meshType]->ClearInstances();
+		InstanceComponents[meshType]->AddInstances(Transforms[meshType], false);
+		Instances += Transforms[meshType].Num();
+	}
+	Timings.Upload = FPlatformTime::Seconds() - PhaseStart;
+
+	MergedMemoryBytes = BuildingMemory::GetMergedBytes(Vertices, Indices);
+	InstancedMemoryBytes = BuildingMemory::GetInstancedBytes(Instances);
+
+	const uint32 NewFillKey = GetFillKey(HeightOffset);
+	if (NewFillKey != FillKey) {
+		FillKey = NewFillKey;
+		CreateFill(HeightOffset);
+	}
+	// The instances collide through their own meshes
+	UpdateCollision(Parts, HeightOffset, false);
+
+	// Instances render the part meshes, so count those plus the fill sections
+	int64 FillVertices = 0;
+	int64 FillTriangles = 0;
+	int32 FillSections = 0;
+	CountSections(*MeshComponent, FillVertices, FillTriangles, FillSections);
+	int32 InstanceDrawCalls = 0;
+	for (const UHierarchicalInstancedStaticMeshComponent* Component : InstanceComponents) {
+		InstanceDrawCalls += Component->GetInstanceCount() > 0 ? Component->GetNumMaterials() : 0;
+	}
+	SetCounters(Vertices + FillVertices, Indices / 3 + FillTriangles, InstanceDrawCalls + FillSections,
+		InstancedMemoryBytes + BuildingMemory::GetMergedBytes(FillVertices, FillTriangles * 3));
+}
+
+void ABuilding::SetCounters(int64 Vertices, int64 Triangles, int32 InDrawCalls, int64 Bytes)
+{
+	if (!bCounted) {
+		INC_DWORD_STAT(STAT_BuildingCount);
+		bCounted = true;
+	}
+
+	DEC_DWORD_STAT_BY(STAT_BuildingVertices, VertexCount);
+	DEC_DWORD_STAT_BY(STAT_BuildingTriangles, TriangleCount);
+	DEC_DWORD_STAT_BY(STAT_BuildingDrawCalls, DrawCalls);
+	DEC_MEMORY_STAT_BY(STAT_BuildingMemory, CountedBytes);
+
+	VertexCount = static_cast<int32>(Vertices);
+	TriangleCount = static_cast<int32>(Triangles);
+	DrawCalls = InDrawCalls;
+	CountedBytes = Bytes;
+
+	INC_DWORD_STAT_BY(STAT_BuildingVertices, VertexCount);
+	INC_DWORD_STAT_BY(STAT_BuildingTriangles, TriangleCount);
+	INC_DWORD_STAT_BY(STAT_BuildingDrawCalls, DrawCalls);
+	INC_MEMORY_STAT_BY(STAT_BuildingMemory, CountedBytes);
+}
+
+void ABuilding::UpdateInstanceComponents()
+{
+	while (InstanceComponents.Num() > MeshTypes.Num()) {
+		if (InstanceComponents.Last() != nullptr) {
+			InstanceComponents.Last()->DestroyComponent();
+		}
+		InstanceComponents.Pop();
+	}
+
+	for (int meshType = 0; meshType < MeshTypes.Num(); ++meshType) {
+		if (!InstanceComponents.IsValidIndex(meshType)) {
+			InstanceComponents.Add(nullptr);
+		}
+
+		UHierarchicalInstancedStaticMeshComponent*& Component = InstanceComponents[meshType];
+		if (Component == nullptr) {
+			Component = NewObject<UHierarchicalInstancedStaticMeshComponent>(this);
+			Component->CreationMethod = EComponentCreationMethod::Instance;
+			Component->SetupAttachment(MeshComponent);
+			Component->RegisterComponent();
+			AddInstanceComponent(Component);
+		}
+
+		UStaticMesh* StaticMesh = MeshTypes[meshType].StaticMesh;
+		Component->SetStaticMesh(StaticMesh);
+		Component->SetCollisionEnabled(CollisionMode == EBuildingCollisionMode::None ? ECollisionEnabled::NoCollision : ECollisionEnabled::QueryAndPhysics);
+		if (StaticMesh == nullptr) {
+			continue;
+		}
+
+		const auto& DebugMaterials = StaticMesh->GetStaticMaterials();
+		for (int material = 0; material < DebugMaterials.Num(); ++material) {
+			const auto& FinalMaterial = Materials.Find(DebugMaterials[material].MaterialInterface);
+			Component->SetMaterial(material, FinalMaterial == nullptr ? nullptr : *FinalMaterial);
+		}
+	}
+}
+
+void ABuilding::DestroyInstanceComponents()
+{
+	for (UHierarchicalInstancedStaticMeshComponent* Component : InstanceComponents) {
+		if (Component != nullptr) {
+			Component->DestroyComponent();
+		}
+	}
+	InstanceComponents.Reset();
+}
+
+void ABuilding::CreateFill(float HeightOffset)
+{
+	const double Start = FPlatformTime::Seconds();
+	const int FillSection = MaterialSlots.Num();
+	MeshComponent->ClearMeshSection(FillSection);
+	MeshComponent->ClearMeshSection(FillSection + 1);
+
+	if (FillTop || FillBottom) {
+		// World space, shared by both fills
+		TArray<FVector> generalVertices;
+		TArray<int32> bottomTriangles;
+		TArray<int32> topTriangles;
+		if (FillMode == EBuildingFillMode::Grid) {
+			CreateGridFill(generalVertices, bottomTriangles, topTriangles);
+		} else {
+			CreateTriangulatedFill(generalVertices, bottomTriangles, topTriangles);
+		}
+
+		const auto& ComponentOrigin = SplineComponent->Bounds.Origin;
+		float Scale;
+		constexpr float Padding = 0.0f;
+		if (ComponentOrigin.X > ComponentOrigin.Y) {
+			Scale = (1 - Padding) / (ComponentOrigin.X * 2);
+		} else {
+			Scale = (1 - Padding) / (ComponentOrigin.Y * 2);
+		}
+		const FVector OriginScaled = Scale * ComponentOrigin;
+		TArray<FVector2D> UVs;
+		UVs.Reserve(generalVertices.Num());
+		for (int i = 0; i < generalVertices.Num(); ++i) {
+			UVs.Add(FVector2D(
+				generalVertices[i].X * Scale + 0.5f + (OriginScaled.X * -1),
+				generalVertices[i].Y * Scale + 0.5f + (OriginScaled.Y * -1)));
+		}
+
+		if (FillBottom) {
+			TArray<FVector> vertices;
+			TArray<FVector> normals;
+			vertices.Reserve(generalVertices.Num());
+			normals.Reserve(generalVertices.Num());
+
+			for (int i = 0; i < generalVertices.Num(); ++i) {
+				normals.Add(FVector::DownVector);
+				vertices.Add(GetTransform().InverseTransformPosition(generalVertices[i]));
+			}
+
+			FANTASY_SCOPE(STAT_BuildingUpload);
+			MeshComponent->CreateMeshSection(FillSection, vertices, bottomTriangles, normals, UVs, NoUVs, NoUVs, NoUVs, NoColors, NoTangents, HasSectionCollision(FillSection));
+			MeshComponent->SetMaterial(FillSection, BottomMaterial);
+		}
+
+		if (FillTop) {
+			TArray<FVector> vertices;
+			TArray<FVector> normals;
+			vertices.Reserve(generalVertices.Num());
+			normals.Reserve(generalVertices.Num());
+
+			const float offset = HeightOffset - TopSink;
+			for (int i = 0; i < generalVertices.Num(); ++i) {
+				normals.Add(FVector::UpVector);
+				vertices.Add(GetTransform().InverseTransformPosition(generalVertices[i]));
+				vertices[i].Z += offset;
+			}
+
+			FANTASY_SCOPE(STAT_BuildingUpload);
+			MeshComponent->CreateMeshSection(FillSection + 1, vertices, topTriangles, normals, UVs, NoUVs, NoUVs, NoUVs, NoColors, NoTangents, HasSectionCollision(FillSection + 1));
+			MeshComponent->SetMaterial(FillSection + 1, TopMaterial);
+		}
+	}
+	Timings.Fill = FPlatformTime::Seconds() - Start;
+}
+
+bool ABuilding::HasSectionCollision(int Section) const
+{
+	switch (CollisionMode) {
+	case EBuildingCollisionMode::Complex:
+		return true;
+	case EBuildingCollisionMode::Simplified:
+		if (MaterialSlots.IsValidIndex(Section)) {
+			UMaterialInterface* const* FinalMaterial = Materials.Find(MaterialSlots[Section]);
+			return ComplexCollisionMaterials.Contains(MaterialSlots[Section])
+				|| (FinalMaterial != nullptr && *FinalMaterial != nullptr && ComplexCollisionMaterials.Contains(*FinalMaterial));
+		}
+		return false;
+	default:
+		return false;
+	}
+}
+
+bool ABuilding::GetSegmentBounds(int BuildingSection, FVector& OutStart, FVector& OutAlong, FVector& OutAcross, FBox& OutExtent) const
+{
+	// The chord, and however far the spline bows away from it
+	const int Samples = ArcLengths.SamplesPerSegment;
+	OutStart = ArcLengths.Locations[BuildingSection * Samples];
+	const FVector& End = ArcLengths.Locations[(BuildingSection + 1) * Samples];
+	OutAlong = (End - OutStart).GetSafeNormal2D();
+	if (OutAlong.IsZero()) {
+		return false;
+	}
+	OutAcross = FVector::CrossProduct(FVector::UpVector, OutAlong);
+
+	OutExtent = FBox(FVector::ZeroVector, FVector::ZeroVector);
+	for (int i = BuildingSection * Samples; i <= (BuildingSection + 1) * Samples; ++i) {
+		const FVector Offset = ArcLengths.Locations[i] - OutStart;
+		OutExtent += FVector(FVector::DotProduct(Offset, OutAlong), FVector::DotProduct(Offset, OutAcross), Offset.Z);
+	}
+	return true;
+}
+
+void ABuilding::UpdateCollision(const FBuildingParts& Parts, float TotalHeight, bool bWalls)
+{
+	uint32 Key = HashCombine(GetTypeHash(CollisionMode), GetTypeHash(CollisionThickness));
+	Key = HashCombine(Key, HashCombine(ArcLengthKey, FillKey));
+	Key = HashCombine(Key, GetTypeHash(bWalls));
+	for (const FMeshData& MeshType : MeshTypes) {
+		Key = HashCombine(Key, GetTypeHash(MeshType.Length));
+		Key = HashCombine(Key, GetTypeHash(MeshType.Opening));
+	}
+	for (const auto& floor : Floors) {
+		Key = HashCombine(Key, GetTypeHash(floor.Height));
+		for (const FBuildingSection& Section : floor.Sections) {
+			Key = HashCombine(Key, GetPatternKey(Section));
+		}
+	}
+	if (Key == CollisionKey) {
+		return;
+	}
+	CollisionKey = Key;
+
+	MeshComponent->bUseComplexAsSimpleCollision = CollisionMode == EBuildingCollisionMode::Complex;
+	if (CollisionMode != EBuildingCollisionMode::Simplified) {
+		MeshComponent->ClearCollisionConvexMeshes();
+		return;
+	}
+
+	TArray<TArray<FVector>> Convexes;
+	const auto AddBox = [&Convexes](const FVector& Origin, const FVector& X, const FVector& Y, float MinX, float MaxX, float MinY, float MaxY, float MinZ, float MaxZ) {
+		TArray<FVector>& Box = Convexes.AddDefaulted_GetRef();
+		Box.Reserve(8);
+		for (int Corner = 0; Corner < 8; ++Corner) {
+			Box.Add(Origin
+				+ X * ((Corner & 1) ? MaxX : MinX)
+				+ Y * ((Corner & 2) ? MaxY : MinY)
+				+ FVector::UpVector * ((Corner & 4) ? MaxZ : MinZ));
+		}
+	};
+
+	if (bWalls) {
+		// Boxes per segment per floor, around the segment's chord and however far the spline bows away from it,
+		// split wherever a door is placed
+		TMap<uint32, FBuildingLayoutPtr> Layouts;
+		TArray<FVector2D> Doors;
+		for (int BuildingSection = 0; BuildingSection < GetBuildingSectionCount(); ++BuildingSection) {
+			FVector Start, Along, Across;
+			FBox Extent;
+			if (!GetSegmentBounds(BuildingSection, Start, Along, Across, Extent)) {
+				continue;
+			}
+
+			float HeightOffset = Extent.Min.Z;
+			for (const auto& floor : Floors) {
+				// Where along the chord each door runs
+				Doors.Reset();
+				const FBuildingLayoutPtr Layout = FindLayout(Layouts, Parts, floor.Sections[BuildingSection], BuildingSection);
+				for (const BuildingCore::FPlacement& Placement : Layout->Placements) {
+					const FMeshData& MeshType = MeshTypes[Placement.MeshType];
+					if (MeshType.Opening != EBuildingOpening::Door) {
+						continue;
+					}
+					const FVector DoorStart = BuildingCore::ToVector(Placement.Start);
+					const FVector DoorEnd = DoorStart + BuildingCore::GetRotation(Placement).Vector() * (MeshType.Length * Layout->PatternScale);
+					const float A = FVector::DotProduct(DoorStart - Start, Along);
+					const float B = FVector::DotProduct(DoorEnd - Start, Along);
+					Doors.Add(FVector2D(FMath::Min(A, B), FMath::Max(A, B)));
+				}
+				Doors.Sort([](const FVector2D& A, const FVector2D& B) { return A.X < B.X; });
+
+				float WallStart = Extent.Min.X;
+				for (const FVector2D& Door : Doors) {
+					if (Door.X > WallStart) {
+						AddBox(Start, Along, Across, WallStart, FMath::Min(Door.X, Extent.Max.X), Extent.Min.Y - CollisionThickness * 0.5f, Extent.Max.Y + CollisionThickness * 0.5f, HeightOffset, HeightOffset + floor.Height);
+					}
+					WallStart = FMath::Max(WallStart, Door.Y);
+				}
+				if (WallStart < Extent.Max.X) {
+					AddBox(Start, Along, Across, WallStart, Extent.Max.X, Extent.Min.Y - CollisionThickness * 0.5f, Extent.Max.Y + CollisionThickness * 0.5f, HeightOffset, HeightOffset + floor.Height);
+				}
+				HeightOffset += floor.Height;
+			}
+		}
+	}
+
+	if ((FillBottom || FillTop) && ArcLengths.Locations.Num() > 0) {
+		// The fill is built in world space from the spline, see CreateFill
+		const FTransform& SplineTransform = SplineComponent->GetComponentTransform();
+		const float Z = SplineComponent->Bounds.Origin.Z;
+		TArray<FVector2D> Footprint;
+		Footprint.Reserve(ArcLengths.Locations.Num());
+		float LocalZ = 0.0f;
+		for (const FVector& Location : ArcLengths.Locations) {
+			FVector World = SplineTransform.TransformPosition(Location);
+			World.Z = Z;
+			const FVector Local = GetTransform().InverseTransformPosition(World);
+			Footprint.Add(FVector2D(Local.X, Local.Y));
+			LocalZ = Local.Z;
+		}
+
+		TArray<FVector2D> Hull;
+		BuildingFill::ConvexHull(Footprint, Hull);
+		const auto AddSlab = [&Convexes, &Hull](float MinZ, float MaxZ) {
+			TArray<FVector>& Slab = Convexes.AddDefaulted_GetRef();
+			Slab.Reserve(Hull.Num() * 2);
+			for (const FVector2D& Point : Hull) {
+				Slab.Add(FVector(Point.X, Point.Y, MinZ));
+				Slab.Add(FVector(Point.X, Point.Y, MaxZ));
+			}
+		};
+		if (Hull.Num() >= 3) {
+			if (FillBottom) {
+				AddSlab(LocalZ - CollisionThickness, LocalZ);
+			}
+			if (FillTop) {
+				const float Top = LocalZ + TotalHeight - TopSink;
+				AddSlab(Top - CollisionThickness, Top);
+			}
+		}
+	}
+
+	MeshComponent->SetCollisionConvexMeshes(Convexes);
+}
+
+void ABuilding::CreateTriangulatedFill(TArray<FVector>& generalVertices, TArray<int32>& bottomTriangles, TArray<int32>& topTriangles) const
+{
+	// Footprint polyline from the sampled spline; the last sample of a closed loop repeats the first
+	const FTransform& SplineTransform = SplineComponent->GetComponentTransform();
+	const float Z = SplineComponent->Bounds.Origin.Z;
+
+	TArray<FVector2D> Polygon;
+	Polygon.Reserve(ArcLengths.Locations.Num());
+	for (const FVector& Location : ArcLengths.Locations) {
+		const FVector World = SplineTransform.TransformPosition(Location);
+		Polygon.Add(FVector2D(World.X, World.Y));
+	}
+	BuildingFill::SimplifyPolygon(Polygon, FillSimplifyTolerance);
+
+	FANTASY_SCOPE(STAT_BuildingFillTriangulate);
+
+	TArray<int32> Triangles;
+	if (!BuildingFill::TriangulatePolygon(Polygon, Triangles)) {
+		UE_LOG(LogTemp, Warning, TEXT("%s: footprint could not be triangulated, falling back to the grid fill"), *GetName());
+		CreateGridFill(generalVertices, bottomTriangles, topTriangles);
+		return;
+	}
+	BuildingFill::SubdividePolygon(Polygon, Triangles, FillSubdivisions);
+
+	generalVertices.Reserve(Polygon.Num());
+	for (const FVector2D& Point : Polygon) {
+		generalVertices.Add(FVector(Point.X, Point.Y, Z));
+	}
+
+	// Triangles wind clockwise seen from above, which faces up
+	topTriangles = Triangles;
+	bottomTriangles.Reserve(Triangles.Num());
+	for (int i = 0; i < Triangles.Num(); i += 3) {
+		bottomTriangles.Add(Triangles[i]);
+		bottomTriangles.Add(Triangles[i + 2]);
+		bottomTriangles.Add(Triangles[i + 1]);
+	}
+}
+
+void ABuilding::CreateGridFill(TArray<FVector>& generalVertices, TArray<int32>& bottomTriangles, TArray<int32>& topTriangles) const
+{
+	constexpr float TriangleSize = 64.0f;
+
+	const auto& ComponentBounds = SplineComponent->Bounds.BoxExtent;
+	const auto& ComponentOrigin = SplineComponent->Bounds.Origin;
+	int NumX = FMath::CeilToInt((ComponentBounds.X / TriangleSize) + 1);
+	int NumY = FMath::CeilToInt((ComponentBounds.Y / ((TriangleSize / 2.0f) * FMath::Tan(FMath::DegreesToRadians(60)))) + 1);
+
+	TArray<int8> pointIndex;
+	{
+		FANTASY_SCOPE(STAT_BuildingFillClassify);
+		for (int y = -NumY; y <= NumY; ++y) {
+			for (int x = -NumX; x <= NumX; ++x) {
+				int CurrentX = ComponentOrigin.X + (TriangleSize * x) + ((TriangleSize / 2.0f) * (FMath::Abs(y + NumY) % 2));
+				int CurrentY = ComponentOrigin.Y + (TriangleSize / 2.0f * FMath::Tan(FMath::DegreesToRadians(60)) * y);
+				FVector CurrentLocation(CurrentX, CurrentY, ComponentOrigin.Z);
+				
+				FVector CurrentEdgeLocation = SplineComponent->FindLocationClosestToWorldLocation(CurrentLocation, ESplineCoordinateSpace::World);
+				FVector DistanceClosest = SplineComponent->FindDirectionClosestToWorldLocation(CurrentLocation, ESplineCoordinateSpace::World);
+				const bool inside = FVector::DotProduct(CurrentEdgeLocation - CurrentLocation, FVector::CrossProduct(FVector::UpVector, DistanceClosest)) > 0;
+				const bool edge = (CurrentEdgeLocation - CurrentLocation).Size() < TriangleSize;
+	
+				if (inside) {
+					// Inside
+					generalVertices.Add(CurrentLocation);
+					pointIndex.Add(0);
+				} else if (edge) {
+					// Edge
+					generalVertices.Add(CurrentEdgeLocation);
+					pointIndex.Add(1);
+				} else {
+					// Outside
+					generalVertices.Add(CurrentLocation);
+					pointIndex.Add(-1);
+				}
+			}
+		}
+	}
+
+	FANTASY_SCOPE(STAT_BuildingFillTriangulate);
+
+	const int GridX = NumX * 2;
+	if (FillBottom) {
+		TArray<int32>& triangles = bottomTriangles;
+
+		for (int i = GridX + 1; i <= generalVertices.Num() - 2; ++i) {
+			if ((i + 1) % (GridX + 1) == 0) {
+				continue;
+			}
+			int a = ((((i / (GridX + 1)) % 2) * -1) + 1) + i;
+			int b = i - (GridX + 1);
+			int c = i - (GridX + 1) + 1;
+
+			if (pointIndex[a] >= 0 && pointIndex[b] >= 0 && pointIndex[c] >= 0) {
+				// Inverted Tris
+				triangles.Add(a);
+				triangles.Add(b);
+				triangles.Add(c);
+			}
+
+			a = i;
+			b = i - ((GridX + 1) - ((i / (GridX + 1)) % 2));
+			c = i + 1;
+
+			if (pointIndex[a] >= 0 && pointIndex[b] >= 0 && pointIndex[c] >= 0) {
+				// Tris
+				triangles.Add(a);
+				triangles.Add(b);
+				triangles.Add(c);
+			}
+		}
+	}
+
+	if (FillTop) {
+		TArray<int32>& triangles = topTriangles;
+
+		for (int i = GridX + 1; i <= generalVertices.Num() - 2; ++i) {
+			if ((i + 1) % (GridX + 1) == 0) {
+				continue;
+			}
+			int a = ((((i / (GridX + 1)) % 2) * -1) + 1) + i;
+			int b = i - (GridX + 1) + 1;
+			int c = i - (GridX + 1);
+
+			if (pointIndex[a] >= 0 && pointIndex[b] >= 0 && pointIndex[c] >= 0) {
+				// Inverted Tris
+				triangles.Add(a);
+				triangles.Add(b);
+				triangles.Add(c);
+			}
+
+			a = i;
+			b = i + 1;
+			c = i - ((GridX + 1) - ((i / (GridX + 1)) % 2));
+
+			if (pointIndex[a] >= 0 && pointIndex[b] >= 0 && pointIndex[c] >= 0) {
+				// Tris
+				triangles.Add(a);
+				triangles.Add(b);
+				triangles.Add(c);
+			}
+		}
+	}
+}
+
+void ABuilding::UpdateCoverPoints(const FBuildingParts& Parts, const TArray<uint32>& SegmentKeys)
+{
+	FANTASY_SCOPE(STAT_BuildingCover);
+
+	const bool bCover = bGenerateCover && Floors.Num() > 0;
+	uint32 Key = GetTypeHash(bCover);
+	if (bCover) {
+		Key = HashCombine(Key, GetTypeHash(CoverSpacing));
+		Key = HashCombine(Key, GetTypeHash(CoverOffset));
+		for (const FMeshData& MeshType : MeshTypes) {
+			Key = HashCombine(Key, GetTypeHash(MeshType.Length));
+			Key = HashCombine(Key, GetTypeHash(MeshType.Opening));
+			Key = HashCombine(Key, GetTypeHash(MeshType.StaticMesh != nullptr));
+		}
+		for (int BuildingSection = 0; BuildingSection < SegmentKeys.Num(); ++BuildingSection) {
+			Key = HashCombine(Key, HashCombine(SegmentKeys[BuildingSection], GetPatternKey(Floors[0].Sections[BuildingSection])));
+		}
+	}
+	if (Key == CoverKey) {
+		return;
+	}
+	CoverKey = Key;
+	CoverPoints.Reset();
+
+	if (bCover) {
+		// Walls face out of a closed footprint, which side that is follows from its winding; open ones get both sides
+		float Winding = 0.0f;
+		if (SplineComponent->IsClosedLoop()) {
+			const TArray<FVector>& Outline = ArcLengths.Locations;
+			for (int i = 0; i < Outline.Num(); ++i) {
+				const FVector& A = Outline[i];
+				const FVector& B = Outline[(i + 1) % Outline.Num()];
+				Winding += A.X * B.Y - B.X * A.Y;
+			}
+		}
+
+		TMap<uint32, FBuildingLayoutPtr> Layouts;
+		for (int BuildingSection = 0; BuildingSection < SegmentKeys.Num(); ++BuildingSection) {
+			const FBuildingLayoutPtr Layout = FindLayout(Layouts, Parts, Floors[0].Sections[BuildingSection], BuildingSection);
+			for (const BuildingCore::FPlacement& Placement : Layout->Placements) {
+				const FVector Along = BuildingCore::GetRotation(Placement).Vector().GetSafeNormal2D();
+				if (Along.IsZero()) {
+					continue;
+				}
+				const FMeshData& MeshType = MeshTypes[Placement.MeshType];
+				const float Width = MeshType.Length * Layout->PatternScale;
+				const int Count = FMath::Max(1, FMath::FloorToInt(Width / CoverSpacing));
+				const FVector Right(Along.Y, -Along.X, 0.0f);
+
+				for (int i = 0; i < Count; ++i) {
+					const FVector OnWall = BuildingCore::ToVector(Placement.Start) + Along * (Width * (i + 0.5f) / Count);
+					for (const float Side : { 1.0f, -1.0f }) {
+						if (Winding != 0.0f && (Winding > 0.0f) != (Side > 0.0f)) {
+							continue;
+						}
+						FCoverPoint& Point = CoverPoints.AddDefaulted_GetRef();
+						Point.Normal = Right * Side;
+						Point.Location = OnWall + Point.Normal * CoverOffset;
+						Point.bWindow = MeshType.Opening == EBuildingOpening::Window;
+						Point.bDoor = MeshType.Opening == EBuildingOpening::Door;
+						Point.Height = Point.bDoor ? ECoverHeight::None : Point.bWindow ? ECoverHeight::Low : ECoverHeight::High;
+					}
+				}
+			}
+		}
+	}
+	CoverPointCount = CoverPoints.Num();
+
+	if (HasActorBegunPlay()) {
+		RegisterCoverPoints();
+	}
+}
+
+void ABuilding::RegisterCoverPoints()
+{
+	UWorld* World = GetWorld();
+	UCoverPointSubsystem* Cover = World != nullptr && World->IsGameWorld() ? World->GetSubsystem<UCoverPointSubsystem>() : nullptr;
+	if (Cover == nullptr) {
+		return;
+	}
+
+	const FTransform& Transform = GetActorTransform();
+	TArray<FCoverPoint> WorldPoints = CoverPoints;
+	for (FCoverPoint& Point : WorldPoints) {
+		Point.Location = Transform.TransformPosition(Point.Location);
+		Point.Normal = Transform.TransformVectorNoScale(Point.Normal).GetSafeNormal2D();
+	}
+	Cover->RegisterBuilding(this, WorldPoints);
+}
+
+void ABuilding::Regenerate(bool bFromScratch)
+{
+	if (bFromScratch) {
+		Chunks.Reset();
+		LODChunks.Reset();
+		MeshTypesKey = 0;
+		FillKey = 0;
+		FarLODKey = 0;
+	}
+	CreateMesh();
+}
+
+void ABuilding::WarmGeometryCache()
+{
+	const bool bWasAsync = bAsyncGeneration;
+	const bool bWasCached = bUseGeometryCache;
+	bAsyncGeneration = false;
+	bUseGeometryCache = true;
+
+	// Start from nothing, so the build counts as a full one and gets written out
+	Regenerate(true);
+
+	bAsyncGeneration = bWasAsync;
+	bUseGeometryCache = bWasCached;
+}
+
+// Called every frame
+void ABuilding::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (bPreviewActive && !bInteractiveEdit && FPlatformTime::Seconds() - LastEditTime >= PreviewSettleSeconds) {
+		EndPreview();
+		CreateMesh();
+	}
 }
 
@@ -0,0 +1,404 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingBenchmarkCommandlet.h"
+#include "Building.h"
+#include "BuildingPartCache.h"
+#include "ProceduralMeshComponent.h"
+#include <Components/SplineComponent.h>
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "Engine/Engine.h"
+#include "Materials/Material.h"
+#include "Materials/MaterialInstanceConstant.h"
+#include "Misc/FileHelper.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonWriter.h"
+#include "Serialization/JsonSerializer.h"
+
+namespace
+{
+	// Forwards to the real allocator, counting allocations from every thread. Installed while the cases run.
+	class FCountingMalloc final : public FMalloc {
+	public:
+		explicit FCountingMalloc(FMalloc* InInner) : Inner(InInner) {}
+
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			Allocations.Increment();
+			return Inner->Malloc(Count, Alignment);
+		}
+
+		virtual void* TryMalloc(SIZE_T Count, uint32 Alignment) override
+		{
+			Allocations.Increment();
+			return Inner->TryMalloc(Count, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			if (Count > 0) {
+				Allocations.Increment();
+			}
+			return Inner->Realloc(Original, Count, Alignment);
+		}
+
+		virtual void* TryRealloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			if (Count > 0) {
+				Allocations.Increment();
+			}
+			return Inner->TryRealloc(Original, Count, Alignment);
+		}
+
+		virtual void Free(void* Original) override { Inner->Free(Original); }
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return Inner->QuantizeSize(Count, Alignment); }
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+		virtual void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+		virtual void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+		virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+		virtual bool ValidateHeap() override { return Inner->ValidateHeap(); }
+		virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override { Inner->GetAllocatorStats(OutStats); }
+		virtual void DumpAllocatorStats(FOutputDevice& Ar) override { Inner->DumpAllocatorStats(Ar); }
+		virtual const TCHAR* GetDescriptiveName() override { return Inner->GetDescriptiveName(); }
+
+		FMalloc* Inner;
+		FThreadSafeCounter64 Allocations;
+	};
+
+	struct FBenchmarkCase {
+		int Segments = 16;
+		int Floors = 4;
+		int PatternLength = 2;
+		bool bClosed = true;
+		bool bFill = false;
+		EBuildingOutputMode Mode = EBuildingOutputMode::Merged;
+	};
+
+	TArray<int> ParseList(const FString& Params, const TCHAR* Name, const TArray<int>& Default)
+	{
+		FString Value;
+		if (!FParse::Value(*Params, Name, Value)) {
+			return Default;
+		}
+
+		TArray<FString> Items;
+		Value.ParseIntoArray(Items, TEXT(","));
+		TArray<int> Result;
+		for (const FString& Item : Items) {
+			Result.Add(FCString::Atoi(*Item));
+		}
+		return Result;
+	}
+
+	// A flat wall panel of Tessellation x Tessellation quads plus a one-quad trim on top, in two material sections
+	FBuildingPartPtr CreatePanel(float Length, float Height, int Tessellation, UMaterialInterface* WallMaterial, UMaterialInterface* TrimMaterial)
+	{
+		TSharedPtr<FBuildingPart, ESPMode::ThreadSafe> Part = MakeShared<FBuildingPart, ESPMode::ThreadSafe>();
+		Part->Sections.SetNum(2);
+
+		FBuildingPartSection& Wall = Part->Sections[0];
+		Wall.Material = WallMaterial;
+		for (int z = 0; z <= Tessellation; ++z) {
+			for (int x = 0; x <= Tessellation; ++x) {
+				const FVector2D UV(x / float(Tessellation), z / float(Tessellation));
+				Wall.Positions.Add(FVector(UV.X * Length, 0.0f, UV.Y * Height));
+				Wall.UVs.Add(UV);
+				Wall.TangentZ.Add(FVector(0.0f, -1.0f, 0.0f));
+				Wall.TangentX.Add(FVector(1.0f, 0.0f, 0.0f));
+			}
+		}
+		for (int z = 0; z < Tessellation; ++z) {
+			for (int x = 0; x < Tessellation; ++x) {
+				const int a = z * (Tessellation + 1) + x;
+				const int b = a + Tessellation + 1;
+				Wall.Indices.Append({ a, b, a + 1, a + 1, b, b + 1 });
+			}
+		}
+
+		FBuildingPartSection& Trim = Part->Sections[1];
+		Trim.Material = TrimMaterial;
+		Trim.Positions = { FVector(0.0f, -20.0f, Height), FVector(Length, -20.0f, Height), FVector(0.0f, 0.0f, Height), FVector(Length, 0.0f, Height) };
+		Trim.UVs = { FVector2D(0.0f, 0.0f), FVector2D(1.0f, 0.0f), FVector2D(0.0f, 1.0f), FVector2D(1.0f, 1.0f) };
+		Trim.TangentZ.Init(FVector::UpVector, 4);
+		Trim.TangentX.Init(FVector(1.0f, 0.0f, 0.0f), 4);
+		Trim.Indices = { 0, 2, 1, 1, 2, 3 };
+
+		Part->Version = HashCombine(GetTypeHash(Length), HashCombine(GetTypeHash(Height), GetTypeHash(Tessellation)));
+		return Part;
+	}
+
+	void SetUpBuilding(ABuilding& Building, const FBenchmarkCase& Case, const TArray<UStaticMesh*>& Meshes)
+	{
+		Building.bAsyncGeneration = false;
+		Building.bUseGeometryCache = false;
+		Building.OutputMode = Case.Mode;
+		Building.FillTop = Case.bFill;
+		Building.FillBottom = Case.bFill;
+
+		Building.MeshTypes.Reset();
+		for (int i = 0; i < Case.PatternLength; ++i) {
+			FMeshData& MeshType = Building.MeshTypes.AddDefaulted_GetRef();
+			MeshType.StaticMesh = Meshes[i];
+			MeshType.Length = 200.0f + 50.0f * i;
+			MeshType.Height = 300.0f;
+		}
+
+		// Segments of roughly 600 units: around a circle when closed, along a shallow arc when open
+		USplineComponent& Spline = *Building.SplineComponent;
+		Spline.ClearSplinePoints(false);
+		const int Points = Case.bClosed ? Case.Segments : Case.Segments + 1;
+		const float Radius = Case.Segments * 600.0f / (2.0f * PI);
+		const float Sweep = Case.bClosed ? 2.0f * PI : PI / 2.0f;
+		for (int i = 0; i < Points; ++i) {
+			const float Angle = Sweep * i / Case.Segments;
+			Spline.AddSplinePoint(FVector(FMath::Cos(Angle) * Radius, FMath::Sin(Angle) * Radius, 0.0f), ESplineCoordinateSpace::Local, false);
+			Spline.SetSplinePointType(i, ESplinePointType::Linear, false);
+		}
+		Spline.SetClosedLoop(Case.bClosed, false);
+		Spline.UpdateSpline();
+		Spline.UpdateBounds();
+
+		// Every floor runs the whole pattern on every segment, starting one item further along than the floor below
+		Building.Floors.SetNum(Case.Floors);
+		for (int f = 0; f < Case.Floors; ++f) {
+			FFloorType& Floor = Building.Floors[f];
+			Floor.Height = 300.0f;
+			Floor.Sections.SetNum(Case.Segments);
+			for (FBuildingSection& Section : Floor.Sections) {
+				Section.Pattern.Reset();
+				for (int i = 0; i < Case.PatternLength; ++i) {
+					Section.Pattern.Add((f + i) % Case.PatternLength);
+				}
+			}
+		}
+	}
+
+	int64 GetUsedPhysical()
+	{
+		return FPlatformMemory::GetStats().UsedPhysical;
+	}
+
+	TSharedRef<FJsonObject> RunCase(UWorld& World, const FBenchmarkCase& Case, const TArray<UStaticMesh*>& Meshes, int Iterations, FCountingMalloc& Counter)
+	{
+		ABuilding* Building = World.SpawnActor<ABuilding>();
+		SetUpBuilding(*Building, Case, Meshes);
+
+		// Warm up once so one-off costs (part lookups, first buffer growth) stay out of the timings
+		Building->Regenerate(true);
+
+		const int64 MemoryBefore = GetUsedPhysical();
+		FBuildingTimings PhaseTotals;
+		double Min = MAX_dbl;
+		double Max = 0.0;
+		double Sum = 0.0;
+		int64 Allocations = 0;
+		for (int i = 0; i < Iterations; ++i) {
+			const int64 AllocationsBefore = Counter.Allocations.GetValue();
+			const double Start = FPlatformTime::Seconds();
+			Building->Regenerate(true);
+			const double Seconds = FPlatformTime::Seconds() - Start;
+			Allocations += Counter.Allocations.GetValue() - AllocationsBefore;
+
+			Min = FMath::Min(Min, Seconds);
+			Max = FMath::Max(Max, Seconds);
+			Sum += Seconds;
+
+			const FBuildingTimings& Timings = Building->GetTimings();
+			PhaseTotals.Parts += Timings.Parts;
+			PhaseTotals.Layout += Timings.Layout;
+			PhaseTotals.Generate += Timings.Generate;
+			PhaseTotals.Upload += Timings.Upload;
+			PhaseTotals.Fill += Timings.Fill;
+		}
+		const int64 MemoryAfter = GetUsedPhysical();
+
+		// Nothing changed, so this only measures the key checks and chunk reuse
+		const double IncrementalStart = FPlatformTime::Seconds();
+		Building->Regenerate(false);
+		const double IncrementalSeconds = FPlatformTime::Seconds() - IncrementalStart;
+
+		int64 Vertices = 0;
+		int64 Triangles = 0;
+		int32 Sections = 0;
+		for (int i = 0; i < Building->MeshComponent->GetNumSections(); ++i) {
+			const FProcMeshSection* Section = Building->MeshComponent->GetProcMeshSection(i);
+			if (Section != nullptr && Section->ProcVertexBuffer.Num() > 0) {
+				Vertices += Section->ProcVertexBuffer.Num();
+				Triangles += Section->ProcIndexBuffer.Num() / 3;
+				++Sections;
+			}
+		}
+		int64 Instances = 0;
+		TArray<UInstancedStaticMeshComponent*> InstanceComponents;
+		Building->GetComponents(InstanceComponents);
+		for (const UInstancedStaticMeshComponent* Component : InstanceComponents) {
+			Instances += Component->GetInstanceCount();
+		}
+
+		const double ToMs = 1000.0 / Iterations;
+		TSharedRef<FJsonObject> Phases = MakeShared<FJsonObject>();
+		Phases->SetNumberField(TEXT("Parts"), PhaseTotals.Parts * ToMs);
+		Phases->SetNumberField(TEXT("Layout"), PhaseTotals.Layout * ToMs);
+		Phases->SetNumberField(TEXT("Generate"), PhaseTotals.Generate * ToMs);
+		Phases->SetNumberField(TEXT("Upload"), PhaseTotals.Upload * ToMs);
+		Phases->SetNumberField(TEXT("Fill"), PhaseTotals.Fill * ToMs);
+
+		TSharedRef<FJsonObject> Result = MakeShared<FJsonObject>();
+		Result->SetNumberField(TEXT("Segments"), Case.Segments);
+		Result->SetNumberField(TEXT("Floors"), Case.Floors);
+		Result->SetNumberField(TEXT("PatternLength"), Case.PatternLength);
+		Result->SetBoolField(TEXT("Closed"), Case.bClosed);
+		Result->SetBoolField(TEXT("Fill"), Case.bFill);
+		Result->SetStringField(TEXT("Mode"), Case.Mode == EBuildingOutputMode::Instanced ? TEXT("Instanced") : TEXT("Merged"));
+		Result->SetNumberField(TEXT("Iterations"), Iterations);
+		Result->SetNumberField(TEXT("MinMs"), Min * 1000.0);
+		Result->SetNumberField(TEXT("MeanMs"), Sum * ToMs);
+		Result->SetNumberField(TEXT("MaxMs"), Max * 1000.0);
+		Result->SetObjectField(TEXT("PhaseMeanMs"), Phases);
+		Result->SetNumberField(TEXT("IncrementalMs"), IncrementalSeconds * 1000.0);
+		Result->SetNumberField(TEXT("Vertices"), Vertices);
+		Result->SetNumberField(TEXT("Triangles"), Triangles);
+		Result->SetNumberField(TEXT("Sections"), Sections);
+		Result->SetNumberField(TEXT("Instances"), Instances);
+		Result->SetNumberField(TEXT("HeapAllocationsPerBuild"), Allocations / double(Iterations));
+		Result->SetNumberField(TEXT("BufferAllocations"), Building->BufferAllocations);
+		Result->SetNumberField(TEXT("SegmentsRepeated"), Building->SegmentsRepeated);
+		Result->SetNumberField(TEXT("MergedMemoryBytes"), Building->MergedMemoryBytes);
+		Result->SetNumberField(TEXT("InstancedMemoryBytes"), Building->InstancedMemoryBytes);
+		Result->SetNumberField(TEXT("UsedPhysicalDeltaBytes"), MemoryAfter - MemoryBefore);
+
+		Building->Destroy();
+		return Result;
+	}
+}
+
+UBuildingBenchmarkCommandlet::UBuildingBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UBuildingBenchmarkCommandlet::Main(const FString& Params)
+{
+	FString OutputPath = FPaths::ProjectSavedDir() / TEXT("BuildingBenchmark.json");
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+	int Iterations = 5;
+	FParse::Value(*Params, TEXT("Iterations="), Iterations);
+	Iterations = FMath::Max(1, Iterations);
+	int Tessellation = 4;
+	FParse::Value(*Params, TEXT("Tessellation="), Tessellation);
+	Tessellation = FMath::Max(1, Tessellation);
+
+	const TArray<int> SegmentCounts = ParseList(Params, TEXT("Segments="), { 4, 16, 64 });
+	const TArray<int> FloorCounts = ParseList(Params, TEXT("Floors="), { 1, 8 });
+	const TArray<int> PatternLengths = ParseList(Params, TEXT("Pattern="), { 1, 4 });
+	const TArray<int> ClosedLoops = ParseList(Params, TEXT("Closed="), { 1, 0 });
+	const TArray<int> Fills = ParseList(Params, TEXT("Fill="), { 0, 1 });
+
+	TArray<EBuildingOutputMode> Modes = { EBuildingOutputMode::Merged, EBuildingOutputMode::Instanced };
+	FString ModeList;
+	if (FParse::Value(*Params, TEXT("Modes="), ModeList)) {
+		Modes.Reset();
+		if (ModeList.Contains(TEXT("Merged"))) {
+			Modes.Add(EBuildingOutputMode::Merged);
+		}
+		if (ModeList.Contains(TEXT("Instanced"))) {
+			Modes.Add(EBuildingOutputMode::Instanced);
+		}
+	}
+
+	int MaxPatternLength = 1;
+	for (int PatternLength : PatternLengths) {
+		MaxPatternLength = FMath::Max(MaxPatternLength, PatternLength);
+	}
+
+	// Part meshes exist only in the part cache, so nothing has to be cooked or rendered
+	UMaterialInterface* DefaultMaterial = UMaterial::GetDefaultMaterial(MD_Surface);
+	UMaterialInstanceConstant* WallMaterial = NewObject<UMaterialInstanceConstant>(GetTransientPackage(), TEXT("BenchmarkWall"));
+	WallMaterial->Parent = DefaultMaterial;
+	UMaterialInstanceConstant* TrimMaterial = NewObject<UMaterialInstanceConstant>(GetTransientPackage(), TEXT("BenchmarkTrim"));
+	TrimMaterial->Parent = DefaultMaterial;
+	WallMaterial->AddToRoot();
+	TrimMaterial->AddToRoot();
+
+	TArray<UStaticMesh*> Meshes;
+	for (int i = 0; i < MaxPatternLength; ++i) {
+		UStaticMesh* Mesh = NewObject<UStaticMesh>(GetTransientPackage(), *FString::Printf(TEXT("BenchmarkPart%d"), i));
+		Mesh->GetStaticMaterials().Add(FStaticMaterial(WallMaterial));
+		Mesh->GetStaticMaterials().Add(FStaticMaterial(TrimMaterial));
+		Mesh->AddToRoot();
+		FBuildingPartCache::Get().Register(Mesh, CreatePanel(200.0f + 50.0f * i, 300.0f, Tessellation, WallMaterial, TrimMaterial));
+		Meshes.Add(Mesh);
+	}
+
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("BuildingBenchmark"));
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+
+	// Swapped in around the cases only; everything it hands out still belongs to the real allocator
+	FCountingMalloc Counter(GMalloc);
+	GMalloc = &Counter;
+
+	TArray<TSharedPtr<FJsonValue>> Cases;
+	for (EBuildingOutputMode Mode : Modes) {
+		for (int Segments : SegmentCounts) {
+			for (int Floors : FloorCounts) {
+				for (int PatternLength : PatternLengths) {
+					for (int Closed : ClosedLoops) {
+						for (int Fill : Fills) {
+							FBenchmarkCase Case;
+							Case.Segments = FMath::Max(Closed ? 3 : 1, Segments);
+							Case.Floors = FMath::Max(1, Floors);
+							Case.PatternLength = FMath::Clamp(PatternLength, 1, MaxPatternLength);
+							Case.bClosed = Closed != 0;
+							Case.bFill = Fill != 0;
+							Case.Mode = Mode;
+
+							TSharedRef<FJsonObject> Result = RunCase(*World, Case, Meshes, Iterations, Counter);
+							UE_LOG(LogTemp, Display, TEXT("%s %d segments, %d floors, pattern %d, %s, fill %d: %.3f ms"),
+								Mode == EBuildingOutputMode::Instanced ? TEXT("Instanced") : TEXT("Merged"),
+								Case.Segments, Case.Floors, Case.PatternLength, Case.bClosed ? TEXT("closed") : TEXT("open"), Case.bFill,
+								Result->GetNumberField(TEXT("MeanMs")));
+							Cases.Add(MakeShared<FJsonValueObject>(Result));
+						}
+					}
+				}
+			}
+		}
+	}
+
+	GMalloc = Counter.Inner;
+
+	TSharedRef<FJsonObject> Report = MakeShared<FJsonObject>();
+	Report->SetStringField(TEXT("Platform"), FPlatformProperties::IniPlatformName());
+	Report->SetStringField(TEXT("Cpu"), FPlatformMisc::GetCPUBrand());
+	Report->SetNumberField(TEXT("Cores"), FPlatformMisc::NumberOfCoresIncludingHyperthreads());
+	Report->SetNumberField(TEXT("Tessellation"), Tessellation);
+	Report->SetNumberField(TEXT("PeakUsedPhysicalBytes"), FPlatformMemory::GetStats().PeakUsedPhysical);
+	Report->SetArrayField(TEXT("Cases"), Cases);
+
+	FString Json;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+	FJsonSerializer::Serialize(Report, Writer);
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	for (UStaticMesh* Mesh : Meshes) {
+		FBuildingPartCache::Get().Invalidate(Mesh);
+		Mesh->RemoveFromRoot();
+	}
+	WallMaterial->RemoveFromRoot();
+	TrimMaterial->RemoveFromRoot();
+
+	if (!FFileHelper::SaveStringToFile(Json, *OutputPath)) {
+		UE_LOG(LogTemp, Error, TEXT("Could not write %s"), *OutputPath);
+		return 1;
+	}
+	UE_LOG(LogTemp, Display, TEXT("Wrote %d cases to %s"), Cases.Num(), *OutputPath);
+	return 0;
+}
@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingCacheCommandlet.h"
+#include "Building.h"
+#include "BuildingGeometryCache.h"
+#include "EngineUtils.h"
+#include "Engine/World.h"
+
+UBuildingCacheCommandlet::UBuildingCacheCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UBuildingCacheCommandlet::Main(const FString& Params)
+{
+	FString MapName;
+	if (!FParse::Value(*Params, TEXT("Map="), MapName)) {
+		UE_LOG(LogTemp, Error, TEXT("Usage: -run=BuildingCache -Map=/Game/Map/Main"));
+		return 1;
+	}
+
+	UPackage* Package = LoadPackage(nullptr, *MapName, LOAD_None);
+	UWorld* World = Package != nullptr ? UWorld::FindWorldInPackage(Package) : nullptr;
+	if (World == nullptr) {
+		UE_LOG(LogTemp, Error, TEXT("Could not load map %s"), *MapName);
+		return 1;
+	}
+
+	World->AddToRoot();
+	if (!World->bIsWorldInitialized) {
+		World->WorldType = EWorldType::Editor;
+		World->InitWorld(UWorld::InitializationValues()
+			.AllowAudioPlayback(false)
+			.CreatePhysicsScene(false)
+			.RequiresHitProxies(false)
+			.CreateNavigation(false)
+			.CreateAISystem(false)
+			.ShouldSimulatePhysics(false));
+	}
+	World->UpdateWorldComponents(true, false);
+
+	int32 Count = 0;
+	const double Start = FPlatformTime::Seconds();
+	for (TActorIterator<ABuilding> It(World); It; ++It) {
+		It->WarmGeometryCache();
+		++Count;
+	}
+
+	FBuildingGeometryCache::Flush();
+	FBuildingGeometryCache::Trim(FBuildingGeometryCache::GetMaxSize());
+
+	UE_LOG(LogTemp, Display, TEXT("Cached %d buildings from %s in %.2f s"), Count, *MapName, FPlatformTime::Seconds() - Start);
+
+	World->DestroyWorld(false);
+	World->RemoveFromRoot();
+	return 0;
+}
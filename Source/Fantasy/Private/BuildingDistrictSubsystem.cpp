@@ -0,0 +1,273 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingDistrictSubsystem.h"
+#include "BuildingPartCache.h"
+#include "BuildingStats.h"
+#include <Components/SplineComponent.h>
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Misc/FileHelper.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+int32 UBuildingDistrictSubsystem::QueueBuildings(const TArray<FBuildingRequest>& Requests, const UDataTable* Presets)
+{
+	if (Presets == nullptr) {
+		UE_LOG(LogTemp, Warning, TEXT("QueueBuildings: no preset table"));
+		return 0;
+	}
+
+	for (const FBuildingRequest& Request : Requests) {
+		// Decode each preset's part meshes once, up front, instead of inside the first building's budget
+		bool bAlreadyWarmed = false;
+		WarmedPresets.Add(TPair<const UDataTable*, FName>(Presets, Request.Preset), &bAlreadyWarmed);
+		if (!bAlreadyWarmed) {
+			if (const FBuildingPresetRow* Preset = Presets->FindRow<FBuildingPresetRow>(Request.Preset, TEXT("QueueBuildings"))) {
+				for (const FMeshData& MeshType : Preset->MeshTypes) {
+					FBuildingPartCache::Get().Find(MeshType.StaticMesh);
+				}
+			}
+		}
+
+		FBuildingDistrictEntry& Entry = Queued.AddDefaulted_GetRef();
+		Entry.Request = Request;
+		Entry.Presets = Presets;
+	}
+	Total += Requests.Num();
+	return Requests.Num();
+}
+
+int32 UBuildingDistrictSubsystem::QueueFootprintTable(const UDataTable* Footprints, const UDataTable* Presets)
+{
+	if (Footprints == nullptr) {
+		return 0;
+	}
+
+	TArray<FBuildingRequest*> Rows;
+	Footprints->GetAllRows(TEXT("QueueFootprintTable"), Rows);
+
+	TArray<FBuildingRequest> Requests;
+	Requests.Reserve(Rows.Num());
+	for (const FBuildingRequest* Row : Rows) {
+		Requests.Add(*Row);
+	}
+	return QueueBuildings(Requests, Presets);
+}
+
+int32 UBuildingDistrictSubsystem::QueueFootprintFile(const FString& Path, const UDataTable* Presets)
+{
+	FString Text;
+	if (!FFileHelper::LoadFileToString(Text, *Path)) {
+		UE_LOG(LogTemp, Warning, TEXT("QueueFootprintFile: could not read %s"), *Path);
+		return -1;
+	}
+
+	TSharedPtr<FJsonObject> Root;
+	if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Text), Root) || !Root.IsValid()) {
+		UE_LOG(LogTemp, Warning, TEXT("QueueFootprintFile: %s is not valid JSON"), *Path);
+		return -1;
+	}
+
+	auto ToVector = [](const TArray<TSharedPtr<FJsonValue>>& Values) {
+		FVector Result = FVector::ZeroVector;
+		for (int i = 0; i < Values.Num() && i < 3; ++i) {
+			Result[i] = Values[i]->AsNumber();
+		}
+		return Result;
+	};
+
+	TArray<FBuildingRequest> Requests;
+	const TArray<TSharedPtr<FJsonValue>>* Buildings = nullptr;
+	if (Root->TryGetArrayField(TEXT("buildings"), Buildings)) {
+		for (const TSharedPtr<FJsonValue>& Value : *Buildings) {
+			const TSharedPtr<FJsonObject>* Object = nullptr;
+			if (!Value->TryGetObject(Object)) {
+				continue;
+			}
+
+			FBuildingRequest& Request = Requests.AddDefaulted_GetRef();
+			Request.Preset = FName(*(*Object)->GetStringField(TEXT("preset")));
+
+			const TArray<TSharedPtr<FJsonValue>>* Location = nullptr;
+			double Yaw = 0.0;
+			(*Object)->TryGetNumberField(TEXT("yaw"), Yaw);
+			Request.Transform = FTransform(FRotator(0.0f, static_cast<float>(Yaw), 0.0f),
+				(*Object)->TryGetArrayField(TEXT("location"), Location) ? ToVector(*Location) : FVector::ZeroVector);
+			(*Object)->TryGetBoolField(TEXT("closed"), Request.bClosedLoop);
+
+			const TArray<TSharedPtr<FJsonValue>>* Points = nullptr;
+			if ((*Object)->TryGetArrayField(TEXT("points"), Points)) {
+				for (const TSharedPtr<FJsonValue>& Point : *Points) {
+					Request.Points.Add(ToVector(Point->AsArray()));
+				}
+			}
+		}
+	}
+	return QueueBuildings(Requests, Presets);
+}
+
+void UBuildingDistrictSubsystem::CancelQueued()
+{
+	Total -= Queued.Num();
+	Queued.Reset();
+}
+
+float UBuildingDistrictSubsystem::GetProgress() const
+{
+	return Total > 0 ? static_cast<float>(Completed) / Total : 1.0f;
+}
+
+void UBuildingDistrictSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+	if (!IsBusy()) {
+		return;
+	}
+
+	const int32 CompletedBefore = Completed;
+	const double Deadline = FPlatformTime::Seconds() + FrameBudgetMs / 1000.0;
+	bool bDidWork = false;
+	auto HasTime = [&bDidWork, Deadline]() {
+		return !bDidWork || FPlatformTime::Seconds() < Deadline;
+	};
+
+	FVector ViewLocation;
+	const bool bHasView = GetViewLocation(ViewLocation);
+
+	// Upload finished builds first, they are what the player is waiting for
+	InFlight.RemoveAll([this](const TWeakObjectPtr<ABuilding>& Building) {
+		if (!Building.IsValid()) {
+			++Completed;
+			return true;
+		}
+		return false;
+	});
+	if (bHasView) {
+		InFlight.Sort([&ViewLocation](const TWeakObjectPtr<ABuilding>& A, const TWeakObjectPtr<ABuilding>& B) {
+			return FVector::DistSquared(A->GetActorLocation(), ViewLocation) < FVector::DistSquared(B->GetActorLocation(), ViewLocation);
+		});
+	}
+	for (int i = 0; i < InFlight.Num() && HasTime(); ++i) {
+		ABuilding* Building = InFlight[i].Get();
+		if (Building->IsGenerating()) {
+			continue;
+		}
+		Building->ApplyPendingUpload();
+		FinishBuilding(Building);
+		InFlight.RemoveAt(i--);
+		bDidWork = true;
+	}
+
+	// Then start the nearest queued buildings, so the next frames have uploads ready
+	if (Queued.Num() > 0 && InFlight.Num() < MaxBuildsInFlight && HasTime()) {
+		if (bHasView) {
+			// Farthest first, nearest popped off the end
+			Queued.Sort([&ViewLocation](const FBuildingDistrictEntry& A, const FBuildingDistrictEntry& B) {
+				return FVector::DistSquared(A.Request.Transform.GetLocation(), ViewLocation) > FVector::DistSquared(B.Request.Transform.GetLocation(), ViewLocation);
+			});
+		}
+
+		while (Queued.Num() > 0 && InFlight.Num() < MaxBuildsInFlight && HasTime()) {
+			const FBuildingDistrictEntry Entry = Queued.Pop(false);
+			ABuilding* Building = SpawnBuilding(Entry);
+			bDidWork = true;
+			if (Building != nullptr && (Building->IsGenerating() || Building->HasPendingUpload())) {
+				InFlight.Add(Building);
+			} else {
+				// Failed, or built straight away from the geometry cache
+				FinishBuilding(Building);
+			}
+		}
+	}
+
+	if (Completed != CompletedBefore) {
+		OnProgress.Broadcast(Completed, Total);
+	}
+	if (!IsBusy()) {
+		UE_LOG(LogTemp, Display, TEXT("Building district: %d buildings done"), Total);
+		Completed = 0;
+		Total = 0;
+		OnComplete.Broadcast();
+	}
+}
+
+TStatId UBuildingDistrictSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UBuildingDistrictSubsystem, STATGROUP_Building);
+}
+
+ABuilding* UBuildingDistrictSubsystem::SpawnBuilding(const FBuildingDistrictEntry& Entry)
+{
+	const FBuildingRequest& Request = Entry.Request;
+	const FBuildingPresetRow* Preset = Entry.Presets != nullptr ? Entry.Presets->FindRow<FBuildingPresetRow>(Request.Preset, TEXT("SpawnBuilding")) : nullptr;
+	const int Segments = Request.bClosedLoop ? Request.Points.Num() : Request.Points.Num() - 1;
+	if (Preset == nullptr || Segments < 1 || (Request.bClosedLoop && Segments < 3)) {
+		UE_LOG(LogTemp, Warning, TEXT("Building district: skipped a %s building with %d points"), *Request.Preset.ToString(), Request.Points.Num());
+		return nullptr;
+	}
+
+	// Deferred, so the first generation happens once, with the footprint and preset in place
+	ABuilding* Building = GetWorld()->SpawnActorDeferred<ABuilding>(ABuilding::StaticClass(), Request.Transform);
+	if (Building == nullptr) {
+		return nullptr;
+	}
+
+	USplineComponent& Spline = *Building->SplineComponent;
+	Spline.ClearSplinePoints(false);
+	for (int i = 0; i < Request.Points.Num(); ++i) {
+		Spline.AddSplinePoint(Request.Points[i], ESplineCoordinateSpace::Local, false);
+		Spline.SetSplinePointType(i, ESplinePointType::Linear, false);
+	}
+	Spline.SetClosedLoop(Request.bClosedLoop, false);
+	Spline.UpdateSpline();
+
+	ApplyPreset(*Building, *Preset, Segments);
+	Building->bAsyncGeneration = true;
+	Building->SetUploadScheduled(true);
+	Building->FinishSpawning(Request.Transform);
+	return Building;
+}
+
+void UBuildingDistrictSubsystem::ApplyPreset(ABuilding& Building, const FBuildingPresetRow& Preset, int Segments)
+{
+	Building.MeshTypes = Preset.MeshTypes;
+	Building.Materials = Preset.Materials;
+	Building.FillBottom = Preset.FillBottom;
+	Building.BottomMaterial = Preset.BottomMaterial;
+	Building.FillTop = Preset.FillTop;
+	Building.TopMaterial = Preset.TopMaterial;
+	Building.TopSink = Preset.TopSink;
+	Building.OutputMode = Preset.OutputMode;
+
+	Building.Floors = Preset.Floors;
+	for (FFloorType& Floor : Building.Floors) {
+		const int PresetSections = Floor.Sections.Num();
+		for (int s = PresetSections; s < Segments && PresetSections > 0; ++s) {
+			// Copied first: Add may reallocate the array the section lives in
+			const FBuildingSection Section = Floor.Sections[s % PresetSections];
+			Floor.Sections.Add(Section);
+		}
+	}
+}
+
+bool UBuildingDistrictSubsystem::GetViewLocation(FVector& OutLocation) const
+{
+	const APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	if (PlayerController == nullptr || PlayerController->PlayerCameraManager == nullptr) {
+		return false;
+	}
+	OutLocation = PlayerController->PlayerCameraManager->GetCameraLocation();
+	return true;
+}
+
+void UBuildingDistrictSubsystem::FinishBuilding(ABuilding* Building)
+{
+	// Later edits to the building upload as usual
+	if (Building != nullptr) {
+		Building->SetUploadScheduled(false);
+	}
+	++Completed;
+}
@@ -0,0 +1,496 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingGeometry.h"
+#include <Components/SplineComponent.h>
+#include "Components/InstancedStaticMeshComponent.h"
+#include "PackedNormal.h"
+
+void TMesh::Append(const TMesh& Other)
+{
+	const int offset = vertices.Num();
+	vertices.Append(Other.vertices);
+	uvs.Append(Other.uvs);
+	normals.Append(Other.normals);
+	tangents.Append(Other.tangents);
+	tris.Reserve(tris.Num() + Other.tris.Num());
+	for (int32 index : Other.tris) {
+		tris.Add(offset + index);
+	}
+	triangleCount = vertices.Num();
+}
+
+int TMesh::Presize(int VertexCount, int IndexCount)
+{
+	const int Allocations = (vertices.Max() < VertexCount) + (uvs.Max() < VertexCount) + (normals.Max() < VertexCount)
+		+ (tangents.Max() < VertexCount) + (tris.Max() < IndexCount);
+
+	vertices.SetNumUninitialized(VertexCount, false);
+	uvs.SetNumUninitialized(VertexCount, false);
+	normals.SetNumUninitialized(VertexCount, false);
+	tangents.SetNumUninitialized(VertexCount, false);
+	tris.SetNumUninitialized(IndexCount, false);
+	triangleCount = VertexCount;
+
+	return Allocations;
+}
+
+int TMesh::CopyRaised(const TMesh& Other, float ZOffset)
+{
+	const int Allocations = Presize(Other.vertices.Num(), Other.tris.Num());
+
+	const FVector Offset(0.0f, 0.0f, ZOffset);
+	for (int i = 0; i < Other.vertices.Num(); ++i) {
+		vertices[i] = Other.vertices[i] + Offset;
+	}
+	FMemory::Memcpy(uvs.GetData(), Other.uvs.GetData(), Other.uvs.Num() * sizeof(FVector2D));
+	FMemory::Memcpy(normals.GetData(), Other.normals.GetData(), Other.normals.Num() * sizeof(FVector));
+	FMemory::Memcpy(tangents.GetData(), Other.tangents.GetData(), Other.tangents.Num() * sizeof(FProcMeshTangent));
+	FMemory::Memcpy(tris.GetData(), Other.tris.GetData(), Other.tris.Num() * sizeof(int32));
+
+	return Allocations;
+}
+
+void FBuildingArcLengthTable::Build(const USplineComponent& Spline, int Segments, int InSamplesPerSegment)
+{
+	SamplesPerSegment = FMath::Max(1, InSamplesPerSegment);
+
+	const int SampleCount = Segments * SamplesPerSegment + 1;
+	Distances.SetNumUninitialized(SampleCount, false);
+	Locations.SetNumUninitialized(SampleCount, false);
+
+	for (int i = 0; i < SampleCount; ++i) {
+		const float InputKey = static_cast<float>(i) / SamplesPerSegment;
+		Locations[i] = Spline.GetLocationAtSplineInputKey(InputKey, ESplineCoordinateSpace::Local);
+	}
+	BuildingCore::AccumulateDistances(BuildingCore::ToCore(Locations.GetData()), SampleCount, Distances.GetData());
+}
+
+BuildingCore::FArcLengthView FBuildingArcLengthTable::GetView() const
+{
+	BuildingCore::FArcLengthView View;
+	View.Locations = BuildingCore::ToCore(Locations.GetData());
+	View.Distances = Distances.GetData();
+	View.Num = Locations.Num();
+	View.SamplesPerSegment = SamplesPerSegment;
+	return View;
+}
+
+float FBuildingArcLengthTable::GetDistanceAtSplinePoint(int Point) const
+{
+	return GetView().GetDistanceAtPoint(Point);
+}
+
+FVector FBuildingArcLengthTable::GetLocationAtDistance(float Distance) const
+{
+	return BuildingCore::ToVector(GetView().GetLocationAtDistance(Distance));
+}
+
+void FBuildingParts::BuildViews()
+{
+	Views.clear();
+	Views.resize(Parts.Num());
+	for (int meshType = 0; meshType < Parts.Num(); ++meshType) {
+		BuildingCore::FPartView& View = Views[meshType];
+		View.Length = Lengths.IsValidIndex(meshType) ? Lengths[meshType] : 0.0f;
+		View.Height = Heights.IsValidIndex(meshType) ? Heights[meshType] : 0.0f;
+		View.bValid = Parts[meshType].IsValid();
+		if (!View.bValid) {
+			continue;
+		}
+
+		const TArray<FBuildingPartSection>& Sections = Parts[meshType]->Sections;
+		View.Sections.resize(Sections.Num());
+		for (int meshSectionIndex = 0; meshSectionIndex < Sections.Num(); ++meshSectionIndex) {
+			const FBuildingPartSection& Section = Sections[meshSectionIndex];
+			BuildingCore::FPartSectionView& SectionView = View.Sections[meshSectionIndex];
+			SectionView.Positions = BuildingCore::ToCore(Section.Positions.GetData());
+			SectionView.UVs = BuildingCore::ToCore(Section.UVs.GetData());
+			SectionView.TangentZ = BuildingCore::ToCore(Section.TangentZ.GetData());
+			SectionView.TangentX = BuildingCore::ToCore(Section.TangentX.GetData());
+			SectionView.NumVertices = Section.Positions.Num();
+			SectionView.Indices = Section.Indices.GetData();
+			SectionView.NumIndices = Section.Indices.Num();
+			SectionView.Slot = SectionSlots.IsValidIndex(meshType) && SectionSlots[meshType].IsValidIndex(meshSectionIndex)
+				? SectionSlots[meshType][meshSectionIndex] : INDEX_NONE;
+		}
+	}
+}
+
+int64 BuildingMemory::GetMergedBytes(int64 Vertices, int64 Indices)
+{
+	constexpr int64 GPUVertexSize = sizeof(FVector) + 2 * sizeof(FPackedNormal) + sizeof(FColor) + sizeof(FVector2D);
+	return Vertices * (sizeof(FProcMeshVertex) + GPUVertexSize) + Indices * 2 * sizeof(uint32);
+}
+
+int64 BuildingMemory::GetInstancedBytes(int64 Instances)
+{
+	// Transform, previous transform and lightmap/random data per instance on the GPU, plus the HISM sort index
+	constexpr int64 GPUInstanceSize = 2 * sizeof(FMatrix) + sizeof(FVector4);
+	return Instances * (sizeof(FInstancedStaticMeshInstanceData) + GPUInstanceSize + sizeof(int32));
+}
+
+void BuildingFill::SimplifyPolygon(TArray<FVector2D>& Polygon, float Tolerance)
+{
+	std::vector<BuildingCore::FVec2> Points(BuildingCore::ToCore(Polygon.GetData()), BuildingCore::ToCore(Polygon.GetData()) + Polygon.Num());
+	BuildingCore::SimplifyPolygon(Points, Tolerance);
+	Polygon.SetNumUninitialized(Points.size(), false);
+	FMemory::Memcpy(Polygon.GetData(), Points.data(), Points.size() * sizeof(FVector2D));
+}
+
+bool BuildingFill::TriangulatePolygon(const TArray<FVector2D>& Polygon, TArray<int32>& OutTriangles)
+{
+	std::vector<int32_t> Triangles;
+	const bool bResult = BuildingCore::TriangulatePolygon(BuildingCore::ToCore(Polygon.GetData()), Polygon.Num(), Triangles);
+	OutTriangles.SetNumUninitialized(Triangles.size(), false);
+	FMemory::Memcpy(OutTriangles.GetData(), Triangles.data(), Triangles.size() * sizeof(int32));
+	return bResult;
+}
+
+void BuildingFill::SubdividePolygon(TArray<FVector2D>& Points, TArray<int32>& Triangles, int Levels)
+{
+	std::vector<BuildingCore::FVec2> CorePoints(BuildingCore::ToCore(Points.GetData()), BuildingCore::ToCore(Points.GetData()) + Points.Num());
+	std::vector<int32_t> CoreTriangles(Triangles.GetData(), Triangles.GetData() + Triangles.Num());
+	BuildingCore::SubdividePolygon(CorePoints, CoreTriangles, Levels);
+
+	Points.SetNumUninitialized(CorePoints.size(), false);
+	FMemory::Memcpy(Points.GetData(), CorePoints.data(), CorePoints.size() * sizeof(FVector2D));
+	Triangles.SetNumUninitialized(CoreTriangles.size(), false);
+	FMemory::Memcpy(Triangles.GetData(), CoreTriangles.data(), CoreTriangles.size() * sizeof(int32));
+}
+
+void BuildingFill::ConvexHull(const TArray<FVector2D>& Points, TArray<FVector2D>& OutHull)
+{
+	std::vector<BuildingCore::FVec2> Hull;
+	BuildingCore::ConvexHull(BuildingCore::ToCore(Points.GetData()), Points.Num(), Hull);
+	OutHull.SetNumUninitialized(Hull.size(), false);
+	FMemory::Memcpy(OutHull.GetData(), Hull.data(), Hull.size() * sizeof(FVector2D));
+}
+
+BuildingOptimize::FStats& BuildingOptimize::FStats::operator+=(const FStats& Other)
+{
+	VerticesBefore += Other.VerticesBefore;
+	VerticesAfter += Other.VerticesAfter;
+	TrianglesBefore += Other.TrianglesBefore;
+	TrianglesAfter += Other.TrianglesAfter;
+	CacheMissesBefore += Other.CacheMissesBefore;
+	CacheMissesAfter += Other.CacheMissesAfter;
+	return *this;
+}
+
+void BuildingOptimize::Optimize(TMesh& Mesh, float WeldTolerance, FStats& Stats)
+{
+	Stats.VerticesBefore += Mesh.vertices.Num();
+	Stats.TrianglesBefore += Mesh.tris.Num() / 3;
+	Stats.CacheMissesBefore += CountCacheMisses(Mesh.tris);
+
+	WeldVertices(Mesh, WeldTolerance);
+	RemoveDegenerateTriangles(Mesh);
+	OptimizeTriangleOrder(Mesh.tris, Mesh.vertices.Num());
+	OptimizeVertexOrder(Mesh);
+
+	Stats.VerticesAfter += Mesh.vertices.Num();
+	Stats.TrianglesAfter += Mesh.tris.Num() / 3;
+	Stats.CacheMissesAfter += CountCacheMisses(Mesh.tris);
+}
+
+static bool AttributesMatch(const TMesh& Mesh, int32 A, int32 B)
+{
+	return Mesh.normals[A].Equals(Mesh.normals[B], 1e-3f)
+		&& Mesh.tangents[A].TangentX.Equals(Mesh.tangents[B].TangentX, 1e-3f)
+		&& Mesh.tangents[A].bFlipTangentY == Mesh.tangents[B].bFlipTangentY
+		&& Mesh.uvs[A].Equals(Mesh.uvs[B], 1e-4f);
+}
+
+int32 BuildingOptimize::WeldVertices(TMesh& Mesh, float Tolerance)
+{
+	const int32 Num = Mesh.vertices.Num();
+	if (Num == 0) {
+		return 0;
+	}
+
+	// Cells twice the tolerance wide: a match is in the vertex's own cell or the nearer neighbour on each axis
+	const float CellSize = FMath::Max(Tolerance, KINDA_SMALL_NUMBER) * 2.0f;
+	const float ToleranceSquared = FMath::Square(FMath::Max(Tolerance, KINDA_SMALL_NUMBER));
+	TMap<FIntVector, int32> CellHeads;
+	CellHeads.Reserve(Num);
+	TArray<int32> NextInCell;
+	NextInCell.Reserve(Num);
+	TArray<int32> Remap;
+	Remap.SetNumUninitialized(Num);
+
+	int32 Kept = 0;
+	for (int32 v = 0; v < Num; ++v) {
+		const FVector Scaled = Mesh.vertices[v] / CellSize;
+		const FIntVector Cell(FMath::FloorToInt(Scaled.X), FMath::FloorToInt(Scaled.Y), FMath::FloorToInt(Scaled.Z));
+		const FIntVector Toward(
+			Scaled.X - Cell.X < 0.5f ? -1 : 1,
+			Scaled.Y - Cell.Y < 0.5f ? -1 : 1,
+			Scaled.Z - Cell.Z < 0.5f ? -1 : 1);
+
+		int32 Match = INDEX_NONE;
+		for (int32 Corner = 0; Corner < 8 && Match == INDEX_NONE; ++Corner) {
+			const FIntVector Probe = Cell + FIntVector(
+				(Corner & 1) ? Toward.X : 0,
+				(Corner & 2) ? Toward.Y : 0,
+				(Corner & 4) ? Toward.Z : 0);
+			const int32* Head = CellHeads.Find(Probe);
+			for (int32 Candidate = Head != nullptr ? *Head : INDEX_NONE; Candidate != INDEX_NONE; Candidate = NextInCell[Candidate]) {
+				if (FVector::DistSquared(Mesh.vertices[Candidate], Mesh.vertices[v]) <= ToleranceSquared && AttributesMatch(Mesh, Candidate, v)) {
+					Match = Candidate;
+					break;
+				}
+			}
+		}
+
+		if (Match != INDEX_NONE) {
+			Remap[v] = Match;
+			continue;
+		}
+
+		// Kept vertices are compacted in place; Kept never overtakes v
+		Mesh.vertices[Kept] = Mesh.vertices[v];
+		Mesh.normals[Kept] = Mesh.normals[v];
+		Mesh.tangents[Kept] = Mesh.tangents[v];
+		Mesh.uvs[Kept] = Mesh.uvs[v];
+		int32& Head = CellHeads.FindOrAdd(Cell, INDEX_NONE);
+		NextInCell.Add(Head);
+		Head = Kept;
+		Remap[v] = Kept++;
+	}
+
+	for (int32& Index : Mesh.tris) {
+		Index = Remap[Index];
+	}
+	Mesh.vertices.SetNum(Kept, false);
+	Mesh.normals.SetNum(Kept, false);
+	Mesh.tangents.SetNum(Kept, false);
+	Mesh.uvs.SetNum(Kept, false);
+	Mesh.triangleCount = Kept;
+	return Num - Kept;
+}
+
+int32 BuildingOptimize::RemoveDegenerateTriangles(TMesh& Mesh)
+{
+	const int32 Num = Mesh.tris.Num();
+	int32 Kept = 0;
+	for (int32 i = 0; i + 2 < Num; i += 3) {
+		const int32 A = Mesh.tris[i];
+		const int32 B = Mesh.tris[i + 1];
+		const int32 C = Mesh.tris[i + 2];
+		if (A == B || B == C || C == A) {
+			continue;
+		}
+		const FVector Normal = FVector::CrossProduct(Mesh.vertices[B] - Mesh.vertices[A], Mesh.vertices[C] - Mesh.vertices[A]);
+		if (Normal.SizeSquared() <= SMALL_NUMBER) {
+			continue;
+		}
+		Mesh.tris[Kept++] = A;
+		Mesh.tris[Kept++] = B;
+		Mesh.tris[Kept++] = C;
+	}
+	Mesh.tris.SetNum(Kept, false);
+	return (Num - Kept) / 3;
+}
+
+namespace
+{
+	constexpr int32 ForsythCacheSize = 32;
+
+	float ForsythVertexScore(int32 CachePosition, int32 RemainingTriangles)
+	{
+		if (RemainingTriangles == 0) {
+			return -1.0f;
+		}
+
+		float Score = 0.0f;
+		if (CachePosition >= 0) {
+			// The last triangle's vertices score a fixed amount, so the next triangle does not just repeat its edge
+			Score = CachePosition < 3
+				? 0.75f
+				: FMath::Pow(1.0f - static_cast<float>(CachePosition - 3) / (ForsythCacheSize - 3), 1.5f);
+		}
+		// Favour vertices with few triangles left, to finish them off and free their cache slot
+		return Score + 2.0f * FMath::InvSqrt(static_cast<float>(RemainingTriangles));
+	}
+}
+
+void BuildingOptimize::OptimizeTriangleOrder(TArray<int32>& Indices, int32 VertexCount)
+{
+	const int32 TriangleCount = Indices.Num() / 3;
+	if (TriangleCount <= 1) {
+		return;
+	}
+
+	// Triangles of each vertex, packed; the first Remaining entries of a range are the ones not emitted yet
+	TArray<int32> Remaining;
+	TArray<int32> FirstTriangle;
+	TArray<int32> VertexTriangles;
+	Remaining.SetNumZeroed(VertexCount);
+	FirstTriangle.SetNumUninitialized(VertexCount + 1);
+	VertexTriangles.SetNumUninitialized(TriangleCount * 3);
+	for (int32 Index : Indices) {
+		++Remaining[Index];
+	}
+	FirstTriangle[0] = 0;
+	for (int32 v = 0; v < VertexCount; ++v) {
+		FirstTriangle[v + 1] = FirstTriangle[v] + Remaining[v];
+		Remaining[v] = 0;
+	}
+	for (int32 t = 0; t < TriangleCount; ++t) {
+		for (int32 Corner = 0; Corner < 3; ++Corner) {
+			const int32 v = Indices[t * 3 + Corner];
+			VertexTriangles[FirstTriangle[v] + Remaining[v]++] = t;
+		}
+	}
+
+	TArray<int32> CachePosition;
+	TArray<float> VertexScore;
+	CachePosition.Init(INDEX_NONE, VertexCount);
+	VertexScore.SetNumUninitialized(VertexCount);
+	for (int32 v = 0; v < VertexCount; ++v) {
+		VertexScore[v] = ForsythVertexScore(INDEX_NONE, Remaining[v]);
+	}
+
+	TArray<float> TriangleScore;
+	TBitArray<> Emitted(false, TriangleCount);
+	TriangleScore.SetNumUninitialized(TriangleCount);
+	for (int32 t = 0; t < TriangleCount; ++t) {
+		TriangleScore[t] = VertexScore[Indices[t * 3]] + VertexScore[Indices[t * 3 + 1]] + VertexScore[Indices[t * 3 + 2]];
+	}
+
+	TArray<int32> Output;
+	Output.Reserve(Indices.Num());
+	TArray<int32, TInlineAllocator<ForsythCacheSize + 3>> Cache;
+	TArray<int32, TInlineAllocator<ForsythCacheSize + 3>> NewCache;
+
+	int32 BestTriangle = INDEX_NONE;
+	int32 ScanStart = 0;
+	for (int32 Done = 0; Done < TriangleCount; ++Done) {
+		if (BestTriangle == INDEX_NONE) {
+			// Nothing in the cache has triangles left: start a new island from the best remaining triangle
+			float BestScore = -1.0f;
+			while (Emitted[ScanStart]) {
+				++ScanStart;
+			}
+			for (int32 t = ScanStart; t < TriangleCount; ++t) {
+				if (!Emitted[t] && TriangleScore[t] > BestScore) {
+					BestScore = TriangleScore[t];
+					BestTriangle = t;
+				}
+			}
+		}
+
+		const int32 Triangle = BestTriangle;
+		Emitted[Triangle] = true;
+		NewCache.Reset();
+		for (int32 Corner = 0; Corner < 3; ++Corner) {
+			const int32 v = Indices[Triangle * 3 + Corner];
+			Output.Add(v);
+			NewCache.Add(v);
+
+			// Move the triangle out of the vertex's remaining range
+			const int32 First = FirstTriangle[v];
+			const int32 Last = First + --Remaining[v];
+			for (int32 i = First; i <= Last; ++i) {
+				if (VertexTriangles[i] == Triangle) {
+					Swap(VertexTriangles[i], VertexTriangles[Last]);
+					break;
+				}
+			}
+		}
+		for (int32 v : Cache) {
+			if (!NewCache.Contains(v)) {
+				NewCache.Add(v);
+			}
+		}
+
+		// Rescore everything that was or is in the cache, then the triangles touching it
+		for (int32 i = 0; i < NewCache.Num(); ++i) {
+			const int32 v = NewCache[i];
+			CachePosition[v] = i < ForsythCacheSize ? i : INDEX_NONE;
+			VertexScore[v] = ForsythVertexScore(CachePosition[v], Remaining[v]);
+		}
+
+		BestTriangle = INDEX_NONE;
+		float BestScore = -1.0f;
+		for (int32 i = 0; i < NewCache.Num(); ++i) {
+			const int32 v = NewCache[i];
+			for (int32 j = FirstTriangle[v]; j < FirstTriangle[v] + Remaining[v]; ++j) {
+				const int32 t = VertexTriangles[j];
+				TriangleScore[t] = VertexScore[Indices[t * 3]] + VertexScore[Indices[t * 3 + 1]] + VertexScore[Indices[t * 3 + 2]];
+				if (TriangleScore[t] > BestScore) {
+					BestScore = TriangleScore[t];
+					BestTriangle = t;
+				}
+			}
+		}
+
+		if (NewCache.Num() > ForsythCacheSize) {
+			NewCache.SetNum(ForsythCacheSize, false);
+		}
+		Swap(Cache, NewCache);
+	}
+
+	Indices = MoveTemp(Output);
+}
+
+void BuildingOptimize::OptimizeVertexOrder(TMesh& Mesh)
+{
+	const int32 Num = Mesh.vertices.Num();
+	TArray<int32> Remap;
+	Remap.Init(INDEX_NONE, Num);
+
+	int32 Next = 0;
+	for (int32& Index : Mesh.tris) {
+		if (Remap[Index] == INDEX_NONE) {
+			Remap[Index] = Next++;
+		}
+		Index = Remap[Index];
+	}
+
+	TArray<FVector> Vertices;
+	TArray<FVector> Normals;
+	TArray<FProcMeshTangent> Tangents;
+	TArray<FVector2D> UVs;
+	Vertices.SetNumUninitialized(Next);
+	Normals.SetNumUninitialized(Next);
+	Tangents.SetNumUninitialized(Next);
+	UVs.SetNumUninitialized(Next);
+	for (int32 v = 0; v < Num; ++v) {
+		const int32 To = Remap[v];
+		if (To != INDEX_NONE) {
+			Vertices[To] = Mesh.vertices[v];
+			Normals[To] = Mesh.normals[v];
+			Tangents[To] = Mesh.tangents[v];
+			UVs[To] = Mesh.uvs[v];
+		}
+	}
+
+	// Copy back rather than swap, so the mesh keeps its warmed-up buffers
+	Mesh.vertices.SetNumUninitialized(Next, false);
+	Mesh.normals.SetNumUninitialized(Next, false);
+	Mesh.tangents.SetNumUninitialized(Next, false);
+	Mesh.uvs.SetNumUninitialized(Next, false);
+	FMemory::Memcpy(Mesh.vertices.GetData(), Vertices.GetData(), Next * sizeof(FVector));
+	FMemory::Memcpy(Mesh.normals.GetData(), Normals.GetData(), Next * sizeof(FVector));
+	FMemory::Memcpy(Mesh.tangents.GetData(), Tangents.GetData(), Next * sizeof(FProcMeshTangent));
+	FMemory::Memcpy(Mesh.uvs.GetData(), UVs.GetData(), Next * sizeof(FVector2D));
+	Mesh.triangleCount = Next;
+}
+
+int32 BuildingOptimize::CountCacheMisses(const TArray<int32>& Indices, int32 CacheSize)
+{
+	TArray<int32, TInlineAllocator<32>> Fifo;
+	Fifo.Init(INDEX_NONE, CacheSize);
+	int32 Head = 0;
+	int32 Misses = 0;
+	for (int32 Index : Indices) {
+		if (!Fifo.Contains(Index)) {
+			Fifo[Head] = Index;
+			Head = (Head + 1) % CacheSize;
+			++Misses;
+		}
+	}
+	return Misses;
+}
@@ -0,0 +1,230 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingGeometryCache.h"
+#include "ProceduralMeshComponent.h"
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Async/MappedFileHandle.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/IConsoleManager.h"
+
+const uint32 FBuildingGeometryCache::FormatVersion = 1;
+
+static TAutoConsoleVariable<int32> CVarGeometryCacheMaxMB(
+	TEXT("Building.GeometryCacheMaxMB"),
+	512,
+	TEXT("Size limit of Saved/BuildingCache in megabytes; the least recently used files beyond it are deleted after each save."));
+
+namespace {
+	constexpr uint32 Magic = 0x4f454742; // "BGEO"
+
+	struct FFileHeader {
+		uint32 Magic;
+		uint32 Version;
+		uint32 VertexSize;
+		uint32 SectionCount;
+	};
+
+	struct FSectionHeader {
+		int32 NumVertices;
+		int32 NumIndices;
+		FVector BoundsMin;
+		FVector BoundsMax;
+		uint32 bBoundsValid;
+	};
+
+	template <typename T>
+	void Write(TArray<uint8>& Data, const T* Values, int64 Num)
+	{
+		const int64 Offset = Data.Num();
+		Data.AddUninitialized(Num * sizeof(T));
+		FMemory::Memcpy(Data.GetData() + Offset, Values, Num * sizeof(T));
+	}
+
+	bool Read(const uint8* Data, int64 Size, UProceduralMeshComponent& Mesh, int SectionCount, const TBitArray<>& CollisionSections)
+	{
+		const uint8* Cursor = Data;
+		const uint8* End = Data + Size;
+		const auto Take = [&Cursor, End](int64 Bytes) -> const uint8* {
+			if (Bytes < 0 || End - Cursor < Bytes) {
+				return nullptr;
+			}
+			const uint8* Result = Cursor;
+			Cursor += Bytes;
+			return Result;
+		};
+
+		const FFileHeader* Header = reinterpret_cast<const FFileHeader*>(Take(sizeof(FFileHeader)));
+		if (Header == nullptr
+			|| Header->Magic != Magic
+			|| Header->Version != FBuildingGeometryCache::FormatVersion
+			|| Header->VertexSize != sizeof(FProcMeshVertex)
+			|| Header->SectionCount != static_cast<uint32>(SectionCount)) {
+			return false;
+		}
+
+		TArray<FProcMeshSection> Sections;
+		Sections.SetNum(SectionCount);
+		for (int SectionIndex = 0; SectionIndex < SectionCount; ++SectionIndex) {
+			FProcMeshSection& Section = Sections[SectionIndex];
+			FSectionHeader SectionHeader;
+			const uint8* HeaderData = Take(sizeof(FSectionHeader));
+			if (HeaderData == nullptr) {
+				return false;
+			}
+			FMemory::Memcpy(&SectionHeader, HeaderData, sizeof(FSectionHeader));
+
+			const uint8* Vertices = Take(int64(SectionHeader.NumVertices) * sizeof(FProcMeshVertex));
+			const uint8* Indices = Take(int64(SectionHeader.NumIndices) * sizeof(uint32));
+			if (Vertices == nullptr || Indices == nullptr) {
+				return false;
+			}
+
+			Section.ProcVertexBuffer.SetNumUninitialized(SectionHeader.NumVertices);
+			FMemory::Memcpy(Section.ProcVertexBuffer.GetData(), Vertices, SectionHeader.NumVertices * sizeof(FProcMeshVertex));
+			Section.ProcIndexBuffer.SetNumUninitialized(SectionHeader.NumIndices);
+			FMemory::Memcpy(Section.ProcIndexBuffer.GetData(), Indices, SectionHeader.NumIndices * sizeof(uint32));
+			Section.SectionLocalBox = FBox(SectionHeader.BoundsMin, SectionHeader.BoundsMax);
+			Section.SectionLocalBox.IsValid = SectionHeader.bBoundsValid;
+			Section.bEnableCollision = CollisionSections.IsValidIndex(SectionIndex) && CollisionSections[SectionIndex];
+		}
+
+		Mesh.ClearAllMeshSections();
+		for (int i = 0; i < Sections.Num(); ++i) {
+			Mesh.SetProcMeshSection(i, Sections[i]);
+		}
+		return true;
+	}
+}
+
+FThreadSafeCounter FBuildingGeometryCache::PendingWrites;
+FThreadSafeCounter FBuildingGeometryCache::Trimming;
+
+FString FBuildingGeometryCache::GetDirectory()
+{
+	return FPaths::ProjectSavedDir() / TEXT("BuildingCache");
+}
+
+FString FBuildingGeometryCache::GetPath(const FSHAHash& Key)
+{
+	return GetDirectory() / Key.ToString() + TEXT(".bgeo");
+}
+
+bool FBuildingGeometryCache::Load(const FSHAHash& Key, UProceduralMeshComponent& Mesh, int SectionCount, const TBitArray<>& CollisionSections)
+{
+	const FString Path = GetPath(Key);
+	bool bLoaded = false;
+	bool bMapped = false;
+	{
+		TUniquePtr<IMappedFileHandle> Handle(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*Path));
+		if (Handle.IsValid()) {
+			TUniquePtr<IMappedFileRegion> Region(Handle->MapRegion(0, Handle->GetFileSize()));
+			if (Region.IsValid()) {
+				bMapped = true;
+				bLoaded = Read(Region->GetMappedPtr(), Region->GetMappedSize(), Mesh, SectionCount, CollisionSections);
+			}
+		}
+	}
+
+	// Platforms without mapped files read it instead
+	if (!bMapped) {
+		TArray<uint8> Data;
+		bLoaded = FFileHelper::LoadFileToArray(Data, *Path, FILEREAD_Silent) && Read(Data.GetData(), Data.Num(), Mesh, SectionCount, CollisionSections);
+	}
+
+	// Trim goes by the modification time, so a hit keeps the file from being evicted; the mapping is closed by now
+	if (bLoaded) {
+		IFileManager::Get().SetTimeStamp(*Path, FDateTime::UtcNow());
+	}
+	return bLoaded;
+}
+
+void FBuildingGeometryCache::Save(const FSHAHash& Key, UProceduralMeshComponent& Mesh, int SectionCount)
+{
+	TArray<uint8> Data;
+	const FFileHeader Header = { Magic, FormatVersion, sizeof(FProcMeshVertex), static_cast<uint32>(SectionCount) };
+	Write(Data, &Header, 1);
+
+	for (int i = 0; i < SectionCount; ++i) {
+		static const FProcMeshSection EmptySection;
+		const FProcMeshSection* Section = Mesh.GetProcMeshSection(i);
+		if (Section == nullptr) {
+			Section = &EmptySection;
+		}
+
+		FSectionHeader SectionHeader;
+		FMemory::Memzero(SectionHeader);
+		SectionHeader.NumVertices = Section->ProcVertexBuffer.Num();
+		SectionHeader.NumIndices = Section->ProcIndexBuffer.Num();
+		SectionHeader.BoundsMin = Section->SectionLocalBox.Min;
+		SectionHeader.BoundsMax = Section->SectionLocalBox.Max;
+		SectionHeader.bBoundsValid = Section->SectionLocalBox.IsValid;
+		Write(Data, &SectionHeader, 1);
+		Write(Data, Section->ProcVertexBuffer.GetData(), Section->ProcVertexBuffer.Num());
+		Write(Data, Section->ProcIndexBuffer.GetData(), Section->ProcIndexBuffer.Num());
+	}
+
+	PendingWrites.Increment();
+	Async(EAsyncExecution::ThreadPool, [Path = GetPath(Key), Data = MoveTemp(Data), MaxSize = GetMaxSize()]() {
+		// Write next to the final file and move it into place, so a reader never sees half a file
+		const FString TempPath = Path + TEXT(".") + FGuid::NewGuid().ToString() + TEXT(".tmp");
+		if (FFileHelper::SaveArrayToFile(Data, *TempPath)) {
+			IFileManager::Get().Move(*Path, *TempPath, true, true);
+		}
+		if (Trimming.Set(1) == 0) {
+			Trim(MaxSize);
+			Trimming.Set(0);
+		}
+		PendingWrites.Decrement();
+	});
+}
+
+int32 FBuildingGeometryCache::Trim(int64 MaxBytes)
+{
+	struct FCachedFile {
+		FString Path;
+		FDateTime Time;
+		int64 Size;
+	};
+	TArray<FCachedFile> Files;
+	int64 TotalSize = 0;
+	IFileManager::Get().IterateDirectoryStat(*GetDirectory(), [&Files, &TotalSize](const TCHAR* Path, const FFileStatData& Stat) {
+		if (!Stat.bIsDirectory && FPaths::GetExtension(Path) == TEXT("bgeo")) {
+			Files.Add({ Path, Stat.ModificationTime, Stat.FileSize });
+			TotalSize += Stat.FileSize;
+		}
+		return true;
+	});
+	if (TotalSize <= MaxBytes) {
+		return 0;
+	}
+
+	Files.Sort([](const FCachedFile& A, const FCachedFile& B) { return A.Time < B.Time; });
+	int32 Deleted = 0;
+	for (const FCachedFile& File : Files) {
+		if (TotalSize <= MaxBytes) {
+			break;
+		}
+		if (IFileManager::Get().Delete(*File.Path, false, false, true)) {
+			TotalSize -= File.Size;
+			++Deleted;
+		}
+	}
+	UE_LOG(LogTemp, Verbose, TEXT("Building geometry cache: evicted %d files, %lld bytes left"), Deleted, TotalSize);
+	return Deleted;
+}
+
+int64 FBuildingGeometryCache::GetMaxSize()
+{
+	return FMath::Max(0, CVarGeometryCacheMaxMB.GetValueOnAnyThread()) * int64(1024 * 1024);
+}
+
+void FBuildingGeometryCache::Flush()
+{
+	while (PendingWrites.GetValue() > 0) {
+		FPlatformProcess::Sleep(0.001f);
+	}
+}
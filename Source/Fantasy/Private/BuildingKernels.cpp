@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingKernels.h"
+#include "BuildingGeometry.h"
+#include "BuildingCoreKernels.h"
+#include "HAL/IConsoleManager.h"
+
+void BuildingKernels::TransformPositions(const FMatrix& Matrix, const FVector* In, FVector* Out, int32 Num)
+{
+	BuildingCore::TransformPositions(BuildingCore::ToCore(Matrix), BuildingCore::ToCore(In), BuildingCore::ToCore(Out), Num);
+}
+
+void BuildingKernels::TransformVectors(const FMatrix& Matrix, const FVector* In, FVector* Out, int32 Num)
+{
+	BuildingCore::TransformVectors(BuildingCore::ToCore(Matrix), BuildingCore::ToCore(In), BuildingCore::ToCore(Out), Num);
+}
+
+void BuildingKernels::TransformTangents(const FMatrix& Matrix, const FVector* In, FProcMeshTangent* Out, int32 Num)
+{
+	BuildingCore::TransformTangents(BuildingCore::ToCore(Matrix), BuildingCore::ToCore(In), BuildingCore::ToCore(Out), Num);
+}
+
+// Compares the kernels against the per-vertex FTransform path they replaced
+static FAutoConsoleCommand BenchmarkTransformCommand(
+	TEXT("Building.BenchmarkTransform"),
+	TEXT("Times the batch vertex kernels against scalar FTransform on a synthetic stream. Usage: Building.BenchmarkTransform [NumVertices=1000000]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args) {
+		const int32 Num = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000000;
+		if (Num <= 0) {
+			return;
+		}
+
+		FRandomStream Random(1234);
+		TArray<FVector> Positions, TangentZ, TangentX;
+		Positions.SetNumUninitialized(Num);
+		TangentZ.SetNumUninitialized(Num);
+		TangentX.SetNumUninitialized(Num);
+		for (int32 i = 0; i < Num; ++i) {
+			Positions[i] = Random.GetUnitVector() * 250.0f;
+			TangentZ[i] = Random.GetUnitVector();
+			TangentX[i] = Random.GetUnitVector();
+		}
+
+		const FRotator Rotation(0.0f, 37.0f, 0.0f);
+		const FVector Scale(1.2f, 1.0f, 0.9f);
+		const FVector Translation(100.0f, -50.0f, 300.0f);
+		const FTransform transform(Rotation, Translation, Scale);
+		const FTransform normalTransform(Rotation, FVector::ZeroVector, FVector::OneVector);
+
+		TArray<FVector> OutPositions, OutNormals;
+		TArray<FProcMeshTangent> OutTangents;
+		OutPositions.SetNumUninitialized(Num);
+		OutNormals.SetNumUninitialized(Num);
+		OutTangents.SetNumUninitialized(Num);
+
+		double Start = FPlatformTime::Seconds();
+		for (int32 i = 0; i < Num; ++i) {
+			OutPositions[i] = transform.TransformPosition(Positions[i]);
+			OutNormals[i] = normalTransform.TransformVector(TangentZ[i]);
+			OutTangents[i] = FProcMeshTangent(normalTransform.TransformVector(TangentX[i]), false);
+		}
+		const double ScalarTime = FPlatformTime::Seconds() - Start;
+		const FVector ScalarCheck = OutPositions[Num - 1];
+
+		Start = FPlatformTime::Seconds();
+		BuildingKernels::TransformPositions(transform.ToMatrixWithScale(), Positions.GetData(), OutPositions.GetData(), Num);
+		BuildingKernels::TransformVectors(normalTransform.ToMatrixNoScale(), TangentZ.GetData(), OutNormals.GetData(), Num);
+		BuildingKernels::TransformTangents(normalTransform.ToMatrixNoScale(), TangentX.GetData(), OutTangents.GetData(), Num);
+		const double KernelTime = FPlatformTime::Seconds() - Start;
+
+		UE_LOG(LogTemp, Display, TEXT("Building.BenchmarkTransform: %d vertices, scalar %.2f ms, batch %.2f ms (%.2fx), error %f"),
+			Num, ScalarTime * 1000.0, KernelTime * 1000.0, ScalarTime / FMath::Max(KernelTime, 1e-9),
+			(ScalarCheck - OutPositions[Num - 1]).GetAbsMax());
+	}));
@@ -0,0 +1,132 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingPartCache.h"
+#include "Engine/StaticMesh.h"
+#include "StaticMeshResources.h"
+
+FBuildingPartCache& FBuildingPartCache::Get()
+{
+	static FBuildingPartCache Cache;
+	return Cache;
+}
+
+FBuildingPartCache::FBuildingPartCache()
+{
+#if WITH_EDITOR
+	// Reimporting or rebuilding a mesh ends in PostEditChange
+	PropertyChangedHandle = FCoreUObjectDelegates::OnObjectPropertyChanged.AddRaw(this, &FBuildingPartCache::OnObjectPropertyChanged);
+#endif
+}
+
+FBuildingPartCache::~FBuildingPartCache()
+{
+#if WITH_EDITOR
+	FCoreUObjectDelegates::OnObjectPropertyChanged.Remove(PropertyChangedHandle);
+#endif
+}
+
+FBuildingPartPtr FBuildingPartCache::Find(const UStaticMesh* StaticMesh, int32 LODIndex)
+{
+	if (StaticMesh == nullptr) {
+		return nullptr;
+	}
+
+	FScopeLock ScopeLock(&Lock);
+
+	const FEntry* Registered = Entries.Find(StaticMesh);
+	if (Registered != nullptr && Registered->bRegistered) {
+		return Registered->LODs[0];
+	}
+	const FStaticMeshRenderData* RenderData = StaticMesh->GetRenderData();
+	if (RenderData == nullptr || RenderData->LODResources.Num() == 0) {
+		return nullptr;
+	}
+	LODIndex = FMath::Clamp(LODIndex, 0, RenderData->LODResources.Num() - 1);
+
+	FEntry& Entry = Entries.FindOrAdd(StaticMesh);
+	if (Entry.RenderData != RenderData) {
+		Entry.RenderData = RenderData;
+		Entry.LODs.Reset();
+	}
+	if (Entry.LODs.Num() <= LODIndex) {
+		Entry.LODs.SetNum(LODIndex + 1);
+	}
+	if (!Entry.LODs[LODIndex].IsValid()) {
+		Entry.LODs[LODIndex] = Extract(StaticMesh, LODIndex);
+	}
+	return Entry.LODs[LODIndex];
+}
+
+void FBuildingPartCache::Register(const UStaticMesh* StaticMesh, FBuildingPartPtr Part)
+{
+	FScopeLock ScopeLock(&Lock);
+	FEntry& Entry = Entries.FindOrAdd(StaticMesh);
+	Entry.RenderData = nullptr;
+	Entry.LODs = { Part };
+	Entry.bRegistered = true;
+}
+
+void FBuildingPartCache::Invalidate(const UStaticMesh* StaticMesh)
+{
+	FScopeLock ScopeLock(&Lock);
+	Entries.Remove(StaticMesh);
+}
+
+void FBuildingPartCache::Empty()
+{
+	FScopeLock ScopeLock(&Lock);
+	Entries.Empty();
+}
+
+FBuildingPartPtr FBuildingPartCache::Extract(const UStaticMesh* StaticMesh, int32 LODIndex)
+{
+	TSharedPtr<FBuildingPart, ESPMode::ThreadSafe> Part = MakeShared<FBuildingPart, ESPMode::ThreadSafe>();
+
+	const auto& LODResource = StaticMesh->GetRenderData()->LODResources[LODIndex];
+	const auto& PositionBuffer = LODResource.VertexBuffers.PositionVertexBuffer;
+	const auto& VertexBuffer = LODResource.VertexBuffers.StaticMeshVertexBuffer;
+
+	Part->Sections.SetNum(LODResource.Sections.Num());
+	for (int meshSectionIndex = 0; meshSectionIndex < LODResource.Sections.Num(); ++meshSectionIndex) {
+		const auto& meshSection = LODResource.Sections[meshSectionIndex];
+		FBuildingPartSection& Section = Part->Sections[meshSectionIndex];
+		Section.Material = StaticMesh->GetMaterial(meshSection.MaterialIndex);
+
+		const int vertexCount = meshSection.NumTriangles > 0 ? meshSection.MaxVertexIndex - meshSection.MinVertexIndex + 1 : 0;
+		Section.Positions.SetNumUninitialized(vertexCount);
+		Section.UVs.SetNumUninitialized(vertexCount);
+		Section.TangentZ.SetNumUninitialized(vertexCount);
+		Section.TangentX.SetNumUninitialized(vertexCount);
+		for (int v = 0; v < vertexCount; ++v) {
+			const uint32 index = meshSection.MinVertexIndex + v;
+			Section.Positions[v] = PositionBuffer.VertexPosition(index);
+			Section.UVs[v] = VertexBuffer.GetVertexUV(index, 0);
+			Section.TangentZ[v] = VertexBuffer.VertexTangentZ(index);
+			Section.TangentX[v] = VertexBuffer.VertexTangentX(index);
+		}
+
+		Section.Indices.SetNumUninitialized(meshSection.NumTriangles * 3);
+		for (int i = 0; i < Section.Indices.Num(); ++i) {
+			Section.Indices[i] = LODResource.IndexBuffer.GetIndex(meshSection.FirstIndex + i) - meshSection.MinVertexIndex;
+		}
+
+		Part->Version = FCrc::MemCrc32(Section.Positions.GetData(), Section.Positions.Num() * sizeof(FVector), Part->Version);
+		Part->Version = FCrc::MemCrc32(Section.UVs.GetData(), Section.UVs.Num() * sizeof(FVector2D), Part->Version);
+		Part->Version = FCrc::MemCrc32(Section.TangentZ.GetData(), Section.TangentZ.Num() * sizeof(FVector), Part->Version);
+		Part->Version = FCrc::MemCrc32(Section.TangentX.GetData(), Section.TangentX.Num() * sizeof(FVector), Part->Version);
+		Part->Version = FCrc::MemCrc32(Section.Indices.GetData(), Section.Indices.Num() * sizeof(int32), Part->Version);
+		Part->Version = HashCombine(Part->Version, GetTypeHash(GetPathNameSafe(Section.Material)));
+	}
+
+	return Part;
+}
+
+#if WITH_EDITOR
+void FBuildingPartCache::OnObjectPropertyChanged(UObject* Object, FPropertyChangedEvent& Event)
+{
+	if (const UStaticMesh* StaticMesh = Cast<UStaticMesh>(Object)) {
+		Invalidate(StaticMesh);
+	}
+}
+#endif
@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingStats.h"
+#include "Building.h"
+#include "EngineUtils.h"
+#include "Engine/World.h"
+
+DEFINE_STAT(STAT_BuildingCreateMesh);
+DEFINE_STAT(STAT_BuildingLayout);
+DEFINE_STAT(STAT_BuildingEmit);
+DEFINE_STAT(STAT_BuildingRepeat);
+DEFINE_STAT(STAT_BuildingCover);
+DEFINE_STAT(STAT_BuildingAssemble);
+DEFINE_STAT(STAT_BuildingFillClassify);
+DEFINE_STAT(STAT_BuildingFillTriangulate);
+DEFINE_STAT(STAT_BuildingUpload);
+DEFINE_STAT(STAT_BuildingLODUpload);
+
+DEFINE_STAT(STAT_BuildingCount);
+DEFINE_STAT(STAT_BuildingVertices);
+DEFINE_STAT(STAT_BuildingTriangles);
+DEFINE_STAT(STAT_BuildingDrawCalls);
+DEFINE_STAT(STAT_BuildingMemory);
+
+static FAutoConsoleCommandWithWorldAndArgs DumpTopCommand(
+	TEXT("Building.DumpTop"),
+	TEXT("Lists the buildings in the world with the most expensive last rebuild. Usage: Building.DumpTop [N=10]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World) {
+		if (World == nullptr) {
+			return;
+		}
+		const int32 Count = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 10;
+
+		TArray<ABuilding*> Buildings;
+		for (TActorIterator<ABuilding> It(World); It; ++It) {
+			Buildings.Add(*It);
+		}
+		Buildings.Sort([](const ABuilding& A, const ABuilding& B) {
+			return A.GetTimings().GetTotal() > B.GetTimings().GetTotal();
+		});
+
+		UE_LOG(LogTemp, Display, TEXT("Building.DumpTop: %d of %d buildings"), FMath::Min(Count, Buildings.Num()), Buildings.Num());
+		for (int32 i = 0; i < Buildings.Num() && i < Count; ++i) {
+			const ABuilding& Building = *Buildings[i];
+			const FBuildingTimings& Timings = Building.GetTimings();
+			UE_LOG(LogTemp, Display, TEXT("%2d. %s: %.2f ms (parts %.2f, layout %.2f, generate %.2f, upload %.2f, fill %.2f), %d vertices, %d triangles, %d draw calls, %.1f KB"),
+				i + 1, *Building.GetName(), Timings.GetTotal() * 1000.0,
+				Timings.Parts * 1000.0, Timings.Layout * 1000.0, Timings.Generate * 1000.0, Timings.Upload * 1000.0, Timings.Fill * 1000.0,
+				Building.VertexCount, Building.TriangleCount, Building.DrawCalls, Building.GetCountedBytes() / 1024.0);
+		}
+	}));
@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoverPointSubsystem.h"
+#include "EnemyStats.h"
+#include "Building.h"
+
+void UCoverPointSubsystem::RegisterBuilding(const ABuilding* Building, const TArray<FCoverPoint>& InPoints)
+{
+	if (Building == nullptr) {
+		return;
+	}
+	Buildings.Add(Building, InPoints);
+	bGridDirty = true;
+}
+
+void UCoverPointSubsystem::UnregisterBuilding(const ABuilding* Building)
+{
+	if (Buildings.Remove(Building) > 0) {
+		bGridDirty = true;
+	}
+}
+
+int32 UCoverPointSubsystem::FindCoverPoints(const FVector& Origin, float Radius, ECoverHeight MinHeight, bool bIncludeDoors, TArray<FCoverPoint>& OutPoints)
+{
+	return Gather(Origin, Radius, MinHeight, bIncludeDoors, nullptr, OutPoints);
+}
+
+int32 UCoverPointSubsystem::FindCoverPointsFrom(const FVector& Threat, const FVector& Origin, float Radius, ECoverHeight MinHeight, bool bIncludeDoors, TArray<FCoverPoint>& OutPoints)
+{
+	return Gather(Origin, Radius, MinHeight, bIncludeDoors, &Threat, OutPoints);
+}
+
+FIntPoint UCoverPointSubsystem::GetCell(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+}
+
+void UCoverPointSubsystem::BuildGrid()
+{
+	FANTASY_SCOPE(STAT_CoverGrid);
+
+	Points.Reset();
+	Grid.Reset();
+	for (TMap<TWeakObjectPtr<const ABuilding>, TArray<FCoverPoint>>::TIterator It = Buildings.CreateIterator(); It; ++It) {
+		if (!It->Key.IsValid()) {
+			It.RemoveCurrent();
+			continue;
+		}
+		for (const FCoverPoint& Point : It->Value) {
+			Grid.FindOrAdd(GetCell(Point.Location)).Add(Points.Add(Point));
+		}
+	}
+	PointCount = Points.Num();
+	bGridDirty = false;
+}
+
+int32 UCoverPointSubsystem::Gather(const FVector& Origin, float Radius, ECoverHeight MinHeight, bool bIncludeDoors, const FVector* Threat, TArray<FCoverPoint>& OutPoints)
+{
+	if (bGridDirty) {
+		BuildGrid();
+	}
+	FANTASY_SCOPE(STAT_CoverQuery);
+
+	OutPoints.Reset();
+	const FIntPoint Min = GetCell(Origin - FVector(Radius));
+	const FIntPoint Max = GetCell(Origin + FVector(Radius));
+	const float RadiusSquared = FMath::Square(Radius);
+	for (int32 X = Min.X; X <= Max.X; ++X) {
+		for (int32 Y = Min.Y; Y <= Max.Y; ++Y) {
+			const TArray<int32>* Cell = Grid.Find(FIntPoint(X, Y));
+			if (Cell == nullptr) {
+				continue;
+			}
+			for (const int32 Index : *Cell) {
+				const FCoverPoint& Point = Points[Index];
+				const bool bKind = Point.bDoor ? bIncludeDoors : Point.Height >= MinHeight;
+				if (bKind && FVector::DistSquared(Point.Location, Origin) <= RadiusSquared && (Threat == nullptr || Point.IsCoveredFrom(*Threat))) {
+					OutPoints.Add(Point);
+				}
+			}
+		}
+	}
+	return OutPoints.Num();
+}
@@ -0,0 +1,27 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EnemyStats.h"
+
+DEFINE_STAT(STAT_EnemySignificance);
+DEFINE_STAT(STAT_EnemyVision);
+DEFINE_STAT(STAT_TargetingGrid);
+DEFINE_STAT(STAT_TargetingQuery);
+DEFINE_STAT(STAT_CoverGrid);
+DEFINE_STAT(STAT_CoverQuery);
+DEFINE_STAT(STAT_FightDirector);
+
+DEFINE_STAT(STAT_EnemySignificanceHigh);
+DEFINE_STAT(STAT_EnemySignificanceMedium);
+DEFINE_STAT(STAT_EnemySignificanceLow);
+DEFINE_STAT(STAT_EnemySignificanceDormant);
+DEFINE_STAT(STAT_EnemyTicksSkipped);
+DEFINE_STAT(STAT_EnemyMsSaved);
+DEFINE_STAT(STAT_EnemyVisionPairs);
+DEFINE_STAT(STAT_EnemyVisionTraces);
+DEFINE_STAT(STAT_EnemyListenerUpdates);
+DEFINE_STAT(STAT_TargetingQueries);
+DEFINE_STAT(STAT_TargetingCacheHits);
+DEFINE_STAT(STAT_TargetingCandidates);
+DEFINE_STAT(STAT_FightAttackers);
+DEFINE_STAT(STAT_FightTokensHeld);
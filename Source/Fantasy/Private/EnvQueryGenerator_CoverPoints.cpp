@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EnvQueryGenerator_CoverPoints.h"
+#include "EnvironmentQuery/Contexts/EnvQueryContext_Querier.h"
+#include "Engine/World.h"
+
+#define LOCTEXT_NAMESPACE "EnvQueryGenerator"
+
+UEnvQueryGenerator_CoverPoints::UEnvQueryGenerator_CoverPoints()
+{
+	GenerateAround = UEnvQueryContext_Querier::StaticClass();
+	SearchRadius.DefaultValue = 1500.0f;
+}
+
+void UEnvQueryGenerator_CoverPoints::GenerateItems(FEnvQueryInstance& QueryInstance) const
+{
+	UObject* BindOwner = QueryInstance.Owner.Get();
+	UWorld* World = GetWorld();
+	UCoverPointSubsystem* Cover = World != nullptr ? World->GetSubsystem<UCoverPointSubsystem>() : nullptr;
+	if (BindOwner == nullptr || Cover == nullptr) {
+		return;
+	}
+
+	SearchRadius.BindData(BindOwner, QueryInstance.QueryID);
+	const float Radius = SearchRadius.GetValue();
+
+	TArray<FVector> Origins;
+	QueryInstance.PrepareContext(GenerateAround, Origins);
+	TArray<FVector> Threats;
+	if (Threat) {
+		QueryInstance.PrepareContext(Threat, Threats);
+	}
+
+	TArray<FNavLocation> Items;
+	TArray<FCoverPoint> Found;
+	// Search radii of several origins overlap; a point found from more than one is still one item
+	TSet<FVector> Added;
+	for (const FVector& Origin : Origins) {
+		Cover->FindCoverPoints(Origin, Radius, MinHeight, bIncludeDoors, Found);
+		for (const FCoverPoint& Point : Found) {
+			const bool bCovered = !Threats.ContainsByPredicate([&Point](const FVector& Location) { return !Point.IsCoveredFrom(Location); });
+			if (!bCovered) {
+				continue;
+			}
+			bool bAlreadyAdded = false;
+			if (Origins.Num() > 1) {
+				Added.Add(Point.Location, &bAlreadyAdded);
+			}
+			if (!bAlreadyAdded) {
+				Items.Add(FNavLocation(Point.Location));
+			}
+		}
+	}
+
+	ProjectAndFilterNavPoints(Items, QueryInstance);
+	StoreNavPoints(Items, QueryInstance);
+}
+
+FText UEnvQueryGenerator_CoverPoints::GetDescriptionTitle() const
+{
+	return FText::Format(LOCTEXT("CoverPointsDescriptionGenerateAroundContext", "{0}: around {1}"),
+		Super::GetDescriptionTitle(), UEnvQueryTypes::DescribeContext(GenerateAround));
+}
+
+FText UEnvQueryGenerator_CoverPoints::GetDescriptionDetails() const
+{
+	FText Desc = FText::Format(LOCTEXT("CoverPointsDescription", "radius: {0}"), FText::FromString(SearchRadius.ToString()));
+	if (Threat) {
+		Desc = FText::Format(LOCTEXT("CoverPointsThreatDescription", "{0}, covered from {1}"), Desc, UEnvQueryTypes::DescribeContext(Threat));
+	}
+
+	const FText ProjDesc = ProjectionData.ToText(FEnvTraceData::Brief);
+	if (!ProjDesc.IsEmpty()) {
+		Desc = FText::Format(LOCTEXT("CoverPointsDescriptionWithProjection", "{0}, {1}"), Desc, ProjDesc);
+	}
+	return Desc;
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,220 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FightDirectorSubsystem.h"
+#include "EnemyStats.h"
+#include "CBaseEnemy_Controller.h"
+#include "AIController.h"
+#include "BehaviorTree/BlackboardComponent.h"
+#include "Engine/World.h"
+
+void UFightDirectorSubsystem::RegisterAttacker(AAIController* Controller, float Priority)
+{
+	if (Controller == nullptr) {
+		return;
+	}
+	if (FAttacker* Existing = FindAttacker(Controller)) {
+		Existing->Priority = Priority;
+		return;
+	}
+
+	AttackerIndices.Add(FObjectKey(Controller), Attackers.Num());
+	FAttacker& Attacker = Attackers.AddDefaulted_GetRef();
+	Attacker.Controller = Controller;
+	Attacker.Key = FObjectKey(Controller);
+	Attacker.Priority = Priority;
+}
+
+void UFightDirectorSubsystem::UnregisterAttacker(AAIController* Controller)
+{
+	FAttacker* Attacker = FindAttacker(Controller);
+	if (Attacker == nullptr) {
+		return;
+	}
+
+	// Handlers of OnTokenChanged may unregister mid-tick, so the entry itself goes on the next tick
+	SetToken(*Attacker, false);
+	Attacker->Controller.Reset();
+	AttackerIndices.Remove(Attacker->Key);
+}
+
+void UFightDirectorSubsystem::SetAttackTarget(AAIController* Controller, AActor* Target)
+{
+	FAttacker* Attacker = FindAttacker(Controller);
+	if (Attacker == nullptr || Attacker->Target == Target) {
+		return;
+	}
+
+	SetToken(*Attacker, false);
+	Attacker->Target = Target;
+	Attacker->WaitingSince = -1.0f;
+}
+
+void UFightDirectorSubsystem::ReleaseToken(AAIController* Controller)
+{
+	FAttacker* Attacker = FindAttacker(Controller);
+	if (Attacker != nullptr && Attacker->bHasToken) {
+		Attacker->CooldownUntil = GetWorld()->GetTimeSeconds() + TokenCooldown;
+		SetToken(*Attacker, false);
+	}
+}
+
+bool UFightDirectorSubsystem::HasToken(const AAIController* Controller) const
+{
+	const FAttacker* Attacker = FindAttacker(Controller);
+	return Attacker != nullptr && Attacker->bHasToken;
+}
+
+int32 UFightDirectorSubsystem::GetAttackerCount(const AActor* Target) const
+{
+	int32 Count = 0;
+	for (const FAttacker& Attacker : Attackers) {
+		Count += Attacker.bHasToken && Attacker.Target == Target ? 1 : 0;
+	}
+	return Count;
+}
+
+void UFightDirectorSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+	FANTASY_SCOPE(STAT_FightDirector);
+
+	for (int32 Index = Attackers.Num() - 1; Index >= 0; --Index) {
+		if (!Attackers[Index].Controller.IsValid()) {
+			RemoveAttackerAt(Index);
+		}
+	}
+
+	for (TPair<TWeakObjectPtr<AActor>, FTargetSlots>& Slots : Targets) {
+		Slots.Value.Candidates.Reset();
+		Slots.Value.Holders = 0;
+	}
+
+	// One pass over the enemies: keep or revoke held tokens, score everyone waiting for one
+	const float Now = GetWorld()->GetTimeSeconds();
+	const float MaxDistanceSquared = FMath::Square(MaxAttackDistance);
+	int32 Held = 0;
+	for (int32 Index = 0; Index < Attackers.Num(); ++Index) {
+		FAttacker& Attacker = Attackers[Index];
+		const AAIController* Controller = Attacker.Controller.Get();
+		if (Controller == nullptr) {
+			continue;
+		}
+		const APawn* Pawn = Controller->GetPawn();
+		const AActor* Target = Attacker.Target.Get();
+		const float DistanceSquared = Pawn != nullptr && Target != nullptr ? FVector::DistSquared(Pawn->GetActorLocation(), Target->GetActorLocation()) : MAX_flt;
+		const bool bInRange = DistanceSquared <= MaxDistanceSquared;
+
+		if (Attacker.bHasToken) {
+			const bool bExpired = MaxTokenTime > 0.0f && Now - Attacker.TokenTime > MaxTokenTime;
+			if (bInRange && !bExpired) {
+				Targets.FindOrAdd(Attacker.Target).Holders++;
+				++Held;
+				continue;
+			}
+			// Handlers may register attackers and grow the array, so this one is done after SetToken
+			Attacker.CooldownUntil = Now + TokenCooldown;
+			Attacker.WaitingSince = -1.0f;
+			SetToken(Attacker, false);
+			continue;
+		}
+
+		if (!bInRange || Now < Attacker.CooldownUntil) {
+			Attacker.WaitingSince = -1.0f;
+			continue;
+		}
+		if (Attacker.WaitingSince < 0.0f) {
+			Attacker.WaitingSince = Now;
+		}
+
+		const float DistanceScore = MaxAttackDistance > 0.0f ? 1.0f - FMath::Sqrt(DistanceSquared) / MaxAttackDistance : 1.0f;
+		Attacker.Score = DistanceWeight * DistanceScore + PriorityWeight * Attacker.Priority + WaitWeight * (Now - Attacker.WaitingSince);
+		Targets.FindOrAdd(Attacker.Target).Candidates.Add(Index);
+	}
+
+	// Free tokens go to the best candidates; holders are never displaced, so attacks are not cut short
+	for (TMap<TWeakObjectPtr<AActor>, FTargetSlots>::TIterator It = Targets.CreateIterator(); It; ++It) {
+		if (!It->Key.IsValid()) {
+			It.RemoveCurrent();
+			continue;
+		}
+
+		FTargetSlots& Slots = It->Value;
+		for (int32 Free = MaxAttackersPerTarget - Slots.Holders; Free > 0 && Slots.Candidates.Num() > 0; --Free) {
+			int32 Best = 0;
+			for (int32 i = 1; i < Slots.Candidates.Num(); ++i) {
+				if (Attackers[Slots.Candidates[i]].Score > Attackers[Slots.Candidates[Best]].Score) {
+					Best = i;
+				}
+			}
+			FAttacker& Attacker = Attackers[Slots.Candidates[Best]];
+			Slots.Candidates.RemoveAtSwap(Best, 1, false);
+			// A handler may have unregistered it earlier in this pass
+			if (Attacker.Controller.IsValid()) {
+				SetToken(Attacker, true);
+				++Held;
+			}
+		}
+	}
+
+	SET_DWORD_STAT(STAT_FightAttackers, Attackers.Num());
+	SET_DWORD_STAT(STAT_FightTokensHeld, Held);
+}
+
+TStatId UFightDirectorSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFightDirectorSubsystem, STATGROUP_EnemyAI);
+}
+
+void UFightDirectorSubsystem::SetToken(FAttacker& Attacker, bool bHasToken)
+{
+	if (Attacker.bHasToken == bHasToken) {
+		return;
+	}
+	Attacker.bHasToken = bHasToken;
+	if (bHasToken) {
+		Attacker.TokenTime = GetWorld()->GetTimeSeconds();
+		Attacker.WaitingSince = -1.0f;
+	}
+
+	AAIController* Controller = Attacker.Controller.Get();
+	if (Controller == nullptr) {
+		return;
+	}
+	AActor* Target = Attacker.Target.Get();
+
+	if (UBlackboardComponent* Blackboard = Controller->GetBlackboardComponent()) {
+		if (Blackboard->GetKeyID(TokenKey) != FBlackboard::InvalidKey) {
+			Blackboard->SetValueAsBool(TokenKey, bHasToken);
+		}
+	}
+	if (ACBaseEnemy_Controller* Enemy = Cast<ACBaseEnemy_Controller>(Controller)) {
+		Enemy->OnAttackTokenChanged(bHasToken, Target);
+	}
+	OnTokenChanged.Broadcast(Controller, Target, bHasToken);
+}
+
+void UFightDirectorSubsystem::RemoveAttackerAt(int32 Index)
+{
+	const int32* Mapped = AttackerIndices.Find(Attackers[Index].Key);
+	if (Mapped != nullptr && *Mapped == Index) {
+		AttackerIndices.Remove(Attackers[Index].Key);
+	}
+
+	Attackers.RemoveAtSwap(Index, 1, false);
+	if (Attackers.IsValidIndex(Index) && Attackers[Index].Controller.IsValid()) {
+		AttackerIndices.Add(Attackers[Index].Key, Index);
+	}
+}
+
+UFightDirectorSubsystem::FAttacker* UFightDirectorSubsystem::FindAttacker(const AAIController* Controller)
+{
+	const int32* Index = AttackerIndices.Find(FObjectKey(Controller));
+	return Index != nullptr ? &Attackers[*Index] : nullptr;
+}
+
+const UFightDirectorSubsystem::FAttacker* UFightDirectorSubsystem::FindAttacker(const AAIController* Controller) const
+{
+	const int32* Index = AttackerIndices.Find(FObjectKey(Controller));
+	return Index != nullptr ? &Attackers[*Index] : nullptr;
+}
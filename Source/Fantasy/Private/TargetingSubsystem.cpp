@@ -0,0 +1,311 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TargetingSubsystem.h"
+#include "EnemyStats.h"
+#include "BaseCharacter.h"
+#include "Engine/World.h"
+
+namespace {
+	// Origin and direction resolution of the result cache
+	constexpr float CacheOriginStep = 100.0f;
+	constexpr float CacheDirectionStep = 0.05f;
+
+	FIntVector Quantize(const FVector& Vector, float Step)
+	{
+		return FIntVector(FMath::RoundToInt(Vector.X / Step), FMath::RoundToInt(Vector.Y / Step), FMath::RoundToInt(Vector.Z / Step));
+	}
+}
+
+void UTargetingSubsystem::RegisterCharacter(ABaseCharacter* Character)
+{
+	if (Character == nullptr || EntryIndices.Contains(Character)) {
+		return;
+	}
+
+	const int32 Index = Entries.AddDefaulted();
+	EntryIndices.Add(Character, Index);
+	FEntry& Entry = Entries[Index];
+	Entry.Character = Character;
+	Entry.Location = Character->GetActorLocation();
+	Entry.Cell = GetCell(Entry.Location);
+	AddToCell(Index);
+}
+
+void UTargetingSubsystem::UnregisterCharacter(ABaseCharacter* Character)
+{
+	if (const int32* Index = EntryIndices.Find(Character)) {
+		RemoveEntryAt(*Index);
+	}
+}
+
+int32 UTargetingSubsystem::FindTargets(const FTargetingQuery& Query, TArray<ABaseCharacter*>& OutTargets)
+{
+	FANTASY_SCOPE(STAT_TargetingQuery);
+	INC_DWORD_STAT(STAT_TargetingQueries);
+
+	OutTargets.Reset();
+	const float Now = GetWorld()->GetTimeSeconds();
+	const FCacheKey Key = Query.CacheTime > 0.0f ? MakeCacheKey(Query) : FCacheKey();
+	if (Query.CacheTime > 0.0f) {
+		if (const FCachedResult* Cached = Cache.Find(Key)) {
+			if (Now <= Cached->Expires) {
+				INC_DWORD_STAT(STAT_TargetingCacheHits);
+				for (const TWeakObjectPtr<ABaseCharacter>& Target : Cached->Targets) {
+					if (Target.IsValid()) {
+						OutTargets.Add(Target.Get());
+					}
+				}
+				return OutTargets.Num();
+			}
+		}
+	}
+
+	const FVector Direction = Query.Direction.GetSafeNormal();
+	const bool bCone = Query.HalfAngle < 180.0f && !Direction.IsZero();
+	const float HalfAngle = FMath::DegreesToRadians(Query.HalfAngle);
+	const float CosHalfAngle = FMath::Cos(HalfAngle);
+	const bool bTeam = Query.Querier != nullptr && (Query.Team != ETargetingTeamFilter::Any || Query.HostileWeight != 0.0f);
+
+	TArray<TPair<float, int32>, TInlineAllocator<64>> Scored;
+	int32 Candidates = 0;
+	ForEachInRadius(Query.Origin, Query.Range, [&](int32 Index) {
+		const FEntry& Entry = Entries[Index];
+		const ABaseCharacter* Character = Entry.Character.Get();
+		++Candidates;
+		if (Character == nullptr || Character == Query.Querier) {
+			return;
+		}
+
+		const FVector ToTarget = Entry.Location - Query.Origin;
+		const float Distance = ToTarget.Size();
+		float AngleScore = 1.0f;
+		if (!Direction.IsZero() && Distance > KINDA_SMALL_NUMBER) {
+			const float Cos = FVector::DotProduct(ToTarget / Distance, Direction);
+			if (bCone && Cos < CosHalfAngle) {
+				return;
+			}
+			AngleScore = HalfAngle > 0.0f ? 1.0f - FMath::Acos(FMath::Clamp(Cos, -1.0f, 1.0f)) / HalfAngle : 1.0f;
+		}
+
+		bool bHostile = false;
+		if (bTeam) {
+			bHostile = FGenericTeamId::GetAttitude(Query.Querier, Character) == ETeamAttitude::Hostile;
+			if ((Query.Team == ETargetingTeamFilter::Hostile && !bHostile) || (Query.Team == ETargetingTeamFilter::NotHostile && bHostile)) {
+				return;
+			}
+		}
+
+		const float DistanceScore = Query.Range > 0.0f ? 1.0f - Distance / Query.Range : 1.0f;
+		const float Score = Query.AngleWeight * AngleScore + Query.DistanceWeight * DistanceScore + (bHostile ? Query.HostileWeight : 0.0f);
+		Scored.Emplace(Score, Index);
+	});
+	INC_DWORD_STAT_BY(STAT_TargetingCandidates, Candidates);
+
+	Scored.Sort([](const TPair<float, int32>& A, const TPair<float, int32>& B) { return A.Key > B.Key; });
+	const int32 Count = Query.MaxResults > 0 ? FMath::Min(Query.MaxResults, Scored.Num()) : Scored.Num();
+	OutTargets.Reserve(Count);
+	for (int32 i = 0; i < Count; ++i) {
+		OutTargets.Add(Entries[Scored[i].Value].Character.Get());
+	}
+
+	if (Query.CacheTime > 0.0f) {
+		FCachedResult& Cached = Cache.FindOrAdd(Key);
+		Cached.Expires = Now + Query.CacheTime;
+		Cached.Targets.Reset(OutTargets.Num());
+		for (ABaseCharacter* Target : OutTargets) {
+			Cached.Targets.Add(Target);
+		}
+	}
+	return OutTargets.Num();
+}
+
+ABaseCharacter* UTargetingSubsystem::FindBestTarget(const FTargetingQuery& Query)
+{
+	FTargetingQuery Best = Query;
+	Best.MaxResults = 1;
+	TArray<ABaseCharacter*> Targets;
+	return FindTargets(Best, Targets) > 0 ? Targets[0] : nullptr;
+}
+
+int32 UTargetingSubsystem::FindInRadius(const FVector& Origin, float Radius, TArray<ABaseCharacter*>& OutTargets) const
+{
+	FANTASY_SCOPE(STAT_TargetingQuery);
+	INC_DWORD_STAT(STAT_TargetingQueries);
+
+	OutTargets.Reset();
+	ForEachInRadius(Origin, Radius, [this, &OutTargets](int32 Index) {
+		if (ABaseCharacter* Character = Entries[Index].Character.Get()) {
+			OutTargets.Add(Character);
+		}
+	});
+	return OutTargets.Num();
+}
+
+int32 UTargetingSubsystem::FindNearest(const FVector& Origin, float Radius, int32 Count, TArray<ABaseCharacter*>& OutTargets, AActor* Ignore) const
+{
+	FANTASY_SCOPE(STAT_TargetingQuery);
+	INC_DWORD_STAT(STAT_TargetingQueries);
+
+	TArray<TPair<float, int32>, TInlineAllocator<64>> Found;
+	ForEachInRadius(Origin, Radius, [this, &Origin, Ignore, &Found](int32 Index) {
+		const FEntry& Entry = Entries[Index];
+		if (Entry.Character.IsValid() && Entry.Character.Get() != Ignore) {
+			Found.Emplace(FVector::DistSquared(Origin, Entry.Location), Index);
+		}
+	});
+	Found.Sort([](const TPair<float, int32>& A, const TPair<float, int32>& B) { return A.Key < B.Key; });
+
+	OutTargets.Reset();
+	for (int32 i = 0; i < Found.Num() && i < Count; ++i) {
+		OutTargets.Add(Entries[Found[i].Value].Character.Get());
+	}
+	return OutTargets.Num();
+}
+
+void UTargetingSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+	FANTASY_SCOPE(STAT_TargetingGrid);
+
+	// Only characters that crossed into another cell touch the grid
+	for (int32 Index = Entries.Num() - 1; Index >= 0; --Index) {
+		FEntry& Entry = Entries[Index];
+		const ABaseCharacter* Character = Entry.Character.Get();
+		if (Character == nullptr) {
+			RemoveEntryAt(Index);
+			continue;
+		}
+
+		Entry.Location = Character->GetActorLocation();
+		const FIntPoint Cell = GetCell(Entry.Location);
+		if (Cell != Entry.Cell) {
+			RemoveFromCell(Index);
+			Entry.Cell = Cell;
+			AddToCell(Index);
+		}
+	}
+
+	const float Now = GetWorld()->GetTimeSeconds();
+	for (TMap<FCacheKey, FCachedResult>::TIterator It = Cache.CreateIterator(); It; ++It) {
+		if (Now > It->Value.Expires) {
+			It.RemoveCurrent();
+		}
+	}
+}
+
+TStatId UTargetingSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTargetingSubsystem, STATGROUP_EnemyAI);
+}
+
+FIntPoint UTargetingSubsystem::GetCell(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+}
+
+void UTargetingSubsystem::AddToCell(int32 Index)
+{
+	FEntry& Entry = Entries[Index];
+	Entry.Slot = Grid.FindOrAdd(Entry.Cell).Add(Index);
+}
+
+void UTargetingSubsystem::RemoveFromCell(int32 Index)
+{
+	FEntry& Entry = Entries[Index];
+	TArray<int32>& Cell = Grid.FindChecked(Entry.Cell);
+	Cell.RemoveAtSwap(Entry.Slot, 1, false);
+	if (Cell.IsValidIndex(Entry.Slot)) {
+		Entries[Cell[Entry.Slot]].Slot = Entry.Slot;
+	} else if (Cell.Num() == 0) {
+		Grid.Remove(Entry.Cell);
+	}
+	Entry.Slot = INDEX_NONE;
+}
+
+void UTargetingSubsystem::RemoveEntryAt(int32 Index)
+{
+	RemoveFromCell(Index);
+	EntryIndices.Remove(Entries[Index].Character);
+
+	// The last entry takes the freed index; point its cell and lookup at the new one
+	const int32 Last = Entries.Num() - 1;
+	if (Index != Last) {
+		const FEntry& Moved = Entries[Last];
+		Grid.FindChecked(Moved.Cell)[Moved.Slot] = Index;
+		EntryIndices.Add(Moved.Character, Index);
+	}
+	Entries.RemoveAtSwap(Index, 1, false);
+}
+
+template <typename FVisit>
+void UTargetingSubsystem::ForEachInRadius(const FVector& Origin, float Radius, FVisit Visit) const
+{
+	const FIntPoint Min = GetCell(Origin - FVector(Radius));
+	const FIntPoint Max = GetCell(Origin + FVector(Radius));
+	const float RadiusSquared = FMath::Square(Radius);
+
+	auto VisitCell = [this, &Origin, RadiusSquared, &Visit](const TArray<int32>& Cell) {
+		for (const int32 Index : Cell) {
+			if (FVector::DistSquared(Entries[Index].Location, Origin) <= RadiusSquared) {
+				Visit(Index);
+			}
+		}
+	};
+
+	// A radius spanning more cells than are occupied is cheaper to answer from the occupied ones
+	const int64 CellCount = int64(Max.X - Min.X + 1) * int64(Max.Y - Min.Y + 1);
+	if (CellCount > Grid.Num()) {
+		for (const TPair<FIntPoint, TArray<int32>>& Cell : Grid) {
+			if (Cell.Key.X >= Min.X && Cell.Key.X <= Max.X && Cell.Key.Y >= Min.Y && Cell.Key.Y <= Max.Y) {
+				VisitCell(Cell.Value);
+			}
+		}
+		return;
+	}
+
+	for (int32 X = Min.X; X <= Max.X; ++X) {
+		for (int32 Y = Min.Y; Y <= Max.Y; ++Y) {
+			if (const TArray<int32>* Cell = Grid.Find(FIntPoint(X, Y))) {
+				VisitCell(*Cell);
+			}
+		}
+	}
+}
+
+UTargetingSubsystem::FCacheKey UTargetingSubsystem::MakeCacheKey(const FTargetingQuery& Query)
+{
+	FCacheKey Key;
+	Key.Querier = FObjectKey(Query.Querier);
+	Key.Origin = Quantize(Query.Origin, CacheOriginStep);
+	Key.Direction = Quantize(Query.Direction.GetSafeNormal(), CacheDirectionStep);
+	Key.Range = Query.Range;
+	Key.HalfAngle = Query.HalfAngle;
+	Key.Team = Query.Team;
+	Key.MaxResults = Query.MaxResults;
+	Key.AngleWeight = Query.AngleWeight;
+	Key.DistanceWeight = Query.DistanceWeight;
+	Key.HostileWeight = Query.HostileWeight;
+	return Key;
+}
+
+bool UTargetingSubsystem::FCacheKey::operator==(const FCacheKey& Other) const
+{
+	return Querier == Other.Querier && Origin == Other.Origin && Direction == Other.Direction
+		&& Range == Other.Range && HalfAngle == Other.HalfAngle && Team == Other.Team && MaxResults == Other.MaxResults
+		&& AngleWeight == Other.AngleWeight && DistanceWeight == Other.DistanceWeight && HostileWeight == Other.HostileWeight;
+}
+
+uint32 UTargetingSubsystem::FCacheKey::GetHash() const
+{
+	uint32 Hash = GetTypeHash(Querier);
+	Hash = HashCombine(Hash, GetTypeHash(Origin));
+	Hash = HashCombine(Hash, GetTypeHash(Direction));
+	Hash = HashCombine(Hash, GetTypeHash(Range));
+	Hash = HashCombine(Hash, GetTypeHash(HalfAngle));
+	Hash = HashCombine(Hash, GetTypeHash(static_cast<uint8>(Team)));
+	Hash = HashCombine(Hash, GetTypeHash(MaxResults));
+	Hash = HashCombine(Hash, GetTypeHash(AngleWeight));
+	Hash = HashCombine(Hash, GetTypeHash(DistanceWeight));
+	return HashCombine(Hash, GetTypeHash(HostileWeight));
+}
@@ -0,0 +1,360 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VisionConeSubsystem.h"
+#include "EnemyStats.h"
+#include "AIController.h"
+#include "Perception/AIPerceptionComponent.h"
+#include "Perception/AISense_Sight.h"
+#include "Perception/AISenseConfig_Sight.h"
+#include "GameFramework/PlayerController.h"
+#include "Engine/World.h"
+
+namespace {
+	UAISenseConfig_Sight* FindSightConfig(const AAIController& Controller)
+	{
+		UAIPerceptionComponent* Perception = Controller.GetAIPerceptionComponent();
+		if (Perception == nullptr) {
+			return nullptr;
+		}
+		return Cast<UAISenseConfig_Sight>(Perception->GetSenseConfig(UAISense::GetSenseID(UAISense_Sight::StaticClass())));
+	}
+}
+
+void UVisionConeSubsystem::RegisterViewer(AAIController* Controller)
+{
+	if (Controller == nullptr || FindViewer(Controller) != nullptr) {
+		return;
+	}
+
+	ViewerIndices.Add(Controller, Viewers.Num());
+	FViewer& Viewer = Viewers.AddDefaulted_GetRef();
+	Viewer.Controller = Controller;
+	ReadSightConfig(Viewer);
+}
+
+void UVisionConeSubsystem::UnregisterViewer(AAIController* Controller)
+{
+	if (const int32* Index = ViewerIndices.Find(Controller)) {
+		RemoveViewerAt(*Index);
+	}
+	PendingAngles.Remove(Controller);
+}
+
+void UVisionConeSubsystem::RequestSightAngle(AAIController* Controller, float Angle)
+{
+	if (Controller != nullptr) {
+		PendingAngles.Add(Controller, Angle);
+	}
+}
+
+bool UVisionConeSubsystem::CanSee(const AAIController* Controller, const AActor* Target) const
+{
+	const FViewer* Viewer = FindViewer(Controller);
+	const FSighting* Sighting = Viewer != nullptr ? FindSighting(*Viewer, Target) : nullptr;
+	return Sighting != nullptr && Sighting->bVisible;
+}
+
+AActor* UVisionConeSubsystem::GetVisibleTarget(const AAIController* Controller) const
+{
+	const FViewer* Viewer = FindViewer(Controller);
+	if (Viewer == nullptr) {
+		return nullptr;
+	}
+
+	AActor* Nearest = nullptr;
+	float NearestDistanceSquared = MAX_flt;
+	for (const FSighting& Sighting : Viewer->Sightings) {
+		AActor* Target = Sighting.Target.Get();
+		if (Sighting.bVisible && Target != nullptr) {
+			const float DistanceSquared = FVector::DistSquared(Viewer->Eye, Target->GetActorLocation());
+			if (DistanceSquared < NearestDistanceSquared) {
+				NearestDistanceSquared = DistanceSquared;
+				Nearest = Target;
+			}
+		}
+	}
+	return Nearest;
+}
+
+bool UVisionConeSubsystem::GetLastSeen(const AAIController* Controller, const AActor* Target, float& OutTime, FVector& OutLocation) const
+{
+	const FViewer* Viewer = FindViewer(Controller);
+	const FSighting* Sighting = Viewer != nullptr ? FindSighting(*Viewer, Target) : nullptr;
+	if (Sighting == nullptr || Sighting->LastSeenTime == -MAX_flt) {
+		return false;
+	}
+	OutTime = Sighting->LastSeenTime;
+	OutLocation = Sighting->LastSeenLocation;
+	return true;
+}
+
+void UVisionConeSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	TraceDelegate.BindUObject(this, &UVisionConeSubsystem::OnTraceDone);
+}
+
+void UVisionConeSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+	FANTASY_SCOPE(STAT_EnemyVision);
+
+	ApplySightAngles();
+	RefreshViewers();
+	BuildGrid();
+
+	TArray<AActor*, TInlineAllocator<8>> Targets;
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It) {
+		if (const APlayerController* PlayerController = It->Get()) {
+			if (APawn* Pawn = PlayerController->GetPawn()) {
+				Targets.Add(Pawn);
+			}
+		}
+	}
+
+	int32 TraceBudget = MaxTracesPerFrame;
+	for (int32 i = 0; i < Targets.Num(); ++i) {
+		CheckTarget(*Targets[(FirstTarget + i) % Targets.Num()], TraceBudget);
+	}
+	FirstTarget = Targets.Num() > 0 ? (FirstTarget + 1) % Targets.Num() : 0;
+
+	BroadcastChanges();
+
+	SET_DWORD_STAT(STAT_EnemyVisionTraces, MaxTracesPerFrame - TraceBudget);
+}
+
+TStatId UVisionConeSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UVisionConeSubsystem, STATGROUP_EnemyAI);
+}
+
+void UVisionConeSubsystem::ApplySightAngles()
+{
+	int32 ListenerUpdates = 0;
+	for (const TPair<TWeakObjectPtr<AAIController>, float>& Pending : PendingAngles) {
+		AAIController* Controller = Pending.Key.Get();
+		if (Controller == nullptr) {
+			continue;
+		}
+
+		// Only the last angle of the frame reaches perception, and only if it differs
+		UAISenseConfig_Sight* Sight = FindSightConfig(*Controller);
+		if (Sight != nullptr && Sight->PeripheralVisionAngleDegrees != Pending.Value) {
+			Sight->PeripheralVisionAngleDegrees = Pending.Value;
+			Controller->GetAIPerceptionComponent()->RequestStimuliListenerUpdate();
+			++ListenerUpdates;
+		}
+
+		if (FViewer* Viewer = FindViewer(Controller)) {
+			if (Sight != nullptr) {
+				ReadSightConfig(*Viewer);
+			} else {
+				Viewer->CosHalfAngle = FMath::Cos(FMath::DegreesToRadians(Pending.Value));
+			}
+		}
+	}
+	PendingAngles.Reset();
+
+	SET_DWORD_STAT(STAT_EnemyListenerUpdates, ListenerUpdates);
+}
+
+void UVisionConeSubsystem::RefreshViewers()
+{
+	for (int32 Index = Viewers.Num() - 1; Index >= 0; --Index) {
+		if (!Viewers[Index].Controller.IsValid()) {
+			RemoveViewerAt(Index);
+		}
+	}
+
+	MaxViewerRange = 0.0f;
+	for (FViewer& Viewer : Viewers) {
+		AAIController* Controller = Viewer.Controller.Get();
+		if (Controller->GetPawn() == nullptr) {
+			// Nothing to see with until the controller possesses a pawn again
+			for (FSighting& Sighting : Viewer.Sightings) {
+				SetVisible(Viewer, Sighting, false, Sighting.LastSeenLocation);
+			}
+			continue;
+		}
+
+		FRotator Rotation;
+		Controller->GetActorEyesViewPoint(Viewer.Eye, Rotation);
+		Viewer.Forward = Rotation.Vector();
+		MaxViewerRange = FMath::Max(MaxViewerRange, Viewer.Range);
+
+		Viewer.Sightings.RemoveAllSwap([](const FSighting& Sighting) { return !Sighting.Target.IsValid(); }, false);
+
+		// Targets that left the range are no longer near enough to be checked, so clear them here
+		for (FSighting& Sighting : Viewer.Sightings) {
+			const FVector Location = Sighting.Target->GetActorLocation();
+			if (Sighting.bVisible && FVector::DistSquared(Viewer.Eye, Location) > FMath::Square(Viewer.Range)) {
+				SetVisible(Viewer, Sighting, false, Location);
+			}
+		}
+	}
+}
+
+void UVisionConeSubsystem::BuildGrid()
+{
+	// Cells are kept between frames so their arrays keep their allocations
+	for (TPair<FIntVector, TArray<int32>>& Cell : Grid) {
+		Cell.Value.Reset();
+	}
+
+	for (int32 Index = 0; Index < Viewers.Num(); ++Index) {
+		const FViewer& Viewer = Viewers[Index];
+		if (Viewer.Controller->GetPawn() != nullptr && Viewer.Range > 0.0f) {
+			const FVector Cell = Viewer.Eye / CellSize;
+			Grid.FindOrAdd(FIntVector(FMath::FloorToInt(Cell.X), FMath::FloorToInt(Cell.Y), FMath::FloorToInt(Cell.Z))).Add(Index);
+		}
+	}
+}
+
+void UVisionConeSubsystem::CheckTarget(AActor& Target, int32& TraceBudget)
+{
+	const FVector Location = Target.GetActorLocation();
+	const FVector Cell = Location / CellSize;
+	const FIntVector Center(FMath::FloorToInt(Cell.X), FMath::FloorToInt(Cell.Y), FMath::FloorToInt(Cell.Z));
+	const int32 Reach = FMath::Max(1, FMath::CeilToInt(MaxViewerRange / CellSize));
+	const float Now = GetWorld()->GetTimeSeconds();
+
+	int32 Pairs = 0;
+	for (int32 X = -Reach; X <= Reach; ++X) {
+		for (int32 Y = -Reach; Y <= Reach; ++Y) {
+			for (int32 Z = -Reach; Z <= Reach; ++Z) {
+				const TArray<int32>* Indices = Grid.Find(Center + FIntVector(X, Y, Z));
+				if (Indices == nullptr) {
+					continue;
+				}
+
+				for (const int32 Index : *Indices) {
+					FViewer& Viewer = Viewers[Index];
+					FSighting* Sighting = FindSighting(Viewer, &Target);
+					++Pairs;
+
+					if (!IsInCone(Viewer, Location)) {
+						if (Sighting != nullptr) {
+							SetVisible(Viewer, *Sighting, false, Location);
+						}
+						continue;
+					}
+
+					if (Sighting == nullptr) {
+						Sighting = &Viewer.Sightings.AddDefaulted_GetRef();
+						Sighting->Target = &Target;
+					}
+					// Over budget the pair keeps its last result and is traced on a later frame
+					if (Sighting->bTracePending || Now - Sighting->LastTraceTime < TraceInterval || TraceBudget <= 0) {
+						continue;
+					}
+
+					--TraceBudget;
+					Sighting->bTracePending = true;
+					Sighting->LastTraceTime = Now;
+
+					const uint32 Id = NextTraceId++;
+					PendingTraces.Add(Id, { Viewer.Controller, &Target });
+					const FCollisionQueryParams Params(SCENE_QUERY_STAT(VisionCone), false, Viewer.Controller->GetPawn());
+					GetWorld()->AsyncLineTraceByChannel(EAsyncTraceType::Single, Viewer.Eye, Location, TraceChannel, Params,
+						FCollisionResponseParams::DefaultResponseParam, &TraceDelegate, Id);
+				}
+			}
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_EnemyVisionPairs, Pairs);
+}
+
+void UVisionConeSubsystem::SetVisible(FViewer& Viewer, FSighting& Sighting, bool bVisible, const FVector& Location)
+{
+	if (bVisible) {
+		Sighting.LastSeenTime = GetWorld()->GetTimeSeconds();
+		Sighting.LastSeenLocation = Location;
+	}
+	if (Sighting.bVisible != bVisible) {
+		Sighting.bVisible = bVisible;
+		PendingChanges.Add({ Viewer.Controller, Sighting.Target, bVisible });
+	}
+}
+
+void UVisionConeSubsystem::BroadcastChanges()
+{
+	// Nothing a handler can call queues changes, so the array is stable while it is walked
+	for (const FVisibilityChange& Change : PendingChanges) {
+		if (AAIController* Controller = Change.Controller.Get()) {
+			OnVisibilityChanged.Broadcast(Controller, Change.Target.Get(), Change.bVisible);
+		}
+	}
+	PendingChanges.Reset();
+}
+
+void UVisionConeSubsystem::OnTraceDone(const FTraceHandle& Handle, FTraceDatum& Datum)
+{
+	FPendingTrace Pending;
+	if (!PendingTraces.RemoveAndCopyValue(Datum.UserData, Pending)) {
+		return;
+	}
+
+	AActor* Target = Pending.Target.Get();
+	FViewer* Viewer = FindViewer(Pending.Controller.Get());
+	FSighting* Sighting = Viewer != nullptr ? FindSighting(*Viewer, Target) : nullptr;
+	if (Sighting == nullptr) {
+		return;
+	}
+	Sighting->bTracePending = false;
+
+	// The trace ends on the target, so hitting nothing counts as seeing it. The cone may have turned away meanwhile.
+	const bool bClear = Datum.OutHits.Num() == 0 || !Datum.OutHits[0].bBlockingHit || Datum.OutHits[0].GetActor() == Target;
+	SetVisible(*Viewer, *Sighting, bClear && IsInCone(*Viewer, Datum.End), Datum.End);
+	BroadcastChanges();
+}
+
+void UVisionConeSubsystem::ReadSightConfig(FViewer& Viewer) const
+{
+	const UAISenseConfig_Sight* Sight = Viewer.Controller.IsValid() ? FindSightConfig(*Viewer.Controller) : nullptr;
+	const float HalfAngle = Sight != nullptr ? Sight->PeripheralVisionAngleDegrees : DefaultHalfAngle;
+	Viewer.CosHalfAngle = FMath::Cos(FMath::DegreesToRadians(HalfAngle));
+	Viewer.Range = Sight != nullptr ? Sight->SightRadius : DefaultRange;
+}
+
+void UVisionConeSubsystem::RemoveViewerAt(int32 Index)
+{
+	ViewerIndices.Remove(Viewers[Index].Controller);
+	Viewers.RemoveAtSwap(Index, 1, false);
+	if (Viewers.IsValidIndex(Index)) {
+		ViewerIndices.Add(Viewers[Index].Controller, Index);
+	}
+}
+
+bool UVisionConeSubsystem::IsInCone(const FViewer& Viewer, const FVector& Location)
+{
+	const FVector ToTarget = Location - Viewer.Eye;
+	const float DistanceSquared = ToTarget.SizeSquared();
+	if (DistanceSquared > FMath::Square(Viewer.Range)) {
+		return false;
+	}
+	return DistanceSquared < KINDA_SMALL_NUMBER || FVector::DotProduct(ToTarget / FMath::Sqrt(DistanceSquared), Viewer.Forward) >= Viewer.CosHalfAngle;
+}
+
+UVisionConeSubsystem::FViewer* UVisionConeSubsystem::FindViewer(const AAIController* Controller)
+{
+	const int32* Index = ViewerIndices.Find(Controller);
+	return Index != nullptr ? &Viewers[*Index] : nullptr;
+}
+
+const UVisionConeSubsystem::FViewer* UVisionConeSubsystem::FindViewer(const AAIController* Controller) const
+{
+	const int32* Index = ViewerIndices.Find(Controller);
+	return Index != nullptr ? &Viewers[*Index] : nullptr;
+}
+
+UVisionConeSubsystem::FSighting* UVisionConeSubsystem::FindSighting(FViewer& Viewer, const AActor* Target)
+{
+	return Viewer.Sightings.FindByPredicate([Target](const FSighting& Sighting) { return Sighting.Target == Target; });
+}
+
+const UVisionConeSubsystem::FSighting* UVisionConeSubsystem::FindSighting(const FViewer& Viewer, const AActor* Target)
+{
+	return Viewer.Sightings.FindByPredicate([Target](const FSighting& Sighting) { return Sighting.Target == Target; });
+}
@@ -0,0 +1,150 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Components/SkinnedMeshComponent.h"
+#include "AISignificanceSubsystem.generated.h"
+
+class AAIController;
+
+UENUM(BlueprintType)
+enum class EAISignificance : uint8 {
+	High,
+	Medium,
+	Low,
+	Dormant,
+	MAX UMETA(Hidden)
+};
+
+// How enemies in one significance bucket are throttled. Intervals are in seconds; 0 ticks every frame.
+USTRUCT(BlueprintType) struct FAISignificanceBucket {
+	GENERATED_BODY();
+
+	// Farthest distance to the nearest player view still in this bucket; the last bucket takes everything beyond
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0"))
+	float MaxDistance = 0.0f;
+
+	// Pauses the behavior tree. Its tick interval cannot be throttled instead, since UBehaviorTreeComponent
+	// sets its own interval every tick to sleep until the next scheduled task.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bPauseBehavior = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0"))
+	float PerceptionTickInterval = 0.0f;
+
+	// Sight is switched off entirely when false; other senses such as hearing and damage still wake the enemy
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bSight = true;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0"))
+	float MovementTickInterval = 0.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0"))
+	float AnimationTickInterval = 0.0f;
+
+	// Keep evaluating the pose while the mesh is off screen; montages and notifies run either way
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bAnimateWhenHidden = true;
+
+	// The pawn's own Tick, e.g. ABaseCharacter::Tick
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0"))
+	float ActorTickInterval = 0.0f;
+};
+
+/**
+ * Buckets enemy AI by distance to, and visibility from, the players and throttles each bucket's ticking.
+ * Controllers register themselves on possess; a slice of them is re-bucketed every frame so the cost stays flat with the enemy count.
+ */
+UCLASS(Config = Game)
+class FANTASY_API UAISignificanceSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UAISignificanceSubsystem();
+
+	// One per EAISignificance, nearest first
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "AI|Significance", EditFixedSize)
+	TArray<FAISignificanceBucket> Buckets;
+
+	// Enemies no player has rendered recently drop one bucket
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "AI|Significance")
+	bool bDemoteUnseen = true;
+
+	// How recently the pawn must have been rendered to count as seen
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "AI|Significance", meta = (ClampMin = "0", EditCondition = "bDemoteUnseen"))
+	float SeenTolerance = 0.5f;
+
+	// Fraction of a bucket's MaxDistance an enemy has to come back inside before it moves up again, so edges do not flicker
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "AI|Significance", meta = (ClampMin = "0", ClampMax = "0.9"))
+	float Hysteresis = 0.1f;
+
+	// Enemies re-bucketed per frame; the others keep their bucket until their turn comes round
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "AI|Significance", meta = (ClampMin = "1"))
+	int32 UpdatesPerFrame = 32;
+
+	// After WakeController an enemy stays out of buckets that pause its behavior for this long
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "AI|Significance", meta = (ClampMin = "0"))
+	float WakeTime = 5.0f;
+
+	// Game thread cost of one skipped tick, used for the savings estimate; calibrate against stat Game
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "AI|Significance", meta = (ClampMin = "0"))
+	float TickCostMicroseconds = 15.0f;
+
+	// Starts throttling Controller and its pawn; registering twice is harmless
+	UFUNCTION(BlueprintCallable, Category = "AI|Significance")
+	void RegisterController(AAIController* Controller);
+
+	// Restores full rate ticking
+	UFUNCTION(BlueprintCallable, Category = "AI|Significance")
+	void UnregisterController(AAIController* Controller);
+
+	// Resumes a paused behavior tree right away, e.g. when perception notices something; see WakeTime
+	UFUNCTION(BlueprintCallable, Category = "AI|Significance")
+	void WakeController(AAIController* Controller);
+
+	UFUNCTION(BlueprintPure, Category = "AI|Significance")
+	EAISignificance GetSignificance(const AAIController* Controller) const;
+
+	UFUNCTION(BlueprintPure, Category = "AI|Significance")
+	int32 GetBucketCount(EAISignificance Significance) const;
+
+	// Component and actor ticks per second not run, against every enemy ticking every frame; paused behavior trees are not counted
+	UFUNCTION(BlueprintPure, Category = "AI|Significance")
+	float GetTicksSkippedPerSecond() const { return TicksSkippedPerSecond; }
+
+	// TicksSkippedPerSecond as game thread milliseconds per frame
+	UFUNCTION(BlueprintPure, Category = "AI|Significance")
+	float GetEstimatedMsSaved() const { return EstimatedMsSaved; }
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	struct FEntry {
+		TWeakObjectPtr<AAIController> Controller;
+		EAISignificance Significance = EAISignificance::High;
+		// What the mesh did before it was throttled, restored on unregister
+		EVisibilityBasedAnimTickOption DefaultAnimTickOption = EVisibilityBasedAnimTickOption::AlwaysTickPoseAndRefreshBones;
+		// Whether we paused the brain, so a pause from elsewhere is never resumed here
+		bool bBehaviorPaused = false;
+		float AwakeUntil = 0.0f;
+	};
+
+	EAISignificance Classify(const FEntry& Entry) const;
+	static void Apply(FEntry& Entry, const FAISignificanceBucket& Bucket);
+	void UpdateViews();
+
+private:
+	TArray<FEntry> Entries;
+	int32 NextUpdate = 0;
+
+	// Where every player is looking from, refreshed each frame
+	TArray<FVector> Views;
+
+	int32 Counts[static_cast<int32>(EAISignificance::MAX)] = {};
+	float TicksSkippedPerSecond = 0.0f;
+	float EstimatedMsSaved = 0.0f;
+};
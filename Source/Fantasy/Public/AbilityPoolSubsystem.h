@@ -0,0 +1,111 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AbilityPoolSubsystem.generated.h"
+
+class UDataTable;
+
+// Counters of one pooled class, for tuning PrewarmCount and MaxPerClass
+USTRUCT(BlueprintType) struct FAbilityPoolStats {
+	GENERATED_BODY();
+
+	// Acquires served from a free instance
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 Hits = 0;
+
+	// Acquires that had to spawn, over budget or not
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 Misses = 0;
+
+	// Misses spawned as plain actors because the class was at MaxPerClass
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 Overflows = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 Active = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 Free = 0;
+
+	// Most instances active at once
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 Peak = 0;
+};
+
+/**
+ * Reuses ability actors instead of spawning and destroying one per cast.
+ * At map start it spawns, begins play and parks PrewarmCount instances of every actor class referenced by the ability tables;
+ * acquiring places and re-enables one, releasing hides and disables it. Pools grow on demand up to MaxPerClass.
+ */
+UCLASS(Config = Game)
+class FANTASY_API UAbilityPoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// Every actor class property of every row is pooled, e.g. /Game/Tables/Abilities
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "Ability|Pool")
+	TArray<TSoftObjectPtr<UDataTable>> AbilityTables;
+
+	// Instances spawned per class at map start
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "Ability|Pool", meta = (ClampMin = "0"))
+	int32 PrewarmCount = 4;
+
+	// Pooled instances per class, active and free together; acquires beyond it spawn plain actors
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "Ability|Pool", meta = (ClampMin = "1"))
+	int32 MaxPerClass = 32;
+
+	// Spawns Class at Transform, reusing a released instance when there is one
+	UFUNCTION(BlueprintCallable, Category = "Ability|Pool", meta = (DeterminesOutputType = "Class"))
+	AActor* AcquireActor(TSubclassOf<AActor> Class, const FTransform& Transform, AActor* NewOwner = nullptr, APawn* NewInstigator = nullptr);
+
+	// Use instead of DestroyActor; actors the pool does not know are destroyed
+	UFUNCTION(BlueprintCallable, Category = "Ability|Pool")
+	void ReleaseActor(AActor* Actor);
+
+	// Makes sure Count free instances of Class exist, within MaxPerClass
+	UFUNCTION(BlueprintCallable, Category = "Ability|Pool")
+	void Prewarm(TSubclassOf<AActor> Class, int32 Count);
+
+	UFUNCTION(BlueprintPure, Category = "Ability|Pool")
+	FAbilityPoolStats GetPoolStats(TSubclassOf<AActor> Class) const;
+
+	// All classes added up
+	UFUNCTION(BlueprintPure, Category = "Ability|Pool")
+	FAbilityPoolStats GetTotalStats() const;
+
+	// Logs the counters of every pool
+	UFUNCTION(BlueprintCallable, Category = "Ability|Pool")
+	void DumpStats() const;
+
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+protected:
+	struct FPool {
+		TArray<TWeakObjectPtr<AActor>> Free;
+		FAbilityPoolStats Stats;
+	};
+
+	struct FMember {
+		// Fully spawned either way; BeginPlay ran when the member was created, prewarmed or not
+		bool bActive = false;
+	};
+
+	AActor* SpawnMember(UClass* Class, const FTransform& Transform, AActor* NewOwner, APawn* NewInstigator);
+	void Activate(AActor& Actor, const FTransform& Transform, AActor* NewOwner, APawn* NewInstigator);
+	void Deactivate(AActor& Actor);
+	void CollectTableClasses(TArray<UClass*>& OutClasses) const;
+	void PrewarmTables();
+
+	UFUNCTION()
+	void OnMemberDestroyed(AActor* Actor);
+
+private:
+	// Keyed by class; pooled actors belong to the level, which keeps them alive
+	TMap<TWeakObjectPtr<UClass>, FPool> Pools;
+	TMap<TWeakObjectPtr<AActor>, FMember> Members;
+};
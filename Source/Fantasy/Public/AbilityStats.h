@@ -0,0 +1,18 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "FantasyStats.h"
+
+// stat Ability
+DECLARE_STATS_GROUP(TEXT("Ability"), STATGROUP_Ability, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Pool acquire"), STAT_AbilityAcquire, STATGROUP_Ability, FANTASY_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Pool release"), STAT_AbilityRelease, STATGROUP_Ability, FANTASY_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Pool prewarm"), STAT_AbilityPrewarm, STATGROUP_Ability, FANTASY_API);
+
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Pooled actors active"), STAT_AbilityPoolActive, STATGROUP_Ability, FANTASY_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Pooled actors free"), STAT_AbilityPoolFree, STATGROUP_Ability, FANTASY_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Pool hits"), STAT_AbilityPoolHits, STATGROUP_Ability, FANTASY_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Pool misses"), STAT_AbilityPoolMisses, STATGROUP_Ability, FANTASY_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Spawned over budget"), STAT_AbilityPoolOverflows, STATGROUP_Ability, FANTASY_API);
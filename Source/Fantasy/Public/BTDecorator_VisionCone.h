@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BehaviorTree/BTDecorator.h"
+#include "BTDecorator_VisionCone.generated.h"
+
+/**
+ * Passes while the enemy can see a player, read from UVisionConeSubsystem instead of tracing on every evaluation.
+ * With TargetKey set only that actor counts; otherwise any player does.
+ */
+UCLASS()
+class FANTASY_API UBTDecorator_VisionCone : public UBTDecorator
+{
+	GENERATED_BODY()
+
+public:
+	UBTDecorator_VisionCone();
+
+	// Actor to look for; leave empty to accept any visible player
+	UPROPERTY(EditAnywhere, Category = "Vision")
+	FBlackboardKeySelector TargetKey;
+
+	virtual void InitializeFromAsset(UBehaviorTree& Asset) override;
+	virtual bool CalculateRawConditionValue(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory) const override;
+	virtual uint16 GetInstanceMemorySize() const override;
+	virtual FString GetStaticDescription() const override;
+
+protected:
+	struct FVisionConeMemory {
+		bool bLastValue = false;
+	};
+
+	virtual void OnBecomeRelevant(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory) override;
+	virtual void TickNode(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory, float DeltaSeconds) override;
+};
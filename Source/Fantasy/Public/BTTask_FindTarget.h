@@ -0,0 +1,28 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BehaviorTree/Tasks/BTTask_BlackboardBase.h"
+#include "TargetingSubsystem.h"
+#include "BTTask_FindTarget.generated.h"
+
+/**
+ * Writes the best target around the enemy into the blackboard key, ranked by UTargetingSubsystem.
+ * Fails, and clears the key, when nothing matches.
+ */
+UCLASS()
+class FANTASY_API UBTTask_FindTarget : public UBTTask_BlackboardBase
+{
+	GENERATED_BODY()
+
+public:
+	UBTTask_FindTarget();
+
+	// Origin, direction and querier are filled in from the controlled pawn
+	UPROPERTY(EditAnywhere, Category = "Targeting")
+	FTargetingQuery Query;
+
+	virtual EBTNodeResult::Type ExecuteTask(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory) override;
+	virtual FString GetStaticDescription() const override;
+};
@@ -4,15 +4,54 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "BuildingGeometry.h"
+#include "CoverPointSubsystem.h"
 #include "Building.generated.h"
 
+UENUM(BlueprintType)
+enum class EBuildingFillMode : uint8 {
+	// Triangulate the footprint outline directly
+	Triangulate,
+	// Probe a triangle grid over the spline bounds
+	Grid,
+};
+
+UENUM(BlueprintType)
+enum class EBuildingOutputMode : uint8 {
+	// Every wall piece baked into the procedural mesh
+	Merged,
+	// One hierarchical instanced static mesh per MeshTypes entry, one instance per wall piece
+	Instanced,
+};
+
+UENUM(BlueprintType)
+enum class EBuildingCollisionMode : uint8 {
+	// Every render triangle is cooked into collision
+	Complex,
+	// Convex boxes per segment per floor, open at door pieces, and a flat convex under and over the fill;
+	// render sections only collide where flagged
+	Simplified,
+	None,
+};
+
+UENUM(BlueprintType)
+enum class EBuildingOpening : uint8 {
+	// Solid wall, full height cover
+	Wall,
+	// Low cover under the sill
+	Window,
+	// A way through, no cover
+	Door,
+};
+
 USTRUCT(BlueprintType) struct FMeshData {
 	GENERATED_BODY();
 	
 	FMeshData() :
 		StaticMesh(nullptr),
 		Length(250.0f),
-		Height(300.0f) {};
+		Height(300.0f),
+		Opening(EBuildingOpening::Wall) {};
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	UStaticMesh* StaticMesh;
@@ -22,6 +61,10 @@ USTRUCT(BlueprintType) struct FMeshData {
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	float Height;
+
+	// What the piece offers as cover
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	EBuildingOpening Opening;
 };
 
 USTRUCT(BlueprintType) struct FBuildingSection {
@@ -78,28 +121,344 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building")
 	float TopSink = 0;
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Fill")
+	EBuildingFillMode FillMode = EBuildingFillMode::Triangulate;
+
+	// Outline points closer than this to the line through their neighbours are dropped before triangulating
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Fill", meta = (ClampMin = "0", EditCondition = "FillMode == EBuildingFillMode::Triangulate"))
+	float FillSimplifyTolerance = 1.0f;
+
+	// Each level splits every fill triangle into four, for materials that need interior vertices
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Fill", meta = (ClampMin = "0", ClampMax = "6", EditCondition = "FillMode == EBuildingFillMode::Triangulate"))
+	int32 FillSubdivisions = 0;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Selection")
 	TArray<FMeshData> MeshTypes;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Selection")
 	TMap<UMaterialInterface*, UMaterialInterface*> Materials;
 
+	// Segments regenerated by the last rebuild
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Building|Stats")
+	int32 SegmentsRebuilt = 0;
+
+	// Segments whose geometry was reused from the previous rebuild
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Building|Stats")
+	int32 SegmentsReused = 0;
+
+	// Regenerated segments copied from an identical floor of the same rebuild
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Building|Stats")
+	int32 SegmentsRepeated = 0;
+
+	// Geometry buffers that had to allocate during the last rebuild; zero once the buffers have warmed up
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Building|Stats")
+	int32 BufferAllocations = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Generation")
+	EBuildingOutputMode OutputMode = EBuildingOutputMode::Merged;
+
+	// Geometry currently uploaded by this building, fill included; also summed up in stat Building
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Building|Stats")
+	int32 VertexCount = 0;
+
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Building|Stats")
+	int32 TriangleCount = 0;
+
+	// Non-empty procedural mesh sections plus instance components with instances; one draw call each per pass
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Building|Stats")
+	int32 DrawCalls = 0;
+
+	// Estimated memory of the walls in merged mode, whichever mode is active
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Building|Stats")
+	int64 MergedMemoryBytes = 0;
+
+	// Estimated memory of the walls in instanced mode, whichever mode is active
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Building|Stats")
+	int64 InstancedMemoryBytes = 0;
+
+	// Spline samples per segment used to lay out the pattern; higher follows curved segments more closely
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Generation", meta = (ClampMin = "1"))
+	int32 ArcLengthSamplesPerSegment = 16;
+
+	// Load generated geometry from Saved/BuildingCache when nothing has changed, and write it there after full builds
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Generation")
+	bool bUseGeometryCache = true;
+
+	// Generate geometry on task graph workers and upload it once finished, instead of blocking the game thread
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Generation")
+	bool bAsyncGeneration = true;
+
+	// Generate each distinct floor once per rebuild and copy it, raised, to every floor that repeats it
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Generation")
+	bool bRepeatFloors = true;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Collision")
+	EBuildingCollisionMode CollisionMode = EBuildingCollisionMode::Simplified;
+
+	// Depth of the wall boxes and the fill slabs
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Collision", meta = (ClampMin = "1", EditCondition = "CollisionMode == EBuildingCollisionMode::Simplified"))
+	float CollisionThickness = 40.0f;
+
+	// Sections with these materials keep per-triangle collision for complex traces, e.g. railings that must block shots
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Collision", meta = (EditCondition = "CollisionMode == EBuildingCollisionMode::Simplified"))
+	TArray<UMaterialInterface*> ComplexCollisionMaterials;
+
+	// Upload every slot whose final material is in BatchLayerMaterials as one section drawn with BatchedMaterial
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Batching")
+	bool bBatchMaterials = false;
+
+	// Samples a texture array or atlas by the layer in UV1.x, the index of the slot's material in BatchLayerMaterials
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Batching", meta = (EditCondition = "bBatchMaterials"))
+	UMaterialInterface* BatchedMaterial = nullptr;
+
+	// Materials BatchedMaterial can stand in for, after the Materials remap; anything else keeps its own section
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Batching", meta = (EditCondition = "bBatchMaterials"))
+	TArray<UMaterialInterface*> BatchLayerMaterials;
+
+	// Weld seam vertices, drop degenerate triangles and reorder each chunk for the GPU vertex caches before upload
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Generation")
+	bool bOptimizeMeshes = false;
+
+	// Vertices closer than this with matching normal, tangent and UV are merged
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Generation", meta = (ClampMin = "0", EditCondition = "bOptimizeMeshes"))
+	float WeldTolerance = 0.05f;
+
+	// Vertices of the chunks regenerated by the last rebuild, before and after optimizing
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Building|Stats")
+	int32 OptimizeVerticesBefore = 0;
+
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Building|Stats")
+	int32 OptimizeVerticesAfter = 0;
+
+	// Average vertices transformed per triangle with a 16 entry FIFO cache, before and after optimizing
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Building|Stats")
+	float OptimizeACMRBefore = 0.0f;
+
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Building|Stats")
+	float OptimizeACMRAfter = 0.0f;
+
+	// Swap the merged walls for cheaper meshes as the building shrinks on screen; instanced mode uses the part meshes' own LODs
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|LOD")
+	bool bGenerateLODs = false;
+
+	// LOD of the part meshes the mid LOD is built from; parts with fewer LODs use their last one
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|LOD", meta = (ClampMin = "1", EditCondition = "bGenerateLODs"))
+	int32 LODPartLevel = 1;
+
+	// Screen size, bounds diameter over screen height, below which the mid LOD is drawn
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|LOD", meta = (ClampMin = "0.001", ClampMax = "2", EditCondition = "bGenerateLODs"))
+	float MidLODScreenSize = 0.5f;
+
+	// Screen size below which one box per segment per floor is drawn with FarFacadeMaterial
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|LOD", meta = (ClampMin = "0.001", ClampMax = "2", EditCondition = "bGenerateLODs"))
+	float FarLODScreenSize = 0.15f;
+
+	// Facade texture baked from the walls; V spans one floor, U repeats every FacadeTileLength
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|LOD", meta = (EditCondition = "bGenerateLODs"))
+	UMaterialInterface* FarFacadeMaterial = nullptr;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|LOD", meta = (ClampMin = "1", EditCondition = "bGenerateLODs"))
+	float FacadeTileLength = 400.0f;
+
+	// Triangles of the mid and far LOD meshes, next to TriangleCount for LOD0
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Building|Stats")
+	int32 MidLODTriangleCount = 0;
+
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Building|Stats")
+	int32 FarLODTriangleCount = 0;
+
+	// In the editor, edits arriving faster than PreviewSettleSeconds apart only show placement boxes until they stop
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Editor")
+	bool bInteractivePreview = true;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Editor", meta = (ClampMin = "0", EditCondition = "bInteractivePreview"))
+	float PreviewSettleSeconds = 0.3f;
+
+	// Place cover points along the ground floor walls, registered with UCoverPointSubsystem when play begins
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Cover")
+	bool bGenerateCover = true;
+
+	// Distance between cover points along a wall; every piece gets at least one
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Cover", meta = (ClampMin = "10", EditCondition = "bGenerateCover"))
+	float CoverSpacing = 150.0f;
+
+	// How far out from the wall the points stand, about a capsule radius
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|Cover", meta = (ClampMin = "0", EditCondition = "bGenerateCover"))
+	float CoverOffset = 60.0f;
+
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Building|Stats")
+	int32 CoverPointCount = 0;
+
 public:	
 	// Sets default values for this actor's properties
 	ABuilding();
 
 	virtual ~ABuilding();
 
+	virtual void BeginDestroy() override;
+
+	// Rebuilds with the current settings; FromScratch discards all generated geometry first
+	void Regenerate(bool bFromScratch);
+
+	// Regenerates the whole building synchronously and writes it to the geometry cache
+	void WarmGeometryCache();
+
+	const FBuildingTimings& GetTimings() const { return Timings; }
+
+	// Estimated memory of what is uploaded in the active mode
+	int64 GetCountedBytes() const { return CountedBytes; }
+
+	// When set, finished asynchronous builds wait for ApplyPendingUpload instead of uploading as soon as they arrive
+	void SetUploadScheduled(bool bScheduled) { bUploadScheduled = bScheduled; }
+
+	// An asynchronous build is running on the workers
+	bool IsGenerating() const { return bBuildInFlight; }
+
+	bool HasPendingUpload() const { return PendingUpload.IsValid(); }
+
+	// Uploads the finished build held back by SetUploadScheduled, if any
+	void ApplyPendingUpload();
+
+	// In building space; outward facing only when the footprint is a closed loop
+	const TArray<FCoverPoint>& GetCoverPoints() const { return CoverPoints; }
+
 
 protected:
 	virtual void OnConstruction(const FTransform& Transform);
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+	virtual void PostEditMove(bool bFinished) override;
+#endif
+	virtual bool ShouldTickIfViewportsOnly() const override;
+
+	// One box per pattern item, no materials, tangents or fill; replaces the building until EndPreview
+	void CreatePreview();
+	void EndPreview();
 
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	void CreateBlankData();
 	void CreateMesh();
 
+	static uint32 GetPatternKey(const FBuildingSection& Section);
+	FBuildingLayoutPtr FindLayout(TMap<uint32, FBuildingLayoutPtr>& Layouts, const FBuildingParts& Parts, const FBuildingSection& Section, int BuildingSection) const;
+	FBuildingLayoutPtr LayoutSegment(const FBuildingParts& Parts, const FBuildingSection& Section, int BuildingSection) const;
+	// Generates Build on the workers when asynchronous, then applies it
+	void StartBuild(const TSharedRef<FBuildingBuild, ESPMode::ThreadSafe>& Build);
+	void ApplyBuild(FBuildingBuild& Build);
+	// Adds a mid LOD job for every chunk whose LOD is out of date
+	void AddLODJobs(FBuildingBuild& Build, TMap<uint32, FBuildingLayoutPtr>& Layouts, const TArray<uint32>& ChunkKeys, const TArray<float>& HeightOffsets);
+	void ApplyLODs(FBuildingBuild& Build);
+	void CreateFarLOD(float TotalHeight);
+	void UpdateLODDistances();
+	UProceduralMeshComponent* CreateLODComponent(FName Name);
+	void DestroyLODComponents();
+	void ApplyMaterials();
+	UMaterialInterface* GetFinalMaterial(int Slot) const;
+	// Fills the batch layer of each slot, INDEX_NONE for slots drawn on their own. Returns the section batched slots upload into.
+	int GetBatchLayers(TArray<int32>& OutLayers) const;
+	FSHAHash GetGeometryCacheKey(const TArray<uint32>& ChunkKeys, uint32 InFillKey) const;
+	void CreateInstances(const FBuildingParts& Parts, const TArray<uint32>& SegmentKeys);
+	void UpdateInstanceComponents();
+	void DestroyInstanceComponents();
+	void CreateFill(float HeightOffset);
+	bool HasSectionCollision(int Section) const;
+	// Frame of a segment's chord, with the extent of the spline samples along it, across it and down from its start
+	bool GetSegmentBounds(int BuildingSection, FVector& OutStart, FVector& OutAlong, FVector& OutAcross, FBox& OutExtent) const;
+	// Wall boxes leave door placements open, so characters and the navmesh can pass through them
+	void UpdateCollision(const FBuildingParts& Parts, float TotalHeight, bool bWalls);
+	void CreateTriangulatedFill(TArray<FVector>& Vertices, TArray<int32>& BottomTriangles, TArray<int32>& TopTriangles) const;
+	void CreateGridFill(TArray<FVector>& Vertices, TArray<int32>& BottomTriangles, TArray<int32>& TopTriangles) const;
+	// Lays out the ground floor again when its walls changed and places cover points along it
+	void UpdateCoverPoints(const FBuildingParts& Parts, const TArray<uint32>& SegmentKeys);
+	// Hands the cover points to UCoverPointSubsystem in world space; only in game worlds
+	void RegisterCoverPoints();
+
+	// Thread safe; return false once Build has been superseded by a newer one
+	static bool GenerateChunks(FBuildingBuild& Build, const FThreadSafeCounter& LatestSerial);
+	static int CreateChunk(FBuildingChunk& Chunk, const FBuildingParts& Parts, const FBuildingChunkJob& Job, int SlotCount, BuildingOptimize::FStats& Stats);
+	static int RepeatChunk(FBuildingChunk& Chunk, const FBuildingChunk& Source, float ZOffset);
+	// Points every job at the first one with the same layout and floor height. Returns how many repeat another.
+	static int LinkRepeatedJobs(TArray<FBuildingChunkJob>& Jobs);
+
+	// Replaces this building's share of the stat Building counters
+	void SetCounters(int64 Vertices, int64 Triangles, int32 InDrawCalls, int64 Bytes);
+
+	int GetBuildingSectionCount() const;
+	uint32 GetMeshTypesKey() const;
+	uint32 GetSegmentKey(int BuildingSection) const;
+	uint32 GetFillKey(float HeightOffset) const;
+
+private:
+	// One per MeshTypes entry in instanced mode
+	UPROPERTY()
+	TArray<class UHierarchicalInstancedStaticMeshComponent*> InstanceComponents;
+
+	// Materials of all MeshTypes, in mesh section order
+	UPROPERTY(Transient)
+	TArray<UMaterialInterface*> MaterialSlots;
+
+	// Created while bGenerateLODs is set in merged mode
+	UPROPERTY()
+	class UProceduralMeshComponent* MidLODComponent = nullptr;
+
+	UPROPERTY()
+	class UProceduralMeshComponent* FarLODComponent = nullptr;
+
+	UPROPERTY(Transient)
+	class UProceduralMeshComponent* PreviewComponent = nullptr;
+
+	// Floors.Num() * ChunkSections chunks, floor major
+	TArray<FBuildingChunk> Chunks;
+	// Mid LOD of each chunk, keyed by the chunk key and the LOD parts
+	TArray<FBuildingChunk> LODChunks;
+	uint32 MidLODKey = 0;
+	uint32 FarLODKey = 0;
+	int ChunkSections = 0;
+	uint32 MeshTypesKey = 0;
+	uint32 FillKey = 0;
+
+	// Sampled spline, rebuilt whenever any segment changes
+	FBuildingArcLengthTable ArcLengths;
+	uint32 ArcLengthKey = 0;
+
+	// Hash of what the simple collision was built from
+	uint32 CollisionKey = 0;
+
+	// Saved with the building, so cooked levels have them without rebuilding
+	UPROPERTY()
+	TArray<FCoverPoint> CoverPoints;
+	uint32 CoverKey = 0;
+
+	// Set when the section layout changed and the uploaded sections no longer match MaterialSlots
+	bool bSectionsStale = false;
+
+	// Sections that lost geometry to builds not applied yet
+	TBitArray<> PendingMaterials;
+
+	// Reused to assemble each uploaded section
+	TMesh UploadMesh;
+	TArray<FVector2D> UploadLayers;
+
+	FBuildingTimings Timings;
+	int64 CountedBytes = 0;
+	bool bCounted = false;
+
+	bool bUploadScheduled = false;
+	bool bBuildInFlight = false;
+
+	// Time of the last construction in the editor, and whether the preview is standing in for the building
+	double LastEditTime = 0.0;
+	bool bPreviewActive = false;
+	// A drag is in progress according to the editor
+	bool bInteractiveEdit = false;
+	TSharedPtr<FBuildingBuild, ESPMode::ThreadSafe> PendingUpload;
+
+	// Serial of the newest build; in-flight builds with an older serial are abandoned
+	TSharedRef<FThreadSafeCounter, ESPMode::ThreadSafe> BuildSerial = MakeShared<FThreadSafeCounter, ESPMode::ThreadSafe>();
+
 public:	
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
@@ -0,0 +1,24 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "BuildingBenchmarkCommandlet.generated.h"
+
+/**
+ * Times ABuilding generation on synthetic buildings and writes the results as JSON. Needs no GPU:
+ * -run=BuildingBenchmark -nullrhi [-Output=Saved/BuildingBenchmark.json] [-Iterations=5]
+ *     [-Segments=4,16,64] [-Floors=1,8] [-Pattern=1,4] [-Closed=1,0] [-Fill=0,1] [-Modes=Merged,Instanced] [-Tessellation=4]
+ * Every combination of the listed values is one case.
+ */
+UCLASS()
+class FANTASY_API UBuildingBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UBuildingBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,22 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "BuildingCacheCommandlet.generated.h"
+
+/**
+ * Generates every ABuilding in a map and writes it to the building geometry cache.
+ * Usage: -run=BuildingCache -Map=/Game/Map/Main
+ */
+UCLASS()
+class FANTASY_API UBuildingCacheCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UBuildingCacheCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,149 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Engine/DataTable.h"
+#include "Building.h"
+#include "BuildingDistrictSubsystem.generated.h"
+
+// Everything but the footprint of a building, shared by every request naming it
+USTRUCT(BlueprintType) struct FBuildingPresetRow : public FTableRowBase {
+	GENERATED_BODY();
+
+	// A floor with fewer sections than the footprint has segments repeats its sections around the building
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	TArray<FFloorType> Floors;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	TArray<FMeshData> MeshTypes;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	TMap<UMaterialInterface*, UMaterialInterface*> Materials;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool FillBottom = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	UMaterialInterface* BottomMaterial = nullptr;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool FillTop = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	UMaterialInterface* TopMaterial = nullptr;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float TopSink = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	EBuildingOutputMode OutputMode = EBuildingOutputMode::Merged;
+};
+
+// One building to place: a footprint and the preset to build on it. Also usable as a data table row.
+USTRUCT(BlueprintType) struct FBuildingRequest : public FTableRowBase {
+	GENERATED_BODY();
+
+	// Row of the preset table
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FName Preset;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FTransform Transform;
+
+	// Footprint corners relative to Transform, joined by straight walls
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	TArray<FVector> Points;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bClosedLoop = true;
+};
+
+USTRUCT() struct FBuildingDistrictEntry {
+	GENERATED_BODY();
+
+	UPROPERTY()
+	FBuildingRequest Request;
+
+	UPROPERTY()
+	const UDataTable* Presets = nullptr;
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FBuildingDistrictProgress, int32, Completed, int32, Total);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FBuildingDistrictComplete);
+
+/**
+ * Spawns queued buildings a few at a time, nearest to the camera first.
+ * Chunk generation runs on the workers; spawning, layout and mesh upload are time sliced against FrameBudgetMs.
+ */
+UCLASS()
+class FANTASY_API UBuildingDistrictSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// Game thread time spent per frame on spawning and uploading; at least one step runs every frame while busy
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|District", meta = (ClampMin = "0.1"))
+	float FrameBudgetMs = 4.0f;
+
+	// Buildings generating on the workers or waiting for upload at once
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building|District", meta = (ClampMin = "1"))
+	int32 MaxBuildsInFlight = 32;
+
+	// Called whenever buildings finish, with the counts of the current batch
+	UPROPERTY(BlueprintAssignable, Category = "Building|District")
+	FBuildingDistrictProgress OnProgress;
+
+	// Called once everything queued so far is built
+	UPROPERTY(BlueprintAssignable, Category = "Building|District")
+	FBuildingDistrictComplete OnComplete;
+
+	// Returns the number of requests queued
+	UFUNCTION(BlueprintCallable, Category = "Building|District")
+	int32 QueueBuildings(const TArray<FBuildingRequest>& Requests, const UDataTable* Presets);
+
+	// Queues every row of a table of FBuildingRequest rows
+	UFUNCTION(BlueprintCallable, Category = "Building|District")
+	int32 QueueFootprintTable(const UDataTable* Footprints, const UDataTable* Presets);
+
+	/**
+	 * Queues the buildings of a JSON footprint file:
+	 * { "buildings": [ { "preset": "Row", "location": [x, y, z], "yaw": 0, "closed": true, "points": [[x, y], [x, y, z], ...] } ] }
+	 * Returns the number queued, or -1 if the file could not be read.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Building|District")
+	int32 QueueFootprintFile(const FString& Path, const UDataTable* Presets);
+
+	// Drops queued requests; buildings already spawned are kept
+	UFUNCTION(BlueprintCallable, Category = "Building|District")
+	void CancelQueued();
+
+	UFUNCTION(BlueprintPure, Category = "Building|District")
+	float GetProgress() const;
+
+	UFUNCTION(BlueprintPure, Category = "Building|District")
+	bool IsBusy() const { return Queued.Num() > 0 || InFlight.Num() > 0; }
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	ABuilding* SpawnBuilding(const FBuildingDistrictEntry& Entry);
+	static void ApplyPreset(ABuilding& Building, const FBuildingPresetRow& Preset, int Segments);
+	bool GetViewLocation(FVector& OutLocation) const;
+	void FinishBuilding(ABuilding* Building);
+
+private:
+	UPROPERTY()
+	TArray<FBuildingDistrictEntry> Queued;
+
+	// Spawned, still generating or waiting for upload
+	TArray<TWeakObjectPtr<ABuilding>> InFlight;
+
+	// Presets whose part meshes have been decoded already
+	TSet<TPair<const UDataTable*, FName>> WarmedPresets;
+
+	int32 Completed = 0;
+	int32 Total = 0;
+};
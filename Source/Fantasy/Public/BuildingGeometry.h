@@ -0,0 +1,219 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralMeshComponent.h"
+#include "BuildingPartCache.h"
+#include "Misc/SecureHash.h"
+#include "BuildingCoreFill.h"
+#include "BuildingCoreLayout.h"
+
+// The geometry itself lives in the BuildingCore module and works in place on engine buffers
+static_assert(sizeof(FVector) == sizeof(BuildingCore::FVec3), "BuildingCore expects single precision FVector");
+static_assert(sizeof(FVector2D) == sizeof(BuildingCore::FVec2), "BuildingCore expects single precision FVector2D");
+static_assert(sizeof(FMatrix) == sizeof(BuildingCore::FMatrix44), "BuildingCore expects single precision FMatrix");
+static_assert(sizeof(FProcMeshTangent) == sizeof(BuildingCore::FTangent)
+	&& STRUCT_OFFSET(FProcMeshTangent, bFlipTangentY) == STRUCT_OFFSET(BuildingCore::FTangent, bFlipTangentY),
+	"BuildingCore::FTangent must match FProcMeshTangent");
+
+namespace BuildingCore {
+	FORCEINLINE const FVec3* ToCore(const FVector* In) { return reinterpret_cast<const FVec3*>(In); }
+	FORCEINLINE FVec3* ToCore(FVector* In) { return reinterpret_cast<FVec3*>(In); }
+	FORCEINLINE const FVec2* ToCore(const FVector2D* In) { return reinterpret_cast<const FVec2*>(In); }
+	FORCEINLINE FVec2* ToCore(FVector2D* In) { return reinterpret_cast<FVec2*>(In); }
+	FORCEINLINE FTangent* ToCore(FProcMeshTangent* In) { return reinterpret_cast<FTangent*>(In); }
+	FORCEINLINE const FMatrix44& ToCore(const FMatrix& In) { return reinterpret_cast<const FMatrix44&>(In); }
+
+	FORCEINLINE FVector ToVector(const FVec3& In) { return FVector(In.X, In.Y, In.Z); }
+	FORCEINLINE FRotator GetRotation(const FPlacement& Placement) { return FRotator(Placement.Pitch, Placement.Yaw, 0.0f); }
+}
+
+struct TMesh {
+	TArray<FVector> vertices;
+	TArray<int32> tris;
+	TArray<FVector2D> uvs;
+	TArray<FVector> normals;
+	TArray<FProcMeshTangent> tangents;
+	int triangleCount = 0;
+
+	void Append(const TMesh& Other);
+
+	// Sizes every buffer to exactly these counts, keeping existing capacity. Returns how many buffers had to allocate.
+	int Presize(int VertexCount, int IndexCount);
+
+	// Becomes a copy of Other moved up by ZOffset, keeping existing capacity. Returns how many buffers had to allocate.
+	int CopyRaised(const TMesh& Other, float ZOffset);
+};
+
+// Geometry of one spline segment on one floor, kept between rebuilds
+struct FBuildingChunk {
+	// Hash of everything the chunk was generated from
+	uint32 Key = 0;
+	bool bValid = false;
+
+	// Pattern items placed in the chunk
+	int Placements = 0;
+
+	// One mesh per entry in ABuilding::MaterialSlots
+	TArray<TMesh> Meshes;
+};
+
+// Part geometry of each MeshTypes entry and the material slot of each of its sections, resolved once per rebuild
+struct FBuildingParts {
+	TArray<FBuildingPartPtr> Parts;
+	TArray<TArray<int>> SectionSlots;
+	TArray<float> Lengths;
+	TArray<float> Heights;
+
+	// What BuildingCore lays out and emits, pointing into Parts; filled by BuildViews
+	std::vector<BuildingCore::FPartView> Views;
+
+	// Call once Parts, SectionSlots, Lengths and Heights are set. Missing slots leave their section out.
+	void BuildViews();
+};
+
+// Spline positions sampled evenly in input key and indexed by distance, so layout never has to query the spline
+struct FBuildingArcLengthTable {
+	int SamplesPerSegment = 16;
+
+	// Distance along the spline of every sample
+	TArray<float> Distances;
+	TArray<FVector> Locations;
+
+	void Build(const class USplineComponent& Spline, int Segments, int InSamplesPerSegment);
+
+	BuildingCore::FArcLengthView GetView() const;
+
+	float GetDistanceAtSplinePoint(int Point) const;
+
+	// Clamped to the ends of the spline, like USplineComponent::GetLocationAtDistanceAlongSpline
+	FVector GetLocationAtDistance(float Distance) const;
+};
+
+// The pattern of one segment laid out along the spline; the same for every floor that uses the pattern
+typedef BuildingCore::FLayout FBuildingLayout;
+
+typedef TSharedPtr<const FBuildingLayout, ESPMode::ThreadSafe> FBuildingLayoutPtr;
+
+// Optional cleanup of generated chunk meshes before upload, run on the workers with the generation
+namespace BuildingOptimize {
+	// Post-transform cache modelled when measuring ACMR (FIFO)
+	constexpr int32 MeasureCacheSize = 16;
+
+	struct FStats {
+		int32 VerticesBefore = 0;
+		int32 VerticesAfter = 0;
+		int32 TrianglesBefore = 0;
+		int32 TrianglesAfter = 0;
+		int32 CacheMissesBefore = 0;
+		int32 CacheMissesAfter = 0;
+
+		FStats& operator+=(const FStats& Other);
+	};
+
+	// Weld, drop degenerates, then reorder triangles and vertices for the post-transform and pre-transform caches
+	void Optimize(TMesh& Mesh, float WeldTolerance, FStats& Stats);
+
+	// Merges vertices closer than Tolerance whose normal, tangent and UV match. Returns the number removed.
+	int32 WeldVertices(TMesh& Mesh, float Tolerance);
+
+	// Drops triangles with a repeated index or no area. Returns the number removed.
+	int32 RemoveDegenerateTriangles(TMesh& Mesh);
+
+	// Forsyth's linear-speed vertex cache optimisation
+	void OptimizeTriangleOrder(TArray<int32>& Indices, int32 VertexCount);
+
+	// Renumbers vertices in order of first use and drops unused ones
+	void OptimizeVertexOrder(TMesh& Mesh);
+
+	// Vertices transformed by a FIFO post-transform cache of CacheSize entries; divide by triangles for ACMR
+	int32 CountCacheMisses(const TArray<int32>& Indices, int32 CacheSize = MeasureCacheSize);
+}
+
+// Everything needed to generate one chunk without touching the actor
+struct FBuildingChunkJob {
+	int Chunk = 0;
+	uint32 Key = 0;
+	float HeightOffset = 0.0f;
+	float FloorHeight = 0.0f;
+	FBuildingLayoutPtr Layout;
+
+	bool bOptimize = false;
+	float WeldTolerance = 0.0f;
+
+	// Earlier job of the same list this chunk repeats on another floor; its result is copied instead of generated
+	int SourceJob = INDEX_NONE;
+};
+
+// A rebuild of the chunks that changed, handed from the game thread to the workers and back
+struct FBuildingBuild {
+	int32 Serial = 0;
+	FBuildingParts Parts;
+	int SlotCount = 0;
+	float TotalHeight = 0.0f;
+	int SegmentsReused = 0;
+	int SegmentsRepeated = 0;
+
+	// Every chunk is regenerated; the result is written to the geometry cache under CacheKey
+	bool bFullBuild = false;
+	FSHAHash CacheKey;
+
+	TArray<FBuildingChunkJob> Jobs;
+	// One per job, starting out with the buffers of the chunk it replaces
+	TArray<FBuildingChunk> Results;
+
+	// Mid LOD chunks, built from a lower LOD of the same parts into the same slots
+	FBuildingParts LODParts;
+	TArray<FBuildingChunkJob> LODJobs;
+	TArray<FBuildingChunk> LODResults;
+	// Only LOD jobs; the uploaded LOD0 geometry stays as it is
+	bool bLODOnly = false;
+
+	// Buffers that had to grow while generating
+	FThreadSafeCounter Allocations;
+
+	// One per job when optimizing, LOD jobs after the others
+	TArray<BuildingOptimize::FStats> OptimizeStats;
+
+	double GenerateSeconds = 0.0;
+};
+
+// Wall time of each phase of the last rebuild, in seconds
+struct FBuildingTimings {
+	// Resolving part geometry, keys and the arc-length table
+	double Parts = 0.0;
+	double Layout = 0.0;
+	// Emitting chunk geometry, on the workers when generating asynchronously
+	double Generate = 0.0;
+	// Mesh sections or instances handed to the components
+	double Upload = 0.0;
+	double Fill = 0.0;
+
+	double GetTotal() const { return Parts + Layout + Generate + Upload + Fill; }
+};
+
+// Rough memory cost of a building in each output mode, CPU and GPU copies together
+namespace BuildingMemory {
+	// Procedural mesh sections: FProcMeshVertex on the CPU, a packed vertex on the GPU, 32 bit indices on both
+	int64 GetMergedBytes(int64 Vertices, int64 Indices);
+
+	// Instance transforms on the CPU and in the GPU instance buffer; the part meshes are shared by every building
+	int64 GetInstancedBytes(int64 Instances);
+}
+
+// Roof and floor fill of the building footprint, on engine arrays (see BuildingCoreFill.h)
+namespace BuildingFill {
+	// Drops repeated and nearly collinear points of a closed outline
+	void SimplifyPolygon(TArray<FVector2D>& Polygon, float Tolerance);
+
+	// Ear clipping. Whatever the outline's orientation the triangles face +Z (clockwise seen from above).
+	// Returns false for degenerate or self-intersecting outlines.
+	bool TriangulatePolygon(const TArray<FVector2D>& Polygon, TArray<int32>& OutTriangles);
+
+	// Splits every triangle into four Levels times, appending the edge midpoints to Points
+	void SubdividePolygon(TArray<FVector2D>& Points, TArray<int32>& Triangles, int Levels);
+
+	// Counter-clockwise convex hull of Points (monotone chain)
+	void ConvexHull(const TArray<FVector2D>& Points, TArray<FVector2D>& OutHull);
+}
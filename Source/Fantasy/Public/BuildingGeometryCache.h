@@ -0,0 +1,44 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Misc/SecureHash.h"
+
+class UProceduralMeshComponent;
+
+/**
+ * On-disk cache of generated building sections, keyed by a hash of everything the geometry was generated from.
+ * Sections are stored as raw FProcMeshVertex and index arrays so a hit maps the file and copies each section in one go.
+ * Every edit produces a new key, so Save evicts the least recently used files beyond Building.GeometryCacheMaxMB.
+ */
+class FANTASY_API FBuildingGeometryCache {
+public:
+	// Bump whenever generation changes its output for the same inputs
+	static const uint32 FormatVersion;
+
+	static FString GetDirectory();
+	static FString GetPath(const FSHAHash& Key);
+
+	// Replaces the first SectionCount sections of Mesh with the cached ones, cooking collision for the set bits of CollisionSections.
+	// False on a miss or an unreadable file.
+	static bool Load(const FSHAHash& Key, UProceduralMeshComponent& Mesh, int SectionCount, const TBitArray<>& CollisionSections);
+
+	// Writes the first SectionCount sections of Mesh in the background, then trims the cache to its size limit
+	static void Save(const FSHAHash& Key, UProceduralMeshComponent& Mesh, int SectionCount);
+
+	// Deletes the least recently loaded or saved files until the cache takes at most MaxBytes. Returns how many went.
+	static int32 Trim(int64 MaxBytes);
+
+	// Building.GeometryCacheMaxMB in bytes
+	static int64 GetMaxSize();
+
+	// Blocks until every background write started by Save has finished
+	static void Flush();
+
+private:
+	static FThreadSafeCounter PendingWrites;
+	// Non-zero while a background write is trimming, so concurrent writes do not all scan the directory
+	static FThreadSafeCounter Trimming;
+};
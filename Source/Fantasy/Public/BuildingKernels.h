@@ -0,0 +1,22 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FProcMeshTangent;
+
+/**
+ * Batch vertex transforms used to place part meshes along a building, on engine types.
+ * Forwards to BuildingCoreKernels.h; In and Out may be the same array.
+ */
+namespace BuildingKernels {
+	// Out[i] = Matrix.TransformPosition(In[i])
+	FANTASY_API void TransformPositions(const FMatrix& Matrix, const FVector* In, FVector* Out, int32 Num);
+
+	// Out[i] = Matrix.TransformVector(In[i])
+	FANTASY_API void TransformVectors(const FMatrix& Matrix, const FVector* In, FVector* Out, int32 Num);
+
+	// Out[i] = FProcMeshTangent(Matrix.TransformVector(In[i]), false)
+	FANTASY_API void TransformTangents(const FMatrix& Matrix, const FVector* In, FProcMeshTangent* Out, int32 Num);
+}
@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectKey.h"
+
+class UStaticMesh;
+class UMaterialInterface;
+struct FStaticMeshRenderData;
+
+// One material section of a part mesh LOD, in structure-of-arrays layout
+struct FBuildingPartSection {
+	UMaterialInterface* Material = nullptr;
+
+	TArray<FVector> Positions;
+	TArray<FVector2D> UVs;
+	TArray<FVector> TangentZ;
+	TArray<FVector> TangentX;
+
+	// Relative to the first vertex of this section
+	TArray<int32> Indices;
+};
+
+struct FBuildingPart {
+	// Hash of the extracted geometry; changes when the mesh is reimported and stays the same across runs
+	uint32 Version = 0;
+
+	TArray<FBuildingPartSection> Sections;
+};
+
+typedef TSharedPtr<const FBuildingPart, ESPMode::ThreadSafe> FBuildingPartPtr;
+
+/**
+ * Process-wide cache of the render geometry of building part meshes.
+ * Each UStaticMesh is decoded once and shared by every ABuilding.
+ */
+class FANTASY_API FBuildingPartCache {
+public:
+	static FBuildingPartCache& Get();
+
+	// Returns the geometry of one LOD of StaticMesh, extracting it on first use. LODs past the last one return the last one.
+	// Game thread only.
+	FBuildingPartPtr Find(const UStaticMesh* StaticMesh, int32 LODIndex = 0);
+
+	// Makes Find return Part for StaticMesh instead of extracting it, e.g. for generated meshes without render data
+	void Register(const UStaticMesh* StaticMesh, FBuildingPartPtr Part);
+
+	void Invalidate(const UStaticMesh* StaticMesh);
+	void Empty();
+
+private:
+	FBuildingPartCache();
+	~FBuildingPartCache();
+
+	static FBuildingPartPtr Extract(const UStaticMesh* StaticMesh, int32 LODIndex);
+
+#if WITH_EDITOR
+	void OnObjectPropertyChanged(UObject* Object, struct FPropertyChangedEvent& Event);
+	FDelegateHandle PropertyChangedHandle;
+#endif
+
+	struct FEntry {
+		// Render data the part was extracted from; rebuilding the mesh replaces it
+		const FStaticMeshRenderData* RenderData = nullptr;
+		// Indexed by LOD, extracted as they are asked for
+		TArray<FBuildingPartPtr> LODs;
+		// Registered rather than extracted
+		bool bRegistered = false;
+	};
+
+	FCriticalSection Lock;
+	TMap<TObjectKey<UStaticMesh>, FEntry> Entries;
+};
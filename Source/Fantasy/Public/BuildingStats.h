@@ -0,0 +1,25 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "FantasyStats.h"
+
+// stat Building
+DECLARE_STATS_GROUP(TEXT("Building"), STATGROUP_Building, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("CreateMesh"), STAT_BuildingCreateMesh, STATGROUP_Building, FANTASY_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Pattern layout"), STAT_BuildingLayout, STATGROUP_Building, FANTASY_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Vertex emission"), STAT_BuildingEmit, STATGROUP_Building, FANTASY_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Floor repeat"), STAT_BuildingRepeat, STATGROUP_Building, FANTASY_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Cover points"), STAT_BuildingCover, STATGROUP_Building, FANTASY_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Section assembly"), STAT_BuildingAssemble, STATGROUP_Building, FANTASY_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Fill grid classification"), STAT_BuildingFillClassify, STATGROUP_Building, FANTASY_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Fill triangulation"), STAT_BuildingFillTriangulate, STATGROUP_Building, FANTASY_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Section upload"), STAT_BuildingUpload, STATGROUP_Building, FANTASY_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("LOD upload"), STAT_BuildingLODUpload, STATGROUP_Building, FANTASY_API);
+
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Buildings"), STAT_BuildingCount, STATGROUP_Building, FANTASY_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Vertices"), STAT_BuildingVertices, STATGROUP_Building, FANTASY_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Triangles"), STAT_BuildingTriangles, STATGROUP_Building, FANTASY_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Draw calls"), STAT_BuildingDrawCalls, STATGROUP_Building, FANTASY_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Mesh memory"), STAT_BuildingMemory, STATGROUP_Building, FANTASY_API);
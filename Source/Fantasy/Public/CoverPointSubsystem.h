@@ -0,0 +1,86 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CoverPointSubsystem.generated.h"
+
+class ABuilding;
+
+UENUM(BlueprintType)
+enum class ECoverHeight : uint8 {
+	// An opening, e.g. a doorway; no cover but a way through
+	None,
+	// Crouching cover, e.g. under a window
+	Low,
+	High
+};
+
+// A spot next to a wall, facing away from it
+USTRUCT(BlueprintType) struct FCoverPoint {
+	GENERATED_BODY();
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FVector Location = FVector::ZeroVector;
+
+	// Horizontal, pointing from the wall to Location
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FVector Normal = FVector::ForwardVector;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	ECoverHeight Height = ECoverHeight::High;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bWindow = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bDoor = false;
+
+	// The wall is between Location and Threat
+	bool IsCoveredFrom(const FVector& Threat) const { return FVector::DotProduct(Normal, Threat - Location) < 0.0f; }
+};
+
+/**
+ * World-space index of the cover points every ABuilding generates with its walls.
+ * Buildings register on BeginPlay; the grid is rebuilt on the next query after any of them registers or leaves.
+ */
+UCLASS()
+class FANTASY_API UCoverPointSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// Edge of a grid cell on the ground plane
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Cover", meta = (ClampMin = "100"))
+	float CellSize = 1000.0f;
+
+	// Replaces whatever Building registered before; Points are in world space
+	void RegisterBuilding(const ABuilding* Building, const TArray<FCoverPoint>& Points);
+	void UnregisterBuilding(const ABuilding* Building);
+
+	// Points within Radius of Origin at least MinHeight tall; openings are only included with bIncludeDoors
+	UFUNCTION(BlueprintCallable, Category = "AI|Cover")
+	int32 FindCoverPoints(const FVector& Origin, float Radius, ECoverHeight MinHeight, bool bIncludeDoors, TArray<FCoverPoint>& OutPoints);
+
+	// As FindCoverPoints, keeping only points with their wall between them and Threat
+	UFUNCTION(BlueprintCallable, Category = "AI|Cover")
+	int32 FindCoverPointsFrom(const FVector& Threat, const FVector& Origin, float Radius, ECoverHeight MinHeight, bool bIncludeDoors, TArray<FCoverPoint>& OutPoints);
+
+	UFUNCTION(BlueprintPure, Category = "AI|Cover")
+	int32 GetCoverPointCount() const { return PointCount; }
+
+protected:
+	FIntPoint GetCell(const FVector& Location) const;
+	void BuildGrid();
+	int32 Gather(const FVector& Origin, float Radius, ECoverHeight MinHeight, bool bIncludeDoors, const FVector* Threat, TArray<FCoverPoint>& OutPoints);
+
+private:
+	TMap<TWeakObjectPtr<const ABuilding>, TArray<FCoverPoint>> Buildings;
+	int32 PointCount = 0;
+
+	// Every registered point, and their indices by cell; rebuilt when dirty
+	TArray<FCoverPoint> Points;
+	TMap<FIntPoint, TArray<int32>> Grid;
+	bool bGridDirty = false;
+};
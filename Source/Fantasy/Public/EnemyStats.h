@@ -0,0 +1,31 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "FantasyStats.h"
+
+// stat EnemyAI
+DECLARE_STATS_GROUP(TEXT("EnemyAI"), STATGROUP_EnemyAI, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Significance update"), STAT_EnemySignificance, STATGROUP_EnemyAI, FANTASY_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Vision cones"), STAT_EnemyVision, STATGROUP_EnemyAI, FANTASY_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Targeting grid update"), STAT_TargetingGrid, STATGROUP_EnemyAI, FANTASY_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Targeting queries"), STAT_TargetingQuery, STATGROUP_EnemyAI, FANTASY_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Cover grid rebuild"), STAT_CoverGrid, STATGROUP_EnemyAI, FANTASY_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Cover queries"), STAT_CoverQuery, STATGROUP_EnemyAI, FANTASY_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Fight director"), STAT_FightDirector, STATGROUP_EnemyAI, FANTASY_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("High significance"), STAT_EnemySignificanceHigh, STATGROUP_EnemyAI, FANTASY_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Medium significance"), STAT_EnemySignificanceMedium, STATGROUP_EnemyAI, FANTASY_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Low significance"), STAT_EnemySignificanceLow, STATGROUP_EnemyAI, FANTASY_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Dormant"), STAT_EnemySignificanceDormant, STATGROUP_EnemyAI, FANTASY_API);
+DECLARE_FLOAT_COUNTER_STAT_EXTERN(TEXT("Ticks skipped per second"), STAT_EnemyTicksSkipped, STATGROUP_EnemyAI, FANTASY_API);
+DECLARE_FLOAT_COUNTER_STAT_EXTERN(TEXT("Estimated ms saved"), STAT_EnemyMsSaved, STATGROUP_EnemyAI, FANTASY_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Vision cone pairs tested"), STAT_EnemyVisionPairs, STATGROUP_EnemyAI, FANTASY_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Vision traces"), STAT_EnemyVisionTraces, STATGROUP_EnemyAI, FANTASY_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Sight listener updates"), STAT_EnemyListenerUpdates, STATGROUP_EnemyAI, FANTASY_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Targeting queries"), STAT_TargetingQueries, STATGROUP_EnemyAI, FANTASY_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Targeting cache hits"), STAT_TargetingCacheHits, STATGROUP_EnemyAI, FANTASY_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Targeting candidates"), STAT_TargetingCandidates, STATGROUP_EnemyAI, FANTASY_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Fight attackers"), STAT_FightAttackers, STATGROUP_EnemyAI, FANTASY_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Attack tokens held"), STAT_FightTokensHeld, STATGROUP_EnemyAI, FANTASY_API);
@@ -0,0 +1,42 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DataProviders/AIDataProvider.h"
+#include "EnvironmentQuery/Generators/EnvQueryGenerator_ProjectedPoints.h"
+#include "CoverPointSubsystem.h"
+#include "EnvQueryGenerator_CoverPoints.generated.h"
+
+/**
+ * Cover points from UCoverPointSubsystem around each context location, instead of sampling and tracing a grid.
+ * With a threat context only points whose wall stands between them and a threat are generated.
+ */
+UCLASS(meta = (DisplayName = "Cover Points"))
+class FANTASY_API UEnvQueryGenerator_CoverPoints : public UEnvQueryGenerator_ProjectedPoints
+{
+	GENERATED_BODY()
+
+public:
+	UEnvQueryGenerator_CoverPoints();
+
+	UPROPERTY(EditDefaultsOnly, Category = "Generator")
+	FAIDataProviderFloatValue SearchRadius;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Generator")
+	TSubclassOf<UEnvQueryContext> GenerateAround;
+
+	// Optional; points must be covered from every location of this context
+	UPROPERTY(EditDefaultsOnly, Category = "Generator")
+	TSubclassOf<UEnvQueryContext> Threat;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Generator")
+	ECoverHeight MinHeight = ECoverHeight::Low;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Generator")
+	bool bIncludeDoors = false;
+
+	virtual void GenerateItems(FEnvQueryInstance& QueryInstance) const override;
+	virtual FText GetDescriptionTitle() const override;
+	virtual FText GetDescriptionDetails() const override;
+};
@@ -0,0 +1,118 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "FightDirectorSubsystem.generated.h"
+
+class AAIController;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FAttackTokenChanged, AAIController*, Attacker, AActor*, Target, bool, bGranted);
+
+/**
+ * Decides which enemies may attack. Each target has MaxAttackersPerTarget tokens; once per frame free tokens go to
+ * the best scoring eligible enemies, by distance, priority and time spent waiting. Enemies are told when they gain or
+ * lose a token, through OnTokenChanged, the TokenKey blackboard bool and ACBaseEnemy_Controller::OnAttackTokenChanged,
+ * so nothing has to poll.
+ */
+UCLASS()
+class FANTASY_API UFightDirectorSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Fight", meta = (ClampMin = "0"))
+	int32 MaxAttackersPerTarget = 2;
+
+	// Enemies farther than this from their target do not get a token, and lose the one they hold
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Fight", meta = (ClampMin = "0"))
+	float MaxAttackDistance = 1500.0f;
+
+	// After giving a token back an enemy waits this long before it can get another
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Fight", meta = (ClampMin = "0"))
+	float TokenCooldown = 2.0f;
+
+	// Tokens not given back within this time are taken away; 0 keeps them until released
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Fight", meta = (ClampMin = "0"))
+	float MaxTokenTime = 6.0f;
+
+	// Score for standing on the target, falling to 0 at MaxAttackDistance
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Fight")
+	float DistanceWeight = 1.0f;
+
+	// Multiplies the priority an enemy registered with
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Fight")
+	float PriorityWeight = 1.0f;
+
+	// Score per second spent eligible without a token, so nobody waits forever
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Fight")
+	float WaitWeight = 0.25f;
+
+	// Blackboard bool kept equal to whether the enemy holds a token; a key the blackboard lacks is skipped
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Fight")
+	FName TokenKey = TEXT("HasAttackToken");
+
+	UPROPERTY(BlueprintAssignable, Category = "AI|Fight")
+	FAttackTokenChanged OnTokenChanged;
+
+	// Registering again only updates Priority
+	UFUNCTION(BlueprintCallable, Category = "AI|Fight")
+	void RegisterAttacker(AAIController* Controller, float Priority = 1.0f);
+
+	// Gives back any token held
+	UFUNCTION(BlueprintCallable, Category = "AI|Fight")
+	void UnregisterAttacker(AAIController* Controller);
+
+	// Who Controller wants to attack; null when it has no target. Changing target gives back the token.
+	UFUNCTION(BlueprintCallable, Category = "AI|Fight")
+	void SetAttackTarget(AAIController* Controller, AActor* Target);
+
+	// Ends Controller's attack and starts its cooldown
+	UFUNCTION(BlueprintCallable, Category = "AI|Fight")
+	void ReleaseToken(AAIController* Controller);
+
+	UFUNCTION(BlueprintPure, Category = "AI|Fight")
+	bool HasToken(const AAIController* Controller) const;
+
+	// Enemies currently holding a token for Target
+	UFUNCTION(BlueprintPure, Category = "AI|Fight")
+	int32 GetAttackerCount(const AActor* Target) const;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	struct FAttacker {
+		// Reset on unregister; the entry is removed on the next tick
+		TWeakObjectPtr<AAIController> Controller;
+		FObjectKey Key;
+		TWeakObjectPtr<AActor> Target;
+		float Priority = 1.0f;
+		bool bHasToken = false;
+		float TokenTime = 0.0f;
+		float CooldownUntil = 0.0f;
+		// When it last became eligible without a token; negative while not eligible
+		float WaitingSince = -1.0f;
+		float Score = 0.0f;
+	};
+
+	// Attackers of one target this frame, holders counted separately
+	struct FTargetSlots {
+		TArray<int32> Candidates;
+		int32 Holders = 0;
+	};
+
+	void SetToken(FAttacker& Attacker, bool bHasToken);
+	void RemoveAttackerAt(int32 Index);
+	FAttacker* FindAttacker(const AAIController* Controller);
+	const FAttacker* FindAttacker(const AAIController* Controller) const;
+
+private:
+	TArray<FAttacker> Attackers;
+	TMap<FObjectKey, int32> AttackerIndices;
+
+	// Kept between frames so the candidate arrays keep their allocations
+	TMap<TWeakObjectPtr<AActor>, FTargetSlots> Targets;
+};
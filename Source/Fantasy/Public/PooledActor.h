@@ -0,0 +1,33 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Interface.h"
+#include "PooledActor.generated.h"
+
+UINTERFACE(MinimalAPI, BlueprintType)
+class UPooledActor : public UInterface
+{
+	GENERATED_BODY()
+};
+
+/**
+ * Optional for actors handed out by UAbilityPoolSubsystem. BeginPlay runs once, when the instance is created,
+ * usually while prewarming at map start, parked out of sight; anything that has to happen on every cast belongs
+ * in OnAcquiredFromPool. A prewarmed instance is released right after BeginPlay, so it gets OnReleasedToPool
+ * before its first OnAcquiredFromPool.
+ */
+class FANTASY_API IPooledActor
+{
+	GENERATED_BODY()
+
+public:
+	// The actor is placed, visible and colliding again
+	UFUNCTION(BlueprintNativeEvent, BlueprintCallable, Category = "Ability|Pool")
+	void OnAcquiredFromPool();
+
+	// Called before the actor is hidden; timers and the life span are cleared after this
+	UFUNCTION(BlueprintNativeEvent, BlueprintCallable, Category = "Ability|Pool")
+	void OnReleasedToPool();
+};
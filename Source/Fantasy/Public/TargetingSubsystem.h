@@ -0,0 +1,159 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GenericTeamAgentInterface.h"
+#include "UObject/ObjectKey.h"
+#include "TargetingSubsystem.generated.h"
+
+class ABaseCharacter;
+
+UENUM(BlueprintType)
+enum class ETargetingTeamFilter : uint8 {
+	Any,
+	// Different team than the querier, per FGenericTeamId::GetAttitude
+	Hostile,
+	NotHostile
+};
+
+// What a targeting query looks for and how it ranks what it finds; higher scores come first
+USTRUCT(BlueprintType) struct FTargetingQuery {
+	GENERATED_BODY();
+
+	// Excluded from the results and used for the team filter; may be null
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	AActor* Querier = nullptr;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FVector Origin = FVector::ZeroVector;
+
+	// Cone axis; ignored when HalfAngle is 180
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FVector Direction = FVector::ForwardVector;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0"))
+	float Range = 2000.0f;
+
+	// 180 turns the cone into a plain radius
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0", ClampMax = "180"))
+	float HalfAngle = 180.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	ETargetingTeamFilter Team = ETargetingTeamFilter::Any;
+
+	// 0 returns every match
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0"))
+	int32 MaxResults = 0;
+
+	// Score for lying on the cone axis, falling to 0 at its edge
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float AngleWeight = 1.0f;
+
+	// Score for being at the origin, falling to 0 at Range
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float DistanceWeight = 1.0f;
+
+	// Added for targets hostile to the querier
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float HostileWeight = 0.0f;
+
+	// Results of an equivalent query from the same querier younger than this are returned again without searching.
+	// Origins within a metre of each other and directions a few degrees apart count as equivalent.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0"))
+	float CacheTime = 0.0f;
+};
+
+/**
+ * Every ABaseCharacter in the world, kept in a uniform grid that follows them as they move.
+ * Lock-on and AI target selection query it instead of iterating actors, so a query only touches the cells it overlaps.
+ */
+UCLASS()
+class FANTASY_API UTargetingSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// Edge of a grid cell on the ground plane; about the usual query range
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Targeting", meta = (ClampMin = "100"))
+	float CellSize = 2000.0f;
+
+	// Characters register themselves in BeginPlay; registering twice is harmless
+	void RegisterCharacter(ABaseCharacter* Character);
+	void UnregisterCharacter(ABaseCharacter* Character);
+
+	// Matches of Query, best score first. Returns how many were found.
+	UFUNCTION(BlueprintCallable, Category = "Targeting")
+	int32 FindTargets(const FTargetingQuery& Query, TArray<ABaseCharacter*>& OutTargets);
+
+	// The best scoring match of Query, or null
+	UFUNCTION(BlueprintCallable, Category = "Targeting")
+	ABaseCharacter* FindBestTarget(const FTargetingQuery& Query);
+
+	// Everyone within Radius of Origin, in no particular order
+	UFUNCTION(BlueprintCallable, Category = "Targeting")
+	int32 FindInRadius(const FVector& Origin, float Radius, TArray<ABaseCharacter*>& OutTargets) const;
+
+	// Up to Count characters nearest to Origin within Radius, nearest first
+	UFUNCTION(BlueprintCallable, Category = "Targeting")
+	int32 FindNearest(const FVector& Origin, float Radius, int32 Count, TArray<ABaseCharacter*>& OutTargets, AActor* Ignore = nullptr) const;
+
+	UFUNCTION(BlueprintPure, Category = "Targeting")
+	int32 GetCharacterCount() const { return Entries.Num(); }
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	struct FEntry {
+		TWeakObjectPtr<ABaseCharacter> Character;
+		FVector Location = FVector::ZeroVector;
+		FIntPoint Cell = FIntPoint::ZeroValue;
+		// Position in the cell's array
+		int32 Slot = INDEX_NONE;
+	};
+
+	// The query fields that decide its results, origin and direction quantized
+	struct FCacheKey {
+		FObjectKey Querier;
+		FIntVector Origin;
+		FIntVector Direction;
+		float Range = 0.0f;
+		float HalfAngle = 0.0f;
+		ETargetingTeamFilter Team = ETargetingTeamFilter::Any;
+		int32 MaxResults = 0;
+		float AngleWeight = 0.0f;
+		float DistanceWeight = 0.0f;
+		float HostileWeight = 0.0f;
+
+		bool operator==(const FCacheKey& Other) const;
+		uint32 GetHash() const;
+		friend uint32 GetTypeHash(const FCacheKey& Key) { return Key.GetHash(); }
+	};
+
+	struct FCachedResult {
+		float Expires = 0.0f;
+		TArray<TWeakObjectPtr<ABaseCharacter>> Targets;
+	};
+
+	FIntPoint GetCell(const FVector& Location) const;
+	void AddToCell(int32 Index);
+	void RemoveFromCell(int32 Index);
+	void RemoveEntryAt(int32 Index);
+
+	// Calls Visit with the index of every entry within Radius of Origin
+	template <typename FVisit>
+	void ForEachInRadius(const FVector& Origin, float Radius, FVisit Visit) const;
+
+	static FCacheKey MakeCacheKey(const FTargetingQuery& Query);
+
+private:
+	TArray<FEntry> Entries;
+	TMap<TWeakObjectPtr<ABaseCharacter>, int32> EntryIndices;
+
+	// Entry indices by cell
+	TMap<FIntPoint, TArray<int32>> Grid;
+
+	TMap<FCacheKey, FCachedResult> Cache;
+};
@@ -0,0 +1,144 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WorldCollision.h"
+#include "VisionConeSubsystem.generated.h"
+
+class AAIController;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FVisionConeChanged, AAIController*, Viewer, AActor*, Target, bool, bVisible);
+
+/**
+ * Line of sight from every enemy controller to every player, answered from a cache.
+ * Viewers are hashed into a grid so each player is only tested against the enemies near it; pairs inside a cone are
+ * confirmed with async line traces under a per-frame budget. Sight angle changes are applied once per frame.
+ */
+UCLASS()
+class FANTASY_API UVisionConeSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// Cone used for controllers without a sight sense config
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Vision", meta = (ClampMin = "0", ClampMax = "180"))
+	float DefaultHalfAngle = 60.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Vision", meta = (ClampMin = "0"))
+	float DefaultRange = 3000.0f;
+
+	// Edge of a grid cell; about the longest sight range keeps each lookup to the 27 cells around a player
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Vision", meta = (ClampMin = "100"))
+	float CellSize = 4000.0f;
+
+	// Line traces started per frame across all viewers; pairs over budget keep their last result
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Vision", meta = (ClampMin = "1"))
+	int32 MaxTracesPerFrame = 64;
+
+	// A pair is traced again at most this often while it stays inside the cone
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Vision", meta = (ClampMin = "0"))
+	float TraceInterval = 0.1f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Vision")
+	TEnumAsByte<ECollisionChannel> TraceChannel = ECC_Visibility;
+
+	// Called when a viewer starts or stops seeing a target
+	UPROPERTY(BlueprintAssignable, Category = "AI|Vision")
+	FVisionConeChanged OnVisibilityChanged;
+
+	// Takes the cone from the controller's sight config; registering twice is harmless
+	UFUNCTION(BlueprintCallable, Category = "AI|Vision")
+	void RegisterViewer(AAIController* Controller);
+
+	UFUNCTION(BlueprintCallable, Category = "AI|Vision")
+	void UnregisterViewer(AAIController* Controller);
+
+	// Sets the peripheral vision angle of Controller's sight sense at the end of the frame; the last request of a frame wins
+	UFUNCTION(BlueprintCallable, Category = "AI|Vision")
+	void RequestSightAngle(AAIController* Controller, float Angle);
+
+	UFUNCTION(BlueprintPure, Category = "AI|Vision")
+	bool CanSee(const AAIController* Controller, const AActor* Target) const;
+
+	// The nearest target Controller currently sees, or null
+	UFUNCTION(BlueprintPure, Category = "AI|Vision")
+	AActor* GetVisibleTarget(const AAIController* Controller) const;
+
+	// When and where Controller last saw Target; false if it never has
+	UFUNCTION(BlueprintPure, Category = "AI|Vision")
+	bool GetLastSeen(const AAIController* Controller, const AActor* Target, float& OutTime, FVector& OutLocation) const;
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	struct FSighting {
+		TWeakObjectPtr<AActor> Target;
+		bool bVisible = false;
+		bool bTracePending = false;
+		float LastTraceTime = -MAX_flt;
+		float LastSeenTime = -MAX_flt;
+		FVector LastSeenLocation = FVector::ZeroVector;
+	};
+
+	struct FViewer {
+		TWeakObjectPtr<AAIController> Controller;
+		float CosHalfAngle = 0.5f;
+		float Range = 0.0f;
+		// Eye point and direction, refreshed every frame
+		FVector Eye = FVector::ZeroVector;
+		FVector Forward = FVector::ForwardVector;
+		TArray<FSighting> Sightings;
+	};
+
+	// Identifies the pair a trace was started for; indices can shift before it completes
+	struct FPendingTrace {
+		TWeakObjectPtr<AAIController> Controller;
+		TWeakObjectPtr<AActor> Target;
+	};
+
+	// Handlers may register or unregister viewers, which moves them in Viewers, so changes are broadcast after the loops
+	struct FVisibilityChange {
+		TWeakObjectPtr<AAIController> Controller;
+		TWeakObjectPtr<AActor> Target;
+		bool bVisible = false;
+	};
+
+	void ApplySightAngles();
+	void RefreshViewers();
+	void BuildGrid();
+	void CheckTarget(AActor& Target, int32& TraceBudget);
+	void SetVisible(FViewer& Viewer, FSighting& Sighting, bool bVisible, const FVector& Location);
+	void BroadcastChanges();
+	void OnTraceDone(const FTraceHandle& Handle, FTraceDatum& Datum);
+	void ReadSightConfig(FViewer& Viewer) const;
+	void RemoveViewerAt(int32 Index);
+	static bool IsInCone(const FViewer& Viewer, const FVector& Location);
+
+	FViewer* FindViewer(const AAIController* Controller);
+	const FViewer* FindViewer(const AAIController* Controller) const;
+	static FSighting* FindSighting(FViewer& Viewer, const AActor* Target);
+	static const FSighting* FindSighting(const FViewer& Viewer, const AActor* Target);
+
+private:
+	TArray<FViewer> Viewers;
+	TMap<TWeakObjectPtr<const AAIController>, int32> ViewerIndices;
+	float MaxViewerRange = 0.0f;
+
+	// Viewer indices by grid cell, rebuilt every frame
+	TMap<FIntVector, TArray<int32>> Grid;
+
+	TMap<TWeakObjectPtr<AAIController>, float> PendingAngles;
+
+	TMap<uint32, FPendingTrace> PendingTraces;
+	uint32 NextTraceId = 0;
+	FTraceDelegate TraceDelegate;
+
+	TArray<FVisibilityChange> PendingChanges;
+
+	// Offsets the first target checked, so a tight budget is shared fairly between players
+	int32 FirstTarget = 0;
+};
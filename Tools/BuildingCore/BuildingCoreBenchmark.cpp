@@ -0,0 +1,263 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+// Micro-benchmarks of the BuildingCore geometry, run natively on synthetic buildings.
+// Each benchmark repeats until it has run for at least MinSeconds and reports the time per iteration.
+// Pass a substring to only run the benchmarks whose name contains it.
+
+#include "BuildingCoreFill.h"
+#include "BuildingCoreKernels.h"
+#include "BuildingCoreLayout.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+using namespace BuildingCore;
+
+namespace {
+	constexpr double MinSeconds = 0.5;
+
+	// Keeps the compiler from dropping work whose result is unused
+	template <typename T>
+	inline void DoNotOptimize(const T& Value)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		asm volatile("" : : "r,m"(Value) : "memory");
+#else
+		static volatile const void* Sink;
+		Sink = &Value;
+#endif
+	}
+
+	struct FBenchmark {
+		const char* Name;
+		// Items processed per iteration, for the throughput column
+		int64_t Items;
+		std::function<void()> Body;
+	};
+
+	void Run(const FBenchmark& Benchmark)
+	{
+		using FClock = std::chrono::steady_clock;
+
+		Benchmark.Body(); // Warm up caches and allocations
+
+		int64_t Iterations = 1;
+		double Seconds = 0.0;
+		while (true) {
+			const FClock::time_point Start = FClock::now();
+			for (int64_t i = 0; i < Iterations; ++i) {
+				Benchmark.Body();
+			}
+			Seconds = std::chrono::duration<double>(FClock::now() - Start).count();
+			if (Seconds >= MinSeconds || Iterations >= (int64_t(1) << 40)) {
+				break;
+			}
+			Iterations *= 2;
+		}
+
+		const double Nanoseconds = Seconds * 1e9 / Iterations;
+		std::printf("%-28s %14.1f ns %12lld it %12.2f M items/s\n", Benchmark.Name, Nanoseconds, static_cast<long long>(Iterations),
+			Benchmark.Items / Nanoseconds * 1e3);
+	}
+
+	// Closed square footprint with Segments segments per side, sampled like FBuildingArcLengthTable
+	struct FFootprint {
+		std::vector<FVec3> Locations;
+		std::vector<float> Distances;
+		int32_t Segments = 0;
+		int32_t SamplesPerSegment = 8;
+
+		FFootprint(int32_t SegmentsPerSide, float Size)
+		{
+			const FVec3 Corners[] = { FVec3(0, 0, 0), FVec3(Size, 0, 0), FVec3(Size, Size, 0), FVec3(0, Size, 0) };
+			Segments = SegmentsPerSide * 4;
+			for (int32_t Segment = 0; Segment < Segments; ++Segment) {
+				const FVec3& From = Corners[Segment / SegmentsPerSide];
+				const FVec3& To = Corners[(Segment / SegmentsPerSide + 1) % 4];
+				for (int32_t Sample = 0; Sample < SamplesPerSegment; ++Sample) {
+					const float Alpha = (Segment % SegmentsPerSide + Sample / float(SamplesPerSegment)) / SegmentsPerSide;
+					// A slight bulge so samples are not collinear
+					Locations.push_back(FVec3::Lerp(From, To, Alpha) + FVec3(0, 0, std::sin(Alpha * 3.14159265f) * 10.0f));
+				}
+			}
+			Locations.push_back(Corners[0]);
+			Distances.resize(Locations.size());
+			AccumulateDistances(Locations.data(), static_cast<int32_t>(Locations.size()), Distances.data());
+		}
+
+		FArcLengthView GetView() const
+		{
+			FArcLengthView View;
+			View.Locations = Locations.data();
+			View.Distances = Distances.data();
+			View.Num = static_cast<int32_t>(Locations.size());
+			View.SamplesPerSegment = SamplesPerSegment;
+			return View;
+		}
+	};
+
+	// A wall piece subdivided into a grid, about as dense as a modelled window part
+	struct FGridPart {
+		std::vector<FVec3> Positions;
+		std::vector<FVec2> UVs;
+		std::vector<FVec3> TangentZ;
+		std::vector<FVec3> TangentX;
+		std::vector<int32_t> Indices;
+
+		FGridPart(int32_t Columns, int32_t Rows, float Length, float Height)
+		{
+			for (int32_t Row = 0; Row <= Rows; ++Row) {
+				for (int32_t Column = 0; Column <= Columns; ++Column) {
+					const float U = Column / float(Columns);
+					const float V = Row / float(Rows);
+					Positions.push_back(FVec3(U * Length, 0.0f, V * Height));
+					UVs.push_back(FVec2(U, 1.0f - V));
+					TangentZ.push_back(FVec3(0.0f, -1.0f, 0.0f));
+					TangentX.push_back(FVec3(1.0f, 0.0f, 0.0f));
+				}
+			}
+			for (int32_t Row = 0; Row < Rows; ++Row) {
+				for (int32_t Column = 0; Column < Columns; ++Column) {
+					const int32_t A = Row * (Columns + 1) + Column;
+					const int32_t B = A + Columns + 1;
+					Indices.insert(Indices.end(), { A, B, A + 1, A + 1, B, B + 1 });
+				}
+			}
+		}
+
+		FPartSectionView GetSection(int32_t Slot) const
+		{
+			FPartSectionView Section;
+			Section.Positions = Positions.data();
+			Section.UVs = UVs.data();
+			Section.TangentZ = TangentZ.data();
+			Section.TangentX = TangentX.data();
+			Section.NumVertices = static_cast<int32_t>(Positions.size());
+			Section.Indices = Indices.data();
+			Section.NumIndices = static_cast<int32_t>(Indices.size());
+			Section.Slot = Slot;
+			return Section;
+		}
+	};
+
+	// Owns the buffers EmitChunk writes into
+	struct FSlotStorage {
+		std::vector<FVec3> Positions;
+		std::vector<FVec3> Normals;
+		std::vector<FTangent> Tangents;
+		std::vector<FVec2> UVs;
+		std::vector<int32_t> Indices;
+
+		FSlotBuffers Presize(int32_t NumVertices, int32_t NumIndices)
+		{
+			Positions.resize(NumVertices);
+			Normals.resize(NumVertices);
+			Tangents.resize(NumVertices);
+			UVs.resize(NumVertices);
+			Indices.resize(NumIndices);
+			return FSlotBuffers{ Positions.data(), Normals.data(), Tangents.data(), UVs.data(), Indices.data() };
+		}
+	};
+
+	std::vector<FVec2> MakeStar(int32_t Points, float Radius)
+	{
+		std::vector<FVec2> Star;
+		for (int32_t i = 0; i < Points * 2; ++i) {
+			const float Angle = i * 3.14159265f / Points;
+			const float R = (i % 2 == 0) ? Radius : Radius * 0.6f;
+			Star.push_back(FVec2(std::cos(Angle) * R, std::sin(Angle) * R));
+		}
+		return Star;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const char* Filter = argc > 1 ? argv[1] : nullptr;
+
+	const FFootprint Footprint(16, 4000.0f);
+	const FArcLengthView ArcLengths = Footprint.GetView();
+
+	// Wall and window parts, each with two material sections
+	const FGridPart Wall(4, 4, 200.0f, 300.0f);
+	const FGridPart Window(16, 16, 100.0f, 300.0f);
+	std::vector<FPartView> Parts(2);
+	Parts[0] = { true, 200.0f, 300.0f, { Wall.GetSection(0), Wall.GetSection(1) } };
+	Parts[1] = { true, 100.0f, 300.0f, { Window.GetSection(0), Window.GetSection(1) } };
+	const uint8_t Pattern[] = { 0, 1, 1, 0 };
+
+	FLayout Layout;
+	LayoutSegment(ArcLengths, 0, Pattern, 4, Parts, Layout);
+	constexpr int32_t SlotCount = 2;
+	int32_t VertexCounts[SlotCount];
+	int32_t IndexCounts[SlotCount];
+	CountChunk(Layout, Parts, SlotCount, VertexCounts, IndexCounts);
+	FSlotStorage Storage[SlotCount];
+	FSlotBuffers Slots[SlotCount];
+	for (int32_t Slot = 0; Slot < SlotCount; ++Slot) {
+		Slots[Slot] = Storage[Slot].Presize(VertexCounts[Slot], IndexCounts[Slot]);
+	}
+
+	const int32_t StreamSize = 4096;
+	std::vector<FVec3> Stream(StreamSize, FVec3(1.0f, 2.0f, 3.0f));
+	std::vector<FVec3> StreamOut(StreamSize);
+	std::vector<FTangent> TangentsOut(StreamSize);
+	const FMatrix44 Transform = GetScaleRotationTranslation(FVec3(1.1f, 1.0f, 0.9f), 5.0f, 30.0f, FVec3(100.0f, 200.0f, 300.0f));
+
+	const std::vector<FVec2> Star = MakeStar(64, 1000.0f);
+	std::vector<int32_t> StarTriangles;
+	TriangulatePolygon(Star.data(), static_cast<int32_t>(Star.size()), StarTriangles);
+
+	std::vector<float> Distances(Footprint.Locations.size());
+	const FBenchmark Benchmarks[] = {
+		{ "AccumulateDistances", ArcLengths.Num, [&]() {
+			AccumulateDistances(Footprint.Locations.data(), ArcLengths.Num, Distances.data());
+			DoNotOptimize(Distances.back());
+		} },
+		{ "LayoutSegment", int64_t(Footprint.Segments), [&]() {
+			FLayout Out;
+			for (int32_t Segment = 0; Segment < Footprint.Segments; ++Segment) {
+				LayoutSegment(ArcLengths, Segment, Pattern, 4, Parts, Out);
+				DoNotOptimize(Out.Placements.data());
+			}
+		} },
+		{ "EmitChunk", int64_t(VertexCounts[0]) + VertexCounts[1], [&]() {
+			EmitChunk(Layout, Parts, FFloorSpec{ 300.0f, 320.0f }, Slots, SlotCount);
+			DoNotOptimize(Storage[0].Positions.back());
+		} },
+		{ "TransformPositions", StreamSize, [&]() {
+			TransformPositions(Transform, Stream.data(), StreamOut.data(), StreamSize);
+			DoNotOptimize(StreamOut.back());
+		} },
+		{ "TransformTangents", StreamSize, [&]() {
+			TransformTangents(Transform, Stream.data(), TangentsOut.data(), StreamSize);
+			DoNotOptimize(TangentsOut.back());
+		} },
+		{ "TriangulatePolygon", int64_t(Star.size()), [&]() {
+			std::vector<int32_t> Triangles;
+			TriangulatePolygon(Star.data(), static_cast<int32_t>(Star.size()), Triangles);
+			DoNotOptimize(Triangles.data());
+		} },
+		{ "SubdividePolygon", int64_t(StarTriangles.size() / 3), [&]() {
+			std::vector<FVec2> Points = Star;
+			std::vector<int32_t> Triangles = StarTriangles;
+			SubdividePolygon(Points, Triangles, 2);
+			DoNotOptimize(Triangles.data());
+		} },
+		{ "ConvexHull", int64_t(Star.size()), [&]() {
+			std::vector<FVec2> Hull;
+			ConvexHull(Star.data(), static_cast<int32_t>(Star.size()), Hull);
+			DoNotOptimize(Hull.data());
+		} },
+	};
+
+	for (const FBenchmark& Benchmark : Benchmarks) {
+		if (!Filter || std::strstr(Benchmark.Name, Filter)) {
+			Run(Benchmark);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,366 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+// Correctness checks of the BuildingCore geometry, run natively through ctest.
+// Pass a substring to only run the tests whose name contains it.
+
+#include "BuildingCoreFill.h"
+#include "BuildingCoreKernels.h"
+#include "BuildingCoreLayout.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace BuildingCore;
+
+namespace {
+	int32_t Failures = 0;
+
+#define CHECK(Condition) \
+	do { \
+		if (!(Condition)) { \
+			std::printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #Condition); \
+			++Failures; \
+		} \
+	} while (0)
+
+#define CHECK_NEAR(A, B, Tolerance) \
+	do { \
+		const double ValueA = (A); \
+		const double ValueB = (B); \
+		if (std::abs(ValueA - ValueB) > (Tolerance)) { \
+			std::printf("  %s:%d: CHECK_NEAR(%s, %s) failed: %g vs %g\n", __FILE__, __LINE__, #A, #B, ValueA, ValueB); \
+			++Failures; \
+		} \
+	} while (0)
+
+	struct FTest {
+		const char* Name;
+		void (*Body)();
+	};
+
+	// A straight footprint along X, one sample per segment
+	struct FLine {
+		std::vector<FVec3> Locations;
+		std::vector<float> Distances;
+
+		explicit FLine(std::vector<float> Xs)
+		{
+			for (float X : Xs) {
+				Locations.push_back(FVec3(X, 0.0f, 0.0f));
+			}
+			Distances.resize(Locations.size());
+			AccumulateDistances(Locations.data(), static_cast<int32_t>(Locations.size()), Distances.data());
+		}
+
+		FArcLengthView GetView() const
+		{
+			FArcLengthView View;
+			View.Locations = Locations.data();
+			View.Distances = Distances.data();
+			View.Num = static_cast<int32_t>(Locations.size());
+			View.SamplesPerSegment = 1;
+			return View;
+		}
+	};
+
+	std::vector<FPartView> MakeParts()
+	{
+		std::vector<FPartView> Parts(3);
+		Parts[0] = { true, 300.0f, 300.0f, {} };
+		Parts[1] = { true, 100.0f, 300.0f, {} };
+		Parts[2] = { false, 200.0f, 300.0f, {} };
+		return Parts;
+	}
+
+	// Twice the signed area in XY; positive when counter-clockwise
+	float SignedArea(const FVec2& A, const FVec2& B, const FVec2& C)
+	{
+		return (B.X - A.X) * (C.Y - A.Y) - (B.Y - A.Y) * (C.X - A.X);
+	}
+
+	float TriangleArea(const std::vector<FVec2>& Points, const std::vector<int32_t>& Triangles)
+	{
+		float Area = 0.0f;
+		for (size_t i = 0; i + 2 < Triangles.size(); i += 3) {
+			Area += SignedArea(Points[Triangles[i]], Points[Triangles[i + 1]], Points[Triangles[i + 2]]) * 0.5f;
+		}
+		return Area;
+	}
+
+	bool AllCounterClockwise(const std::vector<FVec2>& Points, const std::vector<int32_t>& Triangles)
+	{
+		for (size_t i = 0; i + 2 < Triangles.size(); i += 3) {
+			if (SignedArea(Points[Triangles[i]], Points[Triangles[i + 1]], Points[Triangles[i + 2]]) <= 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Concave L, 200 x 200 with a 100 x 100 corner cut out, counter-clockwise
+	std::vector<FVec2> MakeL()
+	{
+		return { FVec2(0, 0), FVec2(200, 0), FVec2(200, 100), FVec2(100, 100), FVec2(100, 200), FVec2(0, 200) };
+	}
+
+	FVec3 TransformReference(const FMatrix44& Matrix, const FVec3& V, float W)
+	{
+		return FVec3(
+			V.X * Matrix.M[0][0] + V.Y * Matrix.M[1][0] + V.Z * Matrix.M[2][0] + W * Matrix.M[3][0],
+			V.X * Matrix.M[0][1] + V.Y * Matrix.M[1][1] + V.Z * Matrix.M[2][1] + W * Matrix.M[3][1],
+			V.X * Matrix.M[0][2] + V.Y * Matrix.M[1][2] + V.Z * Matrix.M[2][2] + W * Matrix.M[3][2]);
+	}
+
+	// Eleven vectors: two full SSE batches and a scalar tail of three
+	std::vector<FVec3> MakeStream()
+	{
+		std::vector<FVec3> Stream;
+		for (int32_t i = 0; i < 11; ++i) {
+			Stream.push_back(FVec3(i * 1.5f - 4.0f, 10.0f - i, i * i * 0.25f));
+		}
+		return Stream;
+	}
+
+	void TestLayoutScale()
+	{
+		const FLine Line({ 0.0f, 1000.0f, 1450.0f });
+		const std::vector<FPartView> Parts = MakeParts();
+		const uint8_t Pattern[] = { 0, 1 };
+
+		// 300 + 100 + 300 + 100 + 300 = 1100 is the first whole item count covering 1000
+		FLayout Layout;
+		LayoutSegment(Line.GetView(), 0, Pattern, 2, Parts, Layout);
+		CHECK_NEAR(Layout.PatternScale, 1000.0 / 1100.0, 1e-5);
+		CHECK(Layout.Placements.size() == 5);
+		if (Layout.Placements.size() == 5) {
+			const int32_t MeshTypes[] = { 0, 1, 0, 1, 0 };
+			for (int32_t i = 0; i < 5; ++i) {
+				CHECK(Layout.Placements[i].MeshType == MeshTypes[i]);
+			}
+			CHECK_NEAR(Layout.Placements[0].Start.X, 0.0, 1e-3);
+			CHECK_NEAR(Layout.Placements[0].End.X, 300.0, 1e-3);
+			CHECK_NEAR(Layout.Placements[1].Start.X, 300.0 * 1000.0 / 1100.0, 1e-2);
+			CHECK_NEAR(Layout.Placements[4].Start.X, 800.0 * 1000.0 / 1100.0, 1e-2);
+			CHECK_NEAR(Layout.Placements[0].Yaw, 0.0, 1e-4);
+			CHECK_NEAR(Layout.Placements[0].Pitch, 0.0, 1e-4);
+		}
+
+		// 450 is covered by 300 + 100 + 300
+		LayoutSegment(Line.GetView(), 1, Pattern, 2, Parts, Layout);
+		CHECK_NEAR(Layout.PatternScale, 450.0 / 700.0, 1e-5);
+		CHECK(Layout.Placements.size() == 3);
+		if (!Layout.Placements.empty()) {
+			CHECK_NEAR(Layout.Placements[0].Start.X, 1000.0, 1e-3);
+		}
+	}
+
+	void TestLayoutInvalidPattern()
+	{
+		const FLine Line({ 0.0f, 1000.0f });
+		const std::vector<FPartView> Parts = MakeParts();
+
+		FLayout Layout;
+		Layout.Placements.resize(7);
+		const uint8_t OutOfRange[] = { 0, 5 };
+		LayoutSegment(Line.GetView(), 0, OutOfRange, 2, Parts, Layout);
+		CHECK(Layout.Placements.empty());
+		CHECK(Layout.PatternScale == 1.0f);
+
+		LayoutSegment(Line.GetView(), 0, OutOfRange, 0, Parts, Layout);
+		CHECK(Layout.Placements.empty());
+
+		// Layout stops at the first part without geometry: 300 + 200 + 300 + 200 covers 1000, one placement precedes it
+		const uint8_t WithInvalid[] = { 0, 2 };
+		LayoutSegment(Line.GetView(), 0, WithInvalid, 2, Parts, Layout);
+		CHECK_NEAR(Layout.PatternScale, 1.0, 1e-5);
+		CHECK(Layout.Placements.size() == 1);
+	}
+
+	void TestLayoutZeroLength()
+	{
+		const FLine Line({ 0.0f, 0.0f, 500.0f });
+		const std::vector<FPartView> Parts = MakeParts();
+		const uint8_t Pattern[] = { 0, 1 };
+
+		FLayout Layout;
+		LayoutSegment(Line.GetView(), 0, Pattern, 2, Parts, Layout);
+		CHECK(Layout.Placements.empty());
+		CHECK(Layout.PatternScale == 1.0f);
+
+		// Past the end both ends clamp to the last sample
+		LayoutSegment(Line.GetView(), 5, Pattern, 2, Parts, Layout);
+		CHECK(Layout.Placements.empty());
+	}
+
+	void TestTriangulateConcave()
+	{
+		std::vector<FVec2> L = MakeL();
+		std::vector<int32_t> Triangles;
+		CHECK(TriangulatePolygon(L.data(), static_cast<int32_t>(L.size()), Triangles));
+		CHECK(Triangles.size() == 4 * 3);
+		CHECK(AllCounterClockwise(L, Triangles));
+		CHECK_NEAR(TriangleArea(L, Triangles), 30000.0, 1e-2);
+
+		// A clockwise outline gives the same winding
+		std::vector<FVec2> Reversed(L.rbegin(), L.rend());
+		CHECK(TriangulatePolygon(Reversed.data(), static_cast<int32_t>(Reversed.size()), Triangles));
+		CHECK(Triangles.size() == 4 * 3);
+		CHECK(AllCounterClockwise(Reversed, Triangles));
+		CHECK_NEAR(TriangleArea(Reversed, Triangles), 30000.0, 1e-2);
+	}
+
+	void TestTriangulateDegenerate()
+	{
+		std::vector<int32_t> Triangles = { 1, 2, 3 };
+		const FVec2 Collinear[] = { FVec2(0, 0), FVec2(100, 0), FVec2(200, 0), FVec2(300, 0) };
+		CHECK(!TriangulatePolygon(Collinear, 4, Triangles));
+		CHECK(Triangles.empty());
+
+		const FVec2 TwoPoints[] = { FVec2(0, 0), FVec2(100, 0) };
+		CHECK(!TriangulatePolygon(TwoPoints, 2, Triangles));
+		CHECK(Triangles.empty());
+
+		// The two lobes of a bow tie cancel out
+		const FVec2 BowTie[] = { FVec2(0, 0), FVec2(100, 100), FVec2(100, 0), FVec2(0, 100) };
+		CHECK(!TriangulatePolygon(BowTie, 4, Triangles));
+		CHECK(Triangles.empty());
+
+		const FVec2 Triangle[] = { FVec2(0, 0), FVec2(0, 100), FVec2(100, 0) };
+		CHECK(TriangulatePolygon(Triangle, 3, Triangles));
+		CHECK(Triangles.size() == 3);
+	}
+
+	void TestSubdivide()
+	{
+		std::vector<FVec2> Points = { FVec2(0, 0), FVec2(100, 0), FVec2(100, 100), FVec2(0, 100) };
+		std::vector<int32_t> Triangles = { 0, 1, 2, 0, 2, 3 };
+
+		// Four edges and the shared diagonal each add one midpoint
+		SubdividePolygon(Points, Triangles, 1);
+		CHECK(Points.size() == 9);
+		CHECK(Triangles.size() == 8 * 3);
+		CHECK(AllCounterClockwise(Points, Triangles));
+		CHECK_NEAR(TriangleArea(Points, Triangles), 10000.0, 1e-2);
+		CHECK(Points[4] == FVec2(50, 0));
+
+		SubdividePolygon(Points, Triangles, 1);
+		CHECK(Points.size() == 25);
+		CHECK(Triangles.size() == 32 * 3);
+		CHECK_NEAR(TriangleArea(Points, Triangles), 10000.0, 1e-2);
+
+		const size_t Before = Points.size();
+		SubdividePolygon(Points, Triangles, 0);
+		CHECK(Points.size() == Before);
+	}
+
+	void TestConvexHull()
+	{
+		// Corners, an inside point, a point on an edge and a duplicate corner
+		const FVec2 Points[] = { FVec2(50, 50), FVec2(100, 100), FVec2(0, 0), FVec2(100, 0), FVec2(50, 0), FVec2(0, 100), FVec2(100, 100) };
+		std::vector<FVec2> Hull;
+		ConvexHull(Points, 7, Hull);
+		CHECK(Hull.size() == 4);
+		if (Hull.size() == 4) {
+			CHECK(Hull[0] == FVec2(0, 0));
+			CHECK(Hull[1] == FVec2(100, 0));
+			CHECK(Hull[2] == FVec2(100, 100));
+			CHECK(Hull[3] == FVec2(0, 100));
+		}
+
+		std::vector<FVec2> L = MakeL();
+		ConvexHull(L.data(), static_cast<int32_t>(L.size()), Hull);
+		CHECK(Hull.size() == 5);
+
+		ConvexHull(Points, 2, Hull);
+		CHECK(Hull.size() == 2);
+	}
+
+	void TestTransformPositions()
+	{
+		const FMatrix44 Matrix = GetScaleRotationTranslation(FVec3(1.1f, 1.0f, 0.9f), 5.0f, 30.0f, FVec3(100.0f, 200.0f, 300.0f));
+		const std::vector<FVec3> In = MakeStream();
+
+		std::vector<FVec3> Out(In.size());
+		TransformPositions(Matrix, In.data(), Out.data(), static_cast<int32_t>(In.size()));
+		std::vector<FVec3> Vectors(In.size());
+		TransformVectors(Matrix, In.data(), Vectors.data(), static_cast<int32_t>(In.size()));
+		for (size_t i = 0; i < In.size(); ++i) {
+			const FVec3 Expected = TransformReference(Matrix, In[i], 1.0f);
+			CHECK_NEAR(Out[i].X, Expected.X, 1e-3);
+			CHECK_NEAR(Out[i].Y, Expected.Y, 1e-3);
+			CHECK_NEAR(Out[i].Z, Expected.Z, 1e-3);
+
+			const FVec3 ExpectedVector = TransformReference(Matrix, In[i], 0.0f);
+			CHECK_NEAR(Vectors[i].X, ExpectedVector.X, 1e-3);
+			CHECK_NEAR(Vectors[i].Y, ExpectedVector.Y, 1e-3);
+			CHECK_NEAR(Vectors[i].Z, ExpectedVector.Z, 1e-3);
+		}
+
+		// In place
+		std::vector<FVec3> InPlace = In;
+		TransformPositions(Matrix, InPlace.data(), InPlace.data(), static_cast<int32_t>(InPlace.size()));
+		for (size_t i = 0; i < In.size(); ++i) {
+			CHECK_NEAR(InPlace[i].X, Out[i].X, 1e-5);
+			CHECK_NEAR(InPlace[i].Y, Out[i].Y, 1e-5);
+			CHECK_NEAR(InPlace[i].Z, Out[i].Z, 1e-5);
+		}
+
+		// Rotation only: yaw 90 turns X into Y, and the translation lands in the last row
+		const FMatrix44 Yaw = GetScaleRotationTranslation(FVec3(1.0f, 1.0f, 1.0f), 0.0f, 90.0f, FVec3(10.0f, 0.0f, 0.0f));
+		const FVec3 UnitX(1.0f, 0.0f, 0.0f);
+		FVec3 Turned;
+		TransformPositions(Yaw, &UnitX, &Turned, 1);
+		CHECK_NEAR(Turned.X, 10.0, 1e-5);
+		CHECK_NEAR(Turned.Y, 1.0, 1e-5);
+		CHECK_NEAR(Turned.Z, 0.0, 1e-5);
+	}
+
+	void TestTransformTangents()
+	{
+		const FMatrix44 Matrix = GetScaleRotationTranslation(FVec3(1.0f, 1.0f, 1.0f), -20.0f, 135.0f, FVec3(100.0f, 200.0f, 300.0f));
+		const std::vector<FVec3> In = MakeStream();
+
+		std::vector<FTangent> Out(In.size());
+		for (FTangent& Tangent : Out) {
+			Tangent.bFlipTangentY = true;
+		}
+		TransformTangents(Matrix, In.data(), Out.data(), static_cast<int32_t>(In.size()));
+		for (size_t i = 0; i < In.size(); ++i) {
+			const FVec3 Expected = TransformReference(Matrix, In[i], 0.0f);
+			CHECK_NEAR(Out[i].TangentX.X, Expected.X, 1e-3);
+			CHECK_NEAR(Out[i].TangentX.Y, Expected.Y, 1e-3);
+			CHECK_NEAR(Out[i].TangentX.Z, Expected.Z, 1e-3);
+			CHECK(!Out[i].bFlipTangentY);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const char* Filter = argc > 1 ? argv[1] : nullptr;
+
+	const FTest Tests[] = {
+		{ "LayoutScale", TestLayoutScale },
+		{ "LayoutInvalidPattern", TestLayoutInvalidPattern },
+		{ "LayoutZeroLength", TestLayoutZeroLength },
+		{ "TriangulateConcave", TestTriangulateConcave },
+		{ "TriangulateDegenerate", TestTriangulateDegenerate },
+		{ "Subdivide", TestSubdivide },
+		{ "ConvexHull", TestConvexHull },
+		{ "TransformPositions", TestTransformPositions },
+		{ "TransformTangents", TestTransformTangents },
+	};
+
+	int32_t Failed = 0;
+	for (const FTest& Test : Tests) {
+		if (Filter && !std::strstr(Test.Name, Filter)) {
+			continue;
+		}
+		const int32_t Before = Failures;
+		Test.Body();
+		std::printf("%-24s %s\n", Test.Name, Failures == Before ? "ok" : "FAILED");
+		Failed += Failures == Before ? 0 : 1;
+	}
+	return Failed == 0 ? 0 : 1;
+}